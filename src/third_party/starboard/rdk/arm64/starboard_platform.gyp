@@ -29,7 +29,8 @@
 # limitations under the License.
 {
   'includes': [
-    '../shared/sources.gypi'
+    '../shared/sources.gypi',
+    '../shared/starboard_platform_tests.gypi',
   ],
   'variables': {
     'sb_pedantic_warnings': 1,
@@ -33,11 +33,16 @@
 #include "starboard/common/log.h"
 #include "starboard/event.h"
 #include "starboard/speech_synthesis.h"
+#include "starboard/thread.h"
+#include "starboard/time.h"
 #include "starboard/shared/starboard/audio_sink/audio_sink_internal.h"
 
+#include "third_party/starboard/rdk/shared/tunables.h"
 #include "third_party/starboard/rdk/shared/window/window_internal.h"
 #include "third_party/starboard/rdk/shared/log_override.h"
 
+#include <algorithm>
+
 #include <fcntl.h>
 #include <poll.h>
 #include <string.h>
@@ -45,6 +50,8 @@
 #include <sys/timerfd.h>
 #include <unistd.h>
 
+#include <wayland-client.h>
+
 namespace third_party {
 namespace starboard {
 namespace rdk {
@@ -80,7 +87,46 @@ EssSettingsListener Application::settingsListener = {
   nullptr
 };
 
-const SbTime kEssRunLoopPeriod = 16666;  // microseconds
+// Direct mode only, the Wayland display fd paces the loop otherwise.
+SbTime EssRunLoopPeriod() {
+  return GetTunable(Tunable::kEssRunLoopPeriod);  // microseconds
+}
+
+const SbTime kInputLatencyBuckets[] = {4 * kSbTimeMillisecond,
+                                       8 * kSbTimeMillisecond,
+                                       16 * kSbTimeMillisecond,
+                                       33 * kSbTimeMillisecond,
+                                       66 * kSbTimeMillisecond};
+const uint64_t kInputLatencyReportEvery = 100;
+
+// Input events carry no timestamp since API 13, this one rides along and
+// is read back when the event is destroyed, right after its dispatch.
+struct Application::TimedInputData {
+  SbInputData data;
+  SbTimeMonotonic received;
+
+  static void Destroy(void* data) {
+    TimedInputData* timed = reinterpret_cast<TimedInputData*>(data);
+    Application::Get()->RecordInputLatency(SbTimeGetMonotonicNow() - timed->received);
+    delete timed;
+  }
+};
+
+struct Application::ServiceStartup {
+  const char* name;
+  std::function<void()> create;
+  SbThread thread { kSbThreadInvalid };
+  SbTime elapsed { 0 };
+
+  static void* ThreadEntryPoint(void* context) {
+    ServiceStartup* startup = static_cast<ServiceStartup*>(context);
+    SbTimeMonotonic start = SbTimeGetMonotonicNow();
+    startup->create();
+    startup->elapsed = SbTimeGetMonotonicNow() - start;
+    SB_LOG(INFO) << startup->name << " ready in " << startup->elapsed << " us";
+    return nullptr;
+  }
+};
 
 static void setTimerInterval(int fd, SbTime time) {
   struct itimerspec timeout;
@@ -96,12 +142,24 @@ static void setTimerInterval(int fd, SbTime time) {
 
 Application::Application()
   : input_handler_(new EssInput)
-  , display_info_ (new DisplayInfo)
-  , hdcp_profile_ (new HdcpProfile)
-  , networkinfo_ (new NetworkInfo)
-  , rdkshellinfo_ (new RDKShellInfo)
-  , voiceinputinfo_ (new VoiceInput)
-  , hang_monitor_(new HangMonitor("Application")) {
+  , hang_monitor_(new HangMonitor("Application"))
+  , input_latency_histogram_(kInputLatencyBuckets) {
+  services_start_ = SbTimeGetMonotonicNow();
+  StartServiceClient("DisplayInfo", [this]() {
+    display_info_.reset(new DisplayInfo);
+  });
+  // HdcpProfile reads the focus RDKShellInfo publishes.
+  StartServiceClient("RDKShellInfo+HdcpProfile", [this]() {
+    rdkshellinfo_.reset(new RDKShellInfo);
+    hdcp_profile_.reset(new HdcpProfile);
+  });
+  StartServiceClient("NetworkInfo", [this]() {
+    networkinfo_.reset(new NetworkInfo);
+  });
+  StartServiceClient("VoiceInput", [this]() {
+    voiceinputinfo_.reset(new VoiceInput);
+  });
+
   bool error = false;
   ctx_ = EssContextCreate();
 
@@ -126,20 +184,61 @@ Application::Application()
 }
 
 Application::~Application() {
+  WaitForServiceClients();
   EssContextDestroy(ctx_);
 }
 
+void Application::StartServiceClient(const char* name,
+                                     std::function<void()> create) {
+  std::unique_ptr<ServiceStartup> startup(new ServiceStartup);
+  startup->name = name;
+  startup->create = std::move(create);
+  startup->thread =
+      SbThreadCreate(0, kSbThreadNoPriority, kSbThreadNoAffinity, true,
+                     "svc_start", &ServiceStartup::ThreadEntryPoint,
+                     startup.get());
+  if (!SbThreadIsValid(startup->thread)) {
+    SB_LOG(WARNING) << "Creating " << name << " on the startup thread";
+    ServiceStartup::ThreadEntryPoint(startup.get());
+  }
+  service_startups_.push_back(std::move(startup));
+}
+
+void Application::WaitForServiceClients() {
+  if (service_startups_.empty())
+    return;
+  SbTime serial = 0;
+  for (auto& startup : service_startups_) {
+    if (SbThreadIsValid(startup->thread))
+      SbThreadJoin(startup->thread, nullptr);
+    serial += startup->elapsed;
+  }
+  SB_LOG(INFO) << "Service clients ready " << SbTimeGetMonotonicNow() - services_start_
+               << " us after start, " << serial << " us if built one by one";
+  service_startups_.clear();
+}
+
 void Application::Initialize() {
+  WaitForServiceClients();
+
   wakeup_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
   if ( wakeup_fd_ == -1 ) {
     SB_LOG(ERROR) << "Failed to create eventfd, error: " << errno << " (" << strerror(errno) << ')';
   }
 
-  ess_timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
-  if ( ess_timer_fd_ == -1 ) {
-    SB_LOG(ERROR) << "Failed to create timerfd, error: " << errno << " (" << strerror(errno) << ')';
+  if ( EssContextGetUseWayland(ctx_) )
+    wl_display_ = static_cast<struct wl_display*>(EssContextGetWaylandDisplay(ctx_));
+
+  if ( wl_display_ ) {
+    ess_display_fd_ = wl_display_get_fd(wl_display_);
+    SB_LOG(INFO) << "Essos loop runs on Wayland display events";
   } else {
-    setTimerInterval(ess_timer_fd_, kEssRunLoopPeriod);
+    ess_timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if ( ess_timer_fd_ == -1 ) {
+      SB_LOG(ERROR) << "Failed to create timerfd, error: " << errno << " (" << strerror(errno) << ')';
+    } else {
+      setTimerInterval(ess_timer_fd_, EssRunLoopPeriod());
+    }
   }
 
   monitor_timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
@@ -157,11 +256,14 @@ void Application::Initialize() {
 void Application::Teardown() {
   SbAudioSinkPrivate::TearDown();
   libcobalt_api::Teardown();
+  LogInputLatency();
 
-  close(ess_timer_fd_);
+  if ( ess_timer_fd_ != -1 )
+    close(ess_timer_fd_);
   close(wakeup_fd_);
   close(monitor_timer_fd_);
-  ess_timer_fd_ = wakeup_fd_ = monitor_timer_fd_ = -1;
+  ess_timer_fd_ = wakeup_fd_ = monitor_timer_fd_ = ess_display_fd_ = -1;
+  wl_display_ = nullptr;
 }
 
 bool Application::MayHaveSystemEvents() {
@@ -170,8 +272,9 @@ bool Application::MayHaveSystemEvents() {
 
 ::starboard::shared::starboard::Application::Event*
 Application::PollNextSystemEvent() {
+  MarkMainThreadBusy();
   SbTime now = SbTimeGetMonotonicNow();
-  if ((now - ess_loop_last_ts_) > kEssRunLoopPeriod) {
+  if ((now - ess_loop_last_ts_) > EssRunLoopPeriod()) {
     ess_loop_last_ts_ = now;
     EssContextRunEventLoopOnce( ctx_ );
   }
@@ -181,10 +284,24 @@ Application::PollNextSystemEvent() {
 ::starboard::shared::starboard::Application::Event*
 Application::WaitForSystemEventWithTimeout(SbTime time) {
   struct timespec timeout;
-  struct pollfd fds[3];
+  struct pollfd fds[4];
   int fds_sz = 0;
   int rc = 0;
 
+  // Wayland's multi-threaded read protocol: events already queued are
+  // dispatched first, then the display fd is watched with a read prepared
+  // so the EGL thread can't take events from under us.
+  if ( wl_display_ ) {
+    while ( wl_display_prepare_read(wl_display_) != 0 )
+      EssContextRunEventLoopOnce( ctx_ );
+    wl_display_flush(wl_display_);
+
+    fds[fds_sz].fd = ess_display_fd_;
+    fds[fds_sz].events = POLLIN;
+    fds[fds_sz].revents = 0;
+    ++fds_sz;
+  }
+
   if ( !(ess_timer_fd_ < 0) ) {
     fds[fds_sz].fd = ess_timer_fd_;
     fds[fds_sz].events = POLLIN;
@@ -209,12 +326,23 @@ Application::WaitForSystemEventWithTimeout(SbTime time) {
   if ( fds_sz != 0 ) {
     timeout.tv_sec = time / kSbTimeSecond;
     timeout.tv_nsec = (time % kSbTimeSecond) * kSbTimeNanosecondsPerMicrosecond;
+    MarkMainThreadIdle();
     rc = ppoll(fds, fds_sz, &timeout, NULL);
+    MarkMainThreadBusy();
+  }
+
+  if ( wl_display_ ) {
+    if ( rc > 0 && (fds[0].revents & POLLIN) )
+      wl_display_read_events(wl_display_);
+    else
+      wl_display_cancel_read(wl_display_);
+    ess_loop_last_ts_ = SbTimeGetMonotonicNow();
+    EssContextRunEventLoopOnce( ctx_ );
   }
 
   if ( rc > 0 ) {
     for (int i = 0; i < fds_sz; ++i) {
-      if ( (fds[i].revents & POLLIN) != POLLIN )
+      if ( (fds[i].revents & POLLIN) != POLLIN || fds[i].fd == ess_display_fd_ )
         continue;
       // Ack timer or wakeup event
       uint64_t tmp;
@@ -253,9 +381,30 @@ bool Application::DestroySbWindow(SbWindow window) {
 }
 
 void Application::InjectInputEvent(SbInputData* data) {
-  data->window = window_;
-  Inject(new Event(kSbEventTypeInput, data,
-                   &Application::DeleteDestructor<SbInputData>));
+  TimedInputData* timed = new TimedInputData;
+  timed->data = *data;
+  timed->data.window = window_;
+  timed->received = SbTimeGetMonotonicNow();
+  delete data;
+  Inject(new Event(kSbEventTypeInput, &timed->data, &TimedInputData::Destroy));
+}
+
+void Application::RecordInputLatency(SbTime latency) {
+  input_latency_histogram_.Add(latency);
+  ++input_count_;
+  input_latency_total_ += latency;
+  input_latency_max_ = std::max(input_latency_max_, latency);
+  if (input_count_ % kInputLatencyReportEvery == 0)
+    LogInputLatency();
+}
+
+void Application::LogInputLatency() const {
+  if (input_count_ == 0)
+    return;
+  SB_LOG(INFO) << "Input to dispatch: " << input_count_ << " events, avg "
+               << input_latency_total_ / static_cast<SbTime>(input_count_)
+               << " us, max " << input_latency_max_ << " us; "
+               << input_latency_histogram_;
 }
 
 void Application::Inject(Event* e) {
@@ -269,11 +418,13 @@ void Application::Inject(Event* e) {
 void Application::OnSuspend() {
   SbSpeechSynthesisCancel();
   DestroyNativeWindow();
-  setTimerInterval(ess_timer_fd_, kSbTimeSecond);
+  if ( ess_timer_fd_ != -1 )
+    setTimerInterval(ess_timer_fd_, kSbTimeSecond);
 }
 
 void Application::OnResume() {
-  setTimerInterval(ess_timer_fd_, kEssRunLoopPeriod);
+  if ( ess_timer_fd_ != -1 )
+    setTimerInterval(ess_timer_fd_, EssRunLoopPeriod());
   MaterializeNativeWindow();
 }
 
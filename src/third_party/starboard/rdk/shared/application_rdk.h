@@ -42,10 +42,15 @@
 #include "third_party/starboard/rdk/shared/ess_input.h"
 #include "third_party/starboard/rdk/shared/rdkservices.h"
 #include "third_party/starboard/rdk/shared/hang_detector.h"
+#include "third_party/starboard/rdk/shared/latency_histogram.h"
 
+#include <functional>
 #include <memory>
+#include <vector>
 #include <essos-app.h>
 
+struct wl_display;
+
 namespace third_party {
 namespace starboard {
 namespace rdk {
@@ -109,8 +114,18 @@ class Application : public ::starboard::shared::starboard::QueueApplication {
   void OnDisplaySize(int width, int height);
 
  private:
+  struct ServiceStartup;
+  struct TimedInputData;
+
   void MaterializeNativeWindow();
   void DestroyNativeWindow();
+  // Service clients connect and wait for plugin activation, so they are
+  // built on threads of their own and joined before the first event.
+  void StartServiceClient(const char* name, std::function<void()> create);
+  void WaitForServiceClients();
+  // Time from Essos handing over an input to the end of its dispatch.
+  void RecordInputLatency(SbTime latency);
+  void LogInputLatency() const;
 
   static EssTerminateListener terminateListener;
   static EssKeyListener keyListener;
@@ -125,17 +140,30 @@ class Application : public ::starboard::shared::starboard::QueueApplication {
   bool resize_pending_ { false };
 
   SbTime ess_loop_last_ts_ { 0 };
+  // With a Wayland display its fd drives the Essos loop, the timer is only
+  // used when Essos reads input devices directly.
+  struct wl_display* wl_display_ { nullptr };
+  int ess_display_fd_ { -1 };
   int ess_timer_fd_ { -1 };
   int wakeup_fd_ { -1 };
   int monitor_timer_fd_ { -1 };
 
   std::unique_ptr<DisplayInfo> display_info_ { nullptr };
   std::unique_ptr<HangMonitor> hang_monitor_ { nullptr };
+  // Before |hdcp_profile_|, which reads the focus it publishes.
+  std::unique_ptr<RDKShellInfo> rdkshellinfo_ { nullptr };
   std::unique_ptr<HdcpProfile> hdcp_profile_ { nullptr };
   std::unique_ptr<NetworkInfo> networkinfo_ { nullptr };
-  std::unique_ptr<RDKShellInfo> rdkshellinfo_ { nullptr };
   std::unique_ptr<VoiceInput> voiceinputinfo_ { nullptr };
 
+  uint64_t input_count_ { 0 };
+  SbTime input_latency_total_ { 0 };
+  SbTime input_latency_max_ { 0 };
+  LatencyHistogram input_latency_histogram_;
+
+  SbTimeMonotonic services_start_ { 0 };
+  std::vector<std::unique_ptr<ServiceStartup>> service_startups_;
+
 };
 
 }  // namespace shared
@@ -33,8 +33,12 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <string>
+#include <utility>
+
+#include <time.h>
 
 #include <glib.h>
 #include <gst/app/gstappsrc.h>
@@ -42,6 +46,7 @@
 #include <gst/audio/streamvolume.h>
 #include <gst/gst.h>
 
+#include "starboard/common/condition_variable.h"
 #include "starboard/common/mutex.h"
 #include "starboard/configuration.h"
 #include "starboard/file.h"
@@ -49,6 +54,9 @@
 #include "starboard/shared/starboard/media/media_util.h"
 #include "starboard/thread.h"
 #include "starboard/time.h"
+#include "third_party/starboard/rdk/shared/audio_sink/pcm_converter.h"
+#include "third_party/starboard/rdk/shared/media/gst_main_loop_pool.h"
+#include "third_party/starboard/rdk/shared/tunables.h"
 
 namespace third_party {
 namespace starboard {
@@ -60,9 +68,61 @@ namespace {
 GST_DEBUG_CATEGORY(cobalt_gst_audio_sink_debug);
 #define GST_CAT_DEFAULT cobalt_gst_audio_sink_debug
 
-constexpr int kFramesPerRequest = 1024;
+// Period is the number of frames handed to appsrc per buffer, which also
+// bounds appsrc and the queue. Underruns double it up to the profile's max;
+// after a quiet spell it is halved back towards the profile's default.
+struct LatencyProfile {
+  const char* name;
+  int period_frames;
+  int max_period_frames;
+  SbTime buffer_time;
+};
+
+// In the order of the audio_latency_profile tunable's choices, which also
+// keeps the value in range.
+constexpr LatencyProfile kLatencyProfiles[] = {
+    {"low", 256, 1024, 20 * kSbTimeMillisecond},
+    {"balanced", 1024, 4096, 50 * kSbTimeMillisecond},
+    {"power", 4096, 8192, 200 * kSbTimeMillisecond},
+};
+constexpr SbTime kPeriodShrinkInterval = 10 * kSbTimeSecond;
+constexpr SbTime kLatencyQueryInterval = kSbTimeSecond;
+
+const LatencyProfile& GetLatencyProfile() {
+  return kLatencyProfiles[GetTunable(Tunable::kAudioLatencyProfile)];
+}
+
+// Starboard has no callback for frames being appended to the ring buffer, so
+// while appsrc wants data and none is available the feeder polls with a
+// bounded exponential backoff. It doesn't poll while the source is paused.
+constexpr SbTime kMinStarvedWait = 2 * kSbTimeMillisecond;
+constexpr SbTime kMaxStarvedWait = 16 * kSbTimeMillisecond;
+
+// How long teardown waits for GStreamer to let go of the ring buffer after
+// the pipeline is gone.
+constexpr SbTime kRegionReleaseTimeout = kSbTimeSecond;
+
+GstCaps* CreateAudioCaps(SbMediaAudioSampleType sample_type,
+                         int sampling_frequency_hz,
+                         int channels) {
+  const char* format =
+      sample_type == kSbMediaAudioSampleTypeFloat32 ? "F32LE" : "S16LE";
+  return gst_caps_new_simple(
+      "audio/x-raw", "format", G_TYPE_STRING, format, "rate", G_TYPE_INT,
+      sampling_frequency_hz, "channels", G_TYPE_INT, channels, "layout",
+      G_TYPE_STRING, "interleaved", "channel-mask", GST_TYPE_BITMASK,
+      gst_audio_channel_get_fallback_mask(channels), nullptr);
+}
+
+SbTime GetThreadCpuTime() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    return 0;
+  return ts.tv_sec * kSbTimeSecond + ts.tv_nsec / 1000;
+}
 
 using ::starboard::shared::starboard::media::GetBytesPerSample;
+using third_party::starboard::rdk::shared::media::MainLoopPool;
 
 class GStreamerAudioSink : public SbAudioSinkPrivate {
  public:
@@ -82,8 +142,14 @@ class GStreamerAudioSink : public SbAudioSinkPrivate {
 
   bool IsType(Type* type) override { return type_ == type; }
 
+  // The renderer passes 0 or 1 here and handles other rates itself. While
+  // paused the feeder sleeps until a non-zero rate wakes it.
   void SetPlaybackRate(double playback_rate) override {
-    SB_NOTIMPLEMENTED();
+    if (playback_rate <= 0.0)
+      return;
+    ::starboard::ScopedLock lock(mutex_);
+    resume_pending_ = true;
+    feed_condition_.Signal();
   }
 
   void SetVolume(double volume) override {
@@ -93,7 +159,55 @@ class GStreamerAudioSink : public SbAudioSinkPrivate {
   }
 
  private:
-  static void* AudioThreadEntryPoint(void* context);
+  // A slice of |frame_buffers_| wrapped in a GstMemory. Frames are reported
+  // consumed when GStreamer releases the memory, not when it is pushed.
+  struct FrameRegion {
+    GStreamerAudioSink* sink;
+    uint64_t id;
+  };
+
+  struct PendingRegion {
+    int frames;
+    bool released;
+  };
+
+  // Frames GStreamer let go of, in ring buffer order, for the feed thread to
+  // report.
+  struct ReleasedFrames {
+    int frames;
+    SbTimeMonotonic released_at;
+  };
+
+  // Frames due to be reported consumed once they are heard.
+  struct ConsumeReport {
+    int frames;
+    SbTimeMonotonic due;
+  };
+
+  struct FeedStats {
+    uint64_t wakeups{0};
+    uint64_t starved_wakeups{0};
+    uint64_t need_data{0};
+    uint64_t buffers{0};
+    uint64_t frames{0};
+    SbTime cpu_time{0};
+    SbTime run_time{0};
+    uint64_t underruns{0};
+    uint64_t period_changes{0};
+    SbTime output_latency{0};
+  };
+
+  static void* FeedThreadEntryPoint(void* context);
+  void FeedLoop();
+  void ReportConsumedFrames();
+  bool WaitLocked(SbTime timeout);
+  int PushFrames();
+  void AdaptPeriod();
+  void SetPeriod(int period_frames);
+  SbTime UpdateOutputLatency();
+  static void QueueUnderrunCallback(GstElement* queue, gpointer user_data);
+  void AppendFrameRegion(GstBuffer* buffer, int offset_in_frames, int frames);
+  static void OnFrameRegionReleased(gpointer user_data);
   static gboolean BusMessageCallback(GstBus* bus,
                                      GstMessage* message,
                                      gpointer user_data);
@@ -104,10 +218,29 @@ class GStreamerAudioSink : public SbAudioSinkPrivate {
                                               gchar* name,
                                               gpointer user_data);
 
+  // How the PCM from Cobalt reaches the HAL sink.
+  enum class OutputPath {
+    // Sink takes Cobalt's format as is; buffers wrap the ring buffer.
+    kPassthrough,
+    // Converted by |converter_| while filling the appsrc buffers.
+    kConverted,
+    // appsrc ! audioconvert ! audioresample, for anything else.
+    kGstConvert,
+  };
+
+  GstCaps* NegotiateOutput();
+
   size_t GetBytesPerFrame() const {
     return channels_ * GetBytesPerSample(audio_sample_type_);
   }
 
+  // Size of a frame as pushed into appsrc.
+  size_t GetOutputBytesPerFrame() const {
+    return converter_ ? output_channels_ * GetBytesPerSample(
+                                               kSbMediaAudioSampleTypeInt16)
+                      : GetBytesPerFrame();
+  }
+
   Type* type_{nullptr};
   int channels_{0};
   int sampling_frequency_hz_{0};
@@ -117,19 +250,49 @@ class GStreamerAudioSink : public SbAudioSinkPrivate {
   SbAudioSinkPrivate::ErrorFunc error_func_{nullptr};
   SbAudioSinkFrameBuffers frame_buffers_{nullptr};
   int frame_buffers_size_in_frames_{0};
-  SbThread audio_loop_thread_{kSbThreadInvalid};
+  SbThread feed_thread_{kSbThreadInvalid};
   void* context_{nullptr};
   ::starboard::Mutex mutex_;
+  ::starboard::ConditionVariable feed_condition_{mutex_};
+  // Signaled when the last pending region is released while destroying.
+  ::starboard::ConditionVariable regions_released_{mutex_};
   GstElement* pipeline_{nullptr};
   GstElement* appsrc_{nullptr};
   GstElement* queue_{nullptr};
   GstElement* audiosink_{nullptr};
-  GMainLoop* mainloop_{nullptr};
+  // Only carries the bus watch, shared with other media objects.
   GMainContext* main_loop_context_{nullptr};
   guint source_id_{0};
+  // Guarded by |mutex_|.
   bool destroying_{false};
   bool enough_data_{false};
-  bool appsrc_exit_{false};
+  FeedStats feed_stats_;
+  std::deque<PendingRegion> pending_regions_;
+  uint64_t first_pending_region_{0};
+  std::deque<ReleasedFrames> released_frames_;
+  bool is_playing_{false};
+  bool resume_pending_{false};
+  uint64_t underruns_since_adapt_{0};
+
+  // Only touched by the feed thread, |consume_reports_| also under |mutex_|
+  // so waits can be cut short for them.
+  const LatencyProfile& profile_;
+  // Frames handed to GStreamer and not yet reported consumed. They are
+  // still part of what |update_source_status_func_| says is buffered.
+  int frames_in_flight_{0};
+  // From the last latency query: what is still ahead of frames released by
+  // the sink, and of frames pushed into appsrc. Frames are reported consumed
+  // that much later, when they are heard.
+  SbTime sink_latency_{0};
+  SbTime output_latency_{0};
+  std::deque<ConsumeReport> consume_reports_;
+  int period_frames_{0};
+  SbTimeMonotonic last_period_change_{0};
+  SbTimeMonotonic last_latency_query_{0};
+
+  OutputPath output_path_{OutputPath::kGstConvert};
+  std::unique_ptr<PcmConverter> converter_;
+  int output_channels_{0};
 
   std::string file_name_;
   int total_frames_{0};
@@ -156,7 +319,9 @@ GStreamerAudioSink::GStreamerAudioSink(
       error_func_(error_func),
       frame_buffers_(frame_buffers),
       frame_buffers_size_in_frames_(frame_buffers_size_in_frames),
-      context_(context) {
+      context_(context),
+      profile_(GetLatencyProfile()),
+      period_frames_(profile_.period_frames) {
   GST_DEBUG_CATEGORY_INIT(cobalt_gst_audio_sink_debug, "gstaudsink", 0,
                           "Cobalt audio sink");
 
@@ -166,28 +331,10 @@ GStreamerAudioSink::GStreamerAudioSink(
       << "It seems SbAudioSinkIsAudioFrameStorageTypeSupported() was changed "
       << "without adjustng here.";
 
-  main_loop_context_ = g_main_context_new();
-  mainloop_ = g_main_loop_new(main_loop_context_, FALSE);
+  main_loop_context_ = MainLoopPool::Get()->Acquire(
+      MainLoopPool::Priority::kNormal, "Audio sink");
   g_main_context_push_thread_default(main_loop_context_);
 
-  const char* format =
-      audio_sample_type == kSbMediaAudioSampleTypeFloat32 ? "F32LE" : "S16LE";
-  GstCaps* audio_caps = gst_caps_new_simple(
-      "audio/x-raw", "format", G_TYPE_STRING, format, "rate", G_TYPE_INT,
-      sampling_frequency_hz, "channels", G_TYPE_INT, channels, "layout",
-      G_TYPE_STRING, "interleaved", "channel-mask", GST_TYPE_BITMASK,
-      gst_audio_channel_get_fallback_mask(channels), nullptr);
-
-  appsrc_ = gst_element_factory_make("appsrc", "source");
-  GstAppSrcCallbacks callbacks = {&GStreamerAudioSink::AppSrcNeedData,
-                                  &GStreamerAudioSink::AppSrcEnoughData,
-                                  nullptr};
-  gst_app_src_set_callbacks(GST_APP_SRC(appsrc_), &callbacks, this, nullptr);
-  gst_app_src_set_max_bytes(GST_APP_SRC(appsrc_),
-                            kFramesPerRequest * GetBytesPerFrame());
-  g_object_set(appsrc_, "format", GST_FORMAT_TIME, nullptr);
-  gst_app_src_set_caps(GST_APP_SRC(appsrc_), audio_caps);
-
 #if 0
   audiosink_ = gst_element_factory_make("autoaudiosink", "sink");
   g_signal_connect(
@@ -201,86 +348,353 @@ GStreamerAudioSink::GStreamerAudioSink(
       G_CALLBACK(&GStreamerAudioSink::AutoAudioSinkChildAddedCallback), this);
 #endif
 
+  GstCaps* output_caps = NegotiateOutput();
+
+  appsrc_ = gst_element_factory_make("appsrc", "source");
+  GstAppSrcCallbacks callbacks = {&GStreamerAudioSink::AppSrcNeedData,
+                                  &GStreamerAudioSink::AppSrcEnoughData,
+                                  nullptr};
+  gst_app_src_set_callbacks(GST_APP_SRC(appsrc_), &callbacks, this, nullptr);
+  gst_app_src_set_max_bytes(GST_APP_SRC(appsrc_),
+                            period_frames_ * GetOutputBytesPerFrame());
+  g_object_set(appsrc_, "format", GST_FORMAT_TIME, nullptr);
+  gst_app_src_set_caps(GST_APP_SRC(appsrc_), output_caps);
+  gst_caps_unref(output_caps);
+
   pipeline_ = gst_pipeline_new("audio");
   GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
   source_id_ =
       gst_bus_add_watch(bus, &GStreamerAudioSink::BusMessageCallback, this);
   gst_object_unref(bus);
 
-  GstElement* convert = gst_element_factory_make("audioconvert", nullptr);
-  GstElement* resample = gst_element_factory_make("audioresample", nullptr);
   queue_ = gst_element_factory_make("queue", nullptr);
-  g_object_set(queue_, "max-size-bytes", kFramesPerRequest * GetBytesPerFrame(),
+  g_object_set(queue_, "max-size-bytes",
+               static_cast<guint>(period_frames_ * GetOutputBytesPerFrame()),
                nullptr);
-  gst_bin_add_many(GST_BIN(pipeline_), appsrc_, convert, resample, queue_,
-                   audiosink_, nullptr);
-  gst_element_link_many(appsrc_, convert, resample, queue_, audiosink_,
-                        nullptr);
-  gst_caps_unref(audio_caps);
+  g_signal_connect(queue_, "underrun",
+                   G_CALLBACK(&GStreamerAudioSink::QueueUnderrunCallback),
+                   this);
+  GST_INFO_OBJECT(pipeline_, "Latency profile '%s', period %d frames",
+                  profile_.name, period_frames_);
+  if (GST_IS_AUDIO_BASE_SINK(audiosink_)) {
+    AutoAudioSinkChildAddedCallback(nullptr, G_OBJECT(audiosink_), nullptr,
+                                    this);
+  }
+  if (output_path_ == OutputPath::kGstConvert) {
+    GstElement* convert = gst_element_factory_make("audioconvert", nullptr);
+    GstElement* resample = gst_element_factory_make("audioresample", nullptr);
+    gst_bin_add_many(GST_BIN(pipeline_), appsrc_, convert, resample, queue_,
+                     audiosink_, nullptr);
+    gst_element_link_many(appsrc_, convert, resample, queue_, audiosink_,
+                          nullptr);
+  } else {
+    gst_bin_add_many(GST_BIN(pipeline_), appsrc_, queue_, audiosink_,
+                     nullptr);
+    gst_element_link_many(appsrc_, queue_, audiosink_, nullptr);
+  }
 
   gst_element_set_state(pipeline_, GST_STATE_PLAYING);
 
   g_main_context_pop_thread_default(main_loop_context_);
 
-  audio_loop_thread_ = SbThreadCreate(
-      0, kSbThreadPriorityRealTime, kSbThreadNoAffinity, true, "audio_loop",
-      &GStreamerAudioSink::AudioThreadEntryPoint, this);
-  SB_DCHECK(SbThreadIsValid(audio_loop_thread_));
+  feed_thread_ = SbThreadCreate(
+      0, kSbThreadPriorityRealTime, kSbThreadNoAffinity, true, "audio_feed",
+      &GStreamerAudioSink::FeedThreadEntryPoint, this);
+  SB_DCHECK(SbThreadIsValid(feed_thread_));
 }
 
 GStreamerAudioSink::~GStreamerAudioSink() {
   GST_TRACE_OBJECT(pipeline_, "TID: %d", SbThreadGetId());
+  SbTimeMonotonic teardown_start = SbTimeGetMonotonicNow();
 
   {
     ::starboard::ScopedLock lock(mutex_);
     destroying_ = true;
-    // this will wake up apprsc if it is waiting for data
-    gst_app_src_set_max_bytes(GST_APP_SRC(appsrc_), 1);
+    feed_condition_.Signal();
   }
 
-  while (!appsrc_exit_)
+  // The feeder never blocks for long, it is either waiting on
+  // |feed_condition_| or in a non-blocking push.
+  bool rc = SbThreadJoin(feed_thread_, nullptr);
+  SB_DCHECK(rc);
+
   {
-    SbThreadSleep(5 * kSbTimeMillisecond);
+    ::starboard::ScopedLock lock(mutex_);
+    SB_LOG(INFO) << "Audio feeder: " << feed_stats_.wakeups << " wakeups ("
+                 << feed_stats_.starved_wakeups << " starved), "
+                 << feed_stats_.need_data << " need-data, "
+                 << feed_stats_.buffers << " buffers, " << feed_stats_.frames
+                 << " frames, cpu " << feed_stats_.cpu_time << "us over "
+                 << feed_stats_.run_time << "us";
+    SB_LOG(INFO) << "Audio feeder: profile '" << profile_.name << "', "
+                 << feed_stats_.underruns << " underruns, "
+                 << feed_stats_.period_changes << " period changes, final "
+                 << period_frames_ << " frames, output latency "
+                 << feed_stats_.output_latency << "us";
+    if (feed_stats_.run_time > 0) {
+      SB_LOG(INFO) << "Audio feeder: "
+                   << feed_stats_.wakeups * kSbTimeSecond /
+                          feed_stats_.run_time
+                   << " wakeups/s, cpu "
+                   << 100.0 * feed_stats_.cpu_time / feed_stats_.run_time
+                   << "%";
+    }
   }
 
-  GSource* timeout_src = g_timeout_source_new_seconds(1);
-  g_source_set_callback(timeout_src, [](gpointer data) -> gboolean {
-    g_main_loop_quit((GMainLoop*)data);
-    return G_SOURCE_REMOVE;
-  }, mainloop_, nullptr);
-  g_source_attach(timeout_src, main_loop_context_);
-  g_source_unref(timeout_src);
-
-
-
-  bool rc = SbThreadJoin(audio_loop_thread_, nullptr);
-  SB_DCHECK(rc);
-
-  gst_element_set_state(pipeline_, GST_STATE_NULL);
-  if (source_id_ > -1) {
+  // Nothing left to drain for, the renderer is going away. Once the watch
+  // is gone and the loop went past it, no bus callback can be running.
+  if (source_id_ > 0) {
     GSource* src = g_main_context_find_source_by_id(main_loop_context_, source_id_);
-    g_source_destroy(src);
+    if (src)
+      g_source_destroy(src);
   }
+  MainLoopPool::Fence(main_loop_context_);
+
+  SbTimeMonotonic null_start = SbTimeGetMonotonicNow();
+  gst_element_set_state(pipeline_, GST_STATE_NULL);
+  SbTimeMonotonic null_done = SbTimeGetMonotonicNow();
   GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
   gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
   gst_object_unref(bus);
-  g_main_loop_unref(mainloop_);
   gst_object_unref(pipeline_);
-  g_main_context_unref(main_loop_context_);
+  MainLoopPool::Get()->Release(main_loop_context_);
+
+  // Buffers wrapping the ring buffer may outlive the pipeline in an element
+  // that still holds a ref. Their release notify writes to this sink, and
+  // the ring goes away with the renderer once we return.
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    SbTimeMonotonic deadline = SbTimeGetMonotonicNow() + kRegionReleaseTimeout;
+    while (!pending_regions_.empty()) {
+      SbTime remaining = deadline - SbTimeGetMonotonicNow();
+      if (remaining <= 0) {
+        SB_LOG(ERROR) << "Audio sink destroyed with "
+                      << pending_regions_.size()
+                      << " ring buffer regions still held by GStreamer";
+        SB_DCHECK(pending_regions_.empty());
+        break;
+      }
+      regions_released_.WaitTimed(remaining);
+    }
+  }
+
+  SB_LOG(INFO) << "Audio sink teardown took "
+               << SbTimeGetMonotonicNow() - teardown_start << " us (NULL state "
+               << null_done - null_start << " us)";
+}
+
+// Returns the caps to push with and picks |output_path_|. The sink's
+// template caps are good enough here, the HAL sink does not narrow them
+// further before it is opened.
+GstCaps* GStreamerAudioSink::NegotiateOutput() {
+  GstCaps* audio_caps =
+      CreateAudioCaps(audio_sample_type_, sampling_frequency_hz_, channels_);
+  GstPad* sink_pad = gst_element_get_static_pad(audiosink_, "sink");
+  GstCaps* sink_caps = sink_pad ? gst_pad_query_caps(sink_pad, nullptr)
+                                : nullptr;
+  if (sink_pad)
+    gst_object_unref(sink_pad);
+
+  GstCaps* output_caps = nullptr;
+  if (sink_caps && gst_caps_can_intersect(audio_caps, sink_caps)) {
+    output_path_ = OutputPath::kPassthrough;
+    output_caps = gst_caps_ref(audio_caps);
+  } else if (sink_caps) {
+    int output_channels = channels_ > 2 ? 2 : channels_;
+    std::unique_ptr<PcmConverter> converter =
+        PcmConverter::Create(audio_sample_type_, channels_,
+                             kSbMediaAudioSampleTypeInt16, output_channels);
+    GstCaps* converted_caps =
+        converter ? CreateAudioCaps(kSbMediaAudioSampleTypeInt16,
+                                    sampling_frequency_hz_, output_channels)
+                  : nullptr;
+    if (converted_caps && gst_caps_can_intersect(converted_caps, sink_caps)) {
+      output_path_ = OutputPath::kConverted;
+      converter_ = std::move(converter);
+      output_channels_ = output_channels;
+      output_caps = converted_caps;
+    } else if (converted_caps) {
+      gst_caps_unref(converted_caps);
+    }
+  }
+  if (!output_caps) {
+    output_path_ = OutputPath::kGstConvert;
+    output_caps = gst_caps_ref(audio_caps);
+  }
+
+  SB_LOG(INFO) << "Audio sink output: "
+               << (output_path_ == OutputPath::kPassthrough
+                       ? "passthrough"
+                       : output_path_ == OutputPath::kConverted
+                             ? converter_->name()
+                             : "audioconvert/audioresample");
+  if (sink_caps)
+    gst_caps_unref(sink_caps);
+  gst_caps_unref(audio_caps);
+  return output_caps;
 }
 
 // static
-void* GStreamerAudioSink::AudioThreadEntryPoint(void* context) {
+void* GStreamerAudioSink::FeedThreadEntryPoint(void* context) {
   SB_DCHECK(context);
 
   GStreamerAudioSink* sink = reinterpret_cast<GStreamerAudioSink*>(context);
   GST_TRACE_OBJECT(sink->pipeline_, "TID: %d", SbThreadGetId());
-  g_main_context_push_thread_default(sink->main_loop_context_);
-  g_main_loop_run(sink->mainloop_);
+  sink->FeedLoop();
 
   return nullptr;
 }
 
+void GStreamerAudioSink::FeedLoop() {
+  SbTimeMonotonic start_time = SbTimeGetMonotonicNow();
+  SbTime start_cpu_time = GetThreadCpuTime();
+  SbTime starved_wait = kMinStarvedWait;
+  uint64_t wakeups = 0;
+  uint64_t starved_wakeups = 0;
+
+  for (;;) {
+    bool enough_data = false;
+    {
+      ::starboard::ScopedLock lock(mutex_);
+      while (enough_data_ && released_frames_.empty() && !destroying_ &&
+             WaitLocked(kSbTimeMax)) {
+      }
+      if (destroying_)
+        break;
+      enough_data = enough_data_;
+    }
+    ++wakeups;
+
+    // Before the source status is read, so the in-flight count it is
+    // matched against never lags behind what Cobalt was told.
+    ReportConsumedFrames();
+    if (enough_data)
+      continue;
+
+    SbTimeMonotonic now = SbTimeGetMonotonicNow();
+    if (now - last_latency_query_ >= kLatencyQueryInterval)
+      UpdateOutputLatency();
+    AdaptPeriod();
+    if (PushFrames() > 0) {
+      starved_wait = kMinStarvedWait;
+      continue;
+    }
+
+    ++starved_wakeups;
+    ::starboard::ScopedLock lock(mutex_);
+    if (!is_playing_) {
+      // Polling can't make a paused renderer hand out frames. What the
+      // pipeline still plays out is reported, though.
+      while (!resume_pending_ && released_frames_.empty() && !destroying_ &&
+             WaitLocked(kSbTimeMax)) {
+      }
+      if (resume_pending_) {
+        resume_pending_ = false;
+        starved_wait = kMinStarvedWait;
+      }
+      continue;
+    }
+    if (!enough_data_ && released_frames_.empty() && !destroying_)
+      WaitLocked(starved_wait);
+    starved_wait = std::min(starved_wait * 2, kMaxStarvedWait);
+  }
+
+  GST_DEBUG_OBJECT(pipeline_, "Feeder bailing out");
+  SbTime output_latency = UpdateOutputLatency();
+
+  ::starboard::ScopedLock lock(mutex_);
+  feed_stats_.wakeups = wakeups;
+  feed_stats_.starved_wakeups = starved_wakeups;
+  feed_stats_.cpu_time = GetThreadCpuTime() - start_cpu_time;
+  feed_stats_.run_time = SbTimeGetMonotonicNow() - start_time;
+  feed_stats_.output_latency = output_latency;
+}
+
+void GStreamerAudioSink::AdaptPeriod() {
+  uint64_t underruns = 0;
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    underruns = underruns_since_adapt_;
+    underruns_since_adapt_ = 0;
+  }
+
+  SbTimeMonotonic now = SbTimeGetMonotonicNow();
+  if (underruns > 0) {
+    last_period_change_ = now;
+    if (period_frames_ < profile_.max_period_frames)
+      SetPeriod(std::min(period_frames_ * 2, profile_.max_period_frames));
+  } else if (period_frames_ > profile_.period_frames &&
+             now - last_period_change_ >= kPeriodShrinkInterval) {
+    last_period_change_ = now;
+    SetPeriod(std::max(period_frames_ / 2, profile_.period_frames));
+  }
+}
+
+void GStreamerAudioSink::SetPeriod(int period_frames) {
+  period_frames_ = period_frames;
+  guint64 max_bytes = period_frames_ * GetOutputBytesPerFrame();
+  gst_app_src_set_max_bytes(GST_APP_SRC(appsrc_), max_bytes);
+  g_object_set(queue_, "max-size-bytes", static_cast<guint>(max_bytes),
+               nullptr);
+
+  SbTime output_latency = UpdateOutputLatency();
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    ++feed_stats_.period_changes;
+    feed_stats_.output_latency = output_latency;
+  }
+  GST_INFO_OBJECT(pipeline_,
+                  "Period now %d frames, output latency %" G_GINT64_FORMAT
+                  "us",
+                  period_frames_, static_cast<gint64>(output_latency));
+}
+
+// Data queued in appsrc and the queue plus the latency the pipeline reports
+// for the elements after them. Feed thread only.
+SbTime GStreamerAudioSink::UpdateOutputLatency() {
+  last_latency_query_ = SbTimeGetMonotonicNow();
+  GstClockTime pipeline_latency = 0;
+  GstQuery* query = gst_query_new_latency();
+  if (gst_element_query(pipeline_, query)) {
+    gboolean live = FALSE;
+    GstClockTime max_latency = 0;
+    gst_query_parse_latency(query, &live, &pipeline_latency, &max_latency);
+    if (!GST_CLOCK_TIME_IS_VALID(pipeline_latency))
+      pipeline_latency = 0;
+  }
+  gst_query_unref(query);
+
+  guint64 appsrc_bytes = gst_app_src_get_current_level_bytes(
+      GST_APP_SRC(appsrc_));
+  guint64 queue_time = 0;
+  g_object_get(queue_, "current-level-time", &queue_time, nullptr);
+
+  GstClockTime appsrc_time = gst_util_uint64_scale(
+      appsrc_bytes / GetOutputBytesPerFrame(), GST_SECOND,
+      sampling_frequency_hz_);
+  SbTime sink_latency = pipeline_latency / kSbTimeNanosecondsPerMicrosecond;
+  SbTime output_latency = (pipeline_latency + queue_time + appsrc_time) /
+                          kSbTimeNanosecondsPerMicrosecond;
+  sink_latency_ = sink_latency;
+  output_latency_ = output_latency;
+  return output_latency;
+}
+
+// static
+void GStreamerAudioSink::QueueUnderrunCallback(GstElement* queue,
+                                               gpointer user_data) {
+  SB_UNREFERENCED_PARAMETER(queue);
+  GStreamerAudioSink* sink = static_cast<GStreamerAudioSink*>(user_data);
+
+  ::starboard::ScopedLock lock(sink->mutex_);
+  // The queue also runs dry while paused and while draining at the end.
+  if (!sink->is_playing_ || sink->destroying_)
+    return;
+  ++sink->underruns_since_adapt_;
+  ++sink->feed_stats_.underruns;
+  GST_DEBUG_OBJECT(sink->pipeline_, "Queue underrun");
+}
+
 // static
 gboolean GStreamerAudioSink::BusMessageCallback(GstBus* bus,
                                                 GstMessage* message,
@@ -295,8 +709,6 @@ gboolean GStreamerAudioSink::BusMessageCallback(GstBus* bus,
     case GST_MESSAGE_EOS:
       if (GST_MESSAGE_SRC(message) == GST_OBJECT(sink->pipeline_)) {
         GST_INFO_OBJECT(sink->pipeline_, "EOS");
-        if (sink->destroying_)
-          g_main_loop_quit(sink->mainloop_);
       }
       break;
 
@@ -348,109 +760,222 @@ void GStreamerAudioSink::AppSrcNeedData(GstAppSrc* src,
                                         guint length,
                                         gpointer user_data) {
   SB_UNREFERENCED_PARAMETER(src);
+  SB_UNREFERENCED_PARAMETER(length);
 
   GStreamerAudioSink* sink = reinterpret_cast<GStreamerAudioSink*>(user_data);
 
   GST_TRACE_OBJECT(sink->pipeline_, "TID: %d", SbThreadGetId());
 
+  ::starboard::ScopedLock lock(sink->mutex_);
   sink->enough_data_ = false;
+  ++sink->feed_stats_.need_data;
+  sink->feed_condition_.Signal();
+}
+
+int GStreamerAudioSink::PushFrames() {
   int frames_in_buffer = 0;
   int offset_in_frames = 0;
   bool is_playing = true;
   bool is_eos_reached = false;
-  sink->appsrc_exit_ = false;
-  while (/*!is_eos_reached &&*/ !sink->enough_data_) {
-    bool destroying = false;
-    {
-      ::starboard::ScopedLock lock(sink->mutex_);
-      destroying = sink->destroying_;
+  update_source_status_func_(&frames_in_buffer, &offset_in_frames,
+                             &is_playing, &is_eos_reached, context_);
+  GST_DEBUG_OBJECT(pipeline_,
+                   "Updated: frames in buff: %d, offset: %d"
+                   " is_playing: %d, eos %d",
+                   frames_in_buffer, offset_in_frames, is_playing,
+                   is_eos_reached);
+
+  // Frames already handed to GStreamer stay in |frames_in_buffer| until
+  // they are reported consumed, so skip past them.
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    is_playing_ = is_playing;
+  }
+  int frames_to_write =
+      std::min(period_frames_, frames_in_buffer - frames_in_flight_);
+
+  if (!is_playing || frames_to_write <= 0)
+    return 0;
+
+  int start_in_frames =
+      (offset_in_frames + frames_in_flight_) % frame_buffers_size_in_frames_;
+  int head_frames =
+      std::min(frames_to_write, frame_buffers_size_in_frames_ - start_in_frames);
+
+  GstBuffer* buffer = nullptr;
+  if (converter_) {
+    buffer = gst_buffer_new_allocate(
+        nullptr, frames_to_write * GetOutputBytesPerFrame(), nullptr);
+    GstMapInfo info;
+    gst_buffer_map(buffer, &info, GST_MAP_WRITE);
+    const uint8_t* ring = static_cast<const uint8_t*>(frame_buffers_[0]);
+    converter_->Convert(ring + start_in_frames * GetBytesPerFrame(),
+                        info.data, head_frames);
+    if (head_frames < frames_to_write) {
+      uint8_t* tail = info.data + head_frames * GetOutputBytesPerFrame();
+      converter_->Convert(ring, tail, frames_to_write - head_frames);
     }
+    gst_buffer_unmap(buffer, &info);
+  } else {
+    buffer = gst_buffer_new();
+    AppendFrameRegion(buffer, start_in_frames, head_frames);
+    if (head_frames < frames_to_write)
+      AppendFrameRegion(buffer, 0, frames_to_write - head_frames);
+  }
 
-    if (destroying) {
-      GST_DEBUG_OBJECT(sink->pipeline_,
-                       "GStreamerAudioSink::AppSrcNeedData "
-                       "bailing out");
-      gst_app_src_end_of_stream(GST_APP_SRC(sink->appsrc_));
-      sink->appsrc_exit_ = true;
-      return;
-    } else {
-      sink->update_source_status_func_(&frames_in_buffer, &offset_in_frames,
-                                       &is_playing, &is_eos_reached,
-                                       sink->context_);
-      GST_DEBUG_OBJECT(sink->pipeline_,
-                       "Updated: frames in buff: %d, offset: %d"
-                       " is_playing: %d, eos %d",
-                       frames_in_buffer, offset_in_frames, is_playing,
-                       is_eos_reached);
-
-      int frames_to_write = ((frames_in_buffer + offset_in_frames) < sink->frame_buffers_size_in_frames_)
-          ? frames_in_buffer
-          : sink->frame_buffers_size_in_frames_ - offset_in_frames;
-
-      frames_to_write = std::min(kFramesPerRequest, frames_to_write);
-
-      if (is_playing && frames_to_write > 0) {
-          GstBuffer* buffer = gst_buffer_new_allocate(
-              nullptr, frames_to_write * sink->GetBytesPerFrame(), nullptr);
-          uint8_t* beginning = static_cast<uint8_t*>(sink->frame_buffers_[0]) +
-                               offset_in_frames * sink->GetBytesPerFrame();
-          gst_buffer_fill(buffer, 0, beginning,
-                          frames_to_write * sink->GetBytesPerFrame());
-          GST_DEBUG_OBJECT(sink->pipeline_, "Pushing %d frames (%zd bytes)",
-                           frames_to_write,
-                           frames_to_write * sink->GetBytesPerFrame());
-          auto timestamp = gst_util_uint64_scale(
-              sink->total_frames_, GST_SECOND, sink->sampling_frequency_hz_);
-          GST_BUFFER_TIMESTAMP(buffer) = timestamp;
-          sink->total_frames_ += frames_to_write;
-          GST_BUFFER_DURATION(buffer) =
-              gst_util_uint64_scale(sink->total_frames_, GST_SECOND,
-                                    sink->sampling_frequency_hz_) -
-              timestamp;
-          GST_DEBUG_OBJECT(sink->pipeline_,
-                           "Buffer to be pushed has %" GST_TIME_FORMAT
-                           " ts and %" GST_TIME_FORMAT " dur",
-                           GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buffer)),
-                           GST_TIME_ARGS(GST_BUFFER_DURATION(buffer)));
-          gst_app_src_push_buffer(GST_APP_SRC(sink->appsrc_), buffer);
-
-          GST_DEBUG_OBJECT(sink->pipeline_,
-                           "Update consumed by %d. Total %d"
-                           "(%zd b)",
-                           frames_to_write, sink->total_frames_,
-                           sink->total_frames_ * sink->GetBytesPerFrame());
-          sink->consume_frame_func_(frames_to_write,
-                                    SbTimeGetMonotonicNow(),
-                                    sink->context_);
+  GST_DEBUG_OBJECT(pipeline_, "Pushing %d frames (%zd bytes) in %u memories",
+                   frames_to_write, frames_to_write * GetOutputBytesPerFrame(),
+                   gst_buffer_n_memory(buffer));
+  auto timestamp = gst_util_uint64_scale(
+      total_frames_, GST_SECOND, sampling_frequency_hz_);
+  GST_BUFFER_TIMESTAMP(buffer) = timestamp;
+  total_frames_ += frames_to_write;
+  GST_BUFFER_DURATION(buffer) =
+      gst_util_uint64_scale(total_frames_, GST_SECOND,
+                            sampling_frequency_hz_) -
+      timestamp;
+  GST_DEBUG_OBJECT(pipeline_,
+                   "Buffer to be pushed has %" GST_TIME_FORMAT
+                   " ts and %" GST_TIME_FORMAT " dur",
+                   GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buffer)),
+                   GST_TIME_ARGS(GST_BUFFER_DURATION(buffer)));
 
 #if defined(DUMP_PCM_TO_FILE)
-          if (sink->file_name_.empty()) {
-            sink->file_name_ = "/tmp/sound" +
-                               std::to_string(SbTimeToPosix(SbTimeGetNow())) +
-                               ".pcm";
-          }
-          SbFileError error;
-          bool created;
-          SbFile file = SbFileOpen(
-              sink->file_name_.c_str(),
-              SbFileFlags::kSbFileOpenAlways | SbFileFlags::kSbFileWrite,
-              &created, &error);
-          if (SbFileIsValid(file)) {
-            SbFileSeek(file, SbFileWhence::kSbFileFromEnd, 0);
-            SbFileWrite(file,
-                        static_cast<const char*>(sink->frame_buffers_[0]) +
-                            offset_in_frames * sink->GetBytesPerFrame(),
-                        frames_to_write * sink->GetBytesPerFrame());
-            SbFileClose(file);
-          }
-#endif
+  if (file_name_.empty()) {
+    file_name_ = "/tmp/sound" +
+                 std::to_string(SbTimeToPosix(SbTimeGetNow())) + ".pcm";
+  }
+  SbFileError error;
+  bool created;
+  SbFile file = SbFileOpen(
+      file_name_.c_str(),
+      SbFileFlags::kSbFileOpenAlways | SbFileFlags::kSbFileWrite,
+      &created, &error);
+  if (SbFileIsValid(file)) {
+    SbFileSeek(file, SbFileWhence::kSbFileFromEnd, 0);
+    for (guint i = 0; i < gst_buffer_n_memory(buffer); ++i) {
+      GstMapInfo info;
+      GstMemory* memory = gst_buffer_peek_memory(buffer, i);
+      if (gst_memory_map(memory, &info, GST_MAP_READ)) {
+        SbFileWrite(file, reinterpret_cast<const char*>(info.data),
+                    info.size);
+        gst_memory_unmap(memory, &info);
       }
+    }
+    SbFileClose(file);
+  }
+#endif
 
-      if (!is_playing || frames_in_buffer <= 0) {
-          SbThreadSleep(5 * kSbTimeMillisecond);
-      }
+  gst_app_src_push_buffer(GST_APP_SRC(appsrc_), buffer);
+
+  // The ring buffer is done with once converted, so the frames are consumed
+  // once the pipeline played them out, not on release.
+  if (converter_)
+    frames_in_flight_ += frames_to_write;
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    if (converter_) {
+      consume_reports_.push_back(ConsumeReport{
+          frames_to_write, SbTimeGetMonotonicNow() + output_latency_});
     }
+    ++feed_stats_.buffers;
+    feed_stats_.frames += frames_to_write;
   }
+  return frames_to_write;
+}
+
+void GStreamerAudioSink::AppendFrameRegion(GstBuffer* buffer,
+                                           int offset_in_frames,
+                                           int frames) {
+  FrameRegion* region = new FrameRegion;
+  region->sink = this;
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    region->id = first_pending_region_ + pending_regions_.size();
+    pending_regions_.push_back(PendingRegion{frames, false});
+  }
+  frames_in_flight_ += frames;
+
+  gsize size = frames * GetBytesPerFrame();
+  uint8_t* data = static_cast<uint8_t*>(frame_buffers_[0]) +
+                  offset_in_frames * GetBytesPerFrame();
+  GstMemory* memory = gst_memory_new_wrapped(
+      GST_MEMORY_FLAG_READONLY, data, size, 0, size, region,
+      &GStreamerAudioSink::OnFrameRegionReleased);
+  gst_buffer_append_memory(buffer, memory);
+}
+
+// static
+void GStreamerAudioSink::OnFrameRegionReleased(gpointer user_data) {
+  std::unique_ptr<FrameRegion> region(static_cast<FrameRegion*>(user_data));
+  GStreamerAudioSink* sink = region->sink;
+
+  ::starboard::ScopedLock lock(sink->mutex_);
+  SB_DCHECK(region->id >= sink->first_pending_region_);
+  sink->pending_regions_[region->id - sink->first_pending_region_].released =
+      true;
+  // Cobalt only tracks a read position, so report consumption in order even
+  // if an element downstream lets go of a later region first.
+  int consumed = 0;
+  while (!sink->pending_regions_.empty() &&
+         sink->pending_regions_.front().released) {
+    consumed += sink->pending_regions_.front().frames;
+    sink->pending_regions_.pop_front();
+    ++sink->first_pending_region_;
+  }
+  if (sink->destroying_) {
+    if (sink->pending_regions_.empty())
+      sink->regions_released_.Signal();
+    return;
+  }
+  if (consumed == 0)
+    return;
+  // The feed thread reports them, a report from here could land between its
+  // read of the source status and of |frames_in_flight_|.
+  sink->released_frames_.push_back(
+      ReleasedFrames{consumed, SbTimeGetMonotonicNow()});
+  sink->feed_condition_.Signal();
+}
+
+// Reports what has been heard by now, with the time it was. Feed thread
+// only.
+void GStreamerAudioSink::ReportConsumedFrames() {
+  std::deque<ConsumeReport> due;
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    for (const ReleasedFrames& entry : released_frames_) {
+      consume_reports_.push_back(
+          ConsumeReport{entry.frames, entry.released_at + sink_latency_});
+    }
+    released_frames_.clear();
+    SbTimeMonotonic now = SbTimeGetMonotonicNow();
+    while (!consume_reports_.empty() && consume_reports_.front().due <= now) {
+      due.push_back(consume_reports_.front());
+      consume_reports_.pop_front();
+    }
+  }
+  for (const ConsumeReport& report : due) {
+    frames_in_flight_ -= report.frames;
+    GST_LOG_OBJECT(pipeline_, "Consumed %d frames, %d still in flight",
+                   report.frames, frames_in_flight_);
+    consume_frame_func_(report.frames, report.due, context_);
+  }
+}
+
+// Waits on |feed_condition_| for at most |timeout|, cut short when a consume
+// report falls due. Returns false without waiting if one is due already.
+bool GStreamerAudioSink::WaitLocked(SbTime timeout) {
+  if (!consume_reports_.empty()) {
+    timeout = std::min(
+        timeout, consume_reports_.front().due - SbTimeGetMonotonicNow());
+  }
+  if (timeout <= 0)
+    return false;
+  if (timeout == kSbTimeMax)
+    feed_condition_.Wait();
+  else
+    feed_condition_.WaitTimed(timeout);
+  return true;
 }
 
 // static
@@ -458,6 +983,7 @@ void GStreamerAudioSink::AppSrcEnoughData(GstAppSrc* src, gpointer user_data) {
   SB_UNREFERENCED_PARAMETER(src);
   GStreamerAudioSink* sink = static_cast<GStreamerAudioSink*>(user_data);
 
+  ::starboard::ScopedLock lock(sink->mutex_);
   sink->enough_data_ = true;
   GST_TRACE_OBJECT(sink->pipeline_, "TID: %d", SbThreadGetId());
 }
@@ -471,13 +997,11 @@ void GStreamerAudioSink::AutoAudioSinkChildAddedCallback(GstChildProxy* obj,
   SB_UNREFERENCED_PARAMETER(name);
   GStreamerAudioSink* sink = static_cast<GStreamerAudioSink*>(user_data);
   if (GST_IS_AUDIO_BASE_SINK(object)) {
-    static constexpr int kLatencyTimeValue = 50;
     g_object_set(GST_AUDIO_BASE_SINK(object), "buffer-time",
-                 static_cast<gint64>(kLatencyTimeValue * kSbTimeMillisecond),
-                 nullptr);
+                 static_cast<gint64>(sink->profile_.buffer_time), nullptr);
     g_object_set(sink->queue_, "min-threshold-time",
-                 kLatencyTimeValue * kSbTimeMillisecond *
-                     kSbTimeNanosecondsPerMicrosecond,
+                 static_cast<guint64>(sink->profile_.buffer_time *
+                                      kSbTimeNanosecondsPerMicrosecond),
                  nullptr);
   }
 }
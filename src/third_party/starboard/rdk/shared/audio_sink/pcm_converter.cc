@@ -0,0 +1,251 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/audio_sink/pcm_converter.h"
+
+#include <stdint.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAS_NEON_KERNELS 1
+#endif
+
+#include "starboard/cpu_features.h"
+
+#include "third_party/starboard/rdk/shared/log_override.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace audio_sink {
+namespace {
+
+// 5.1 to stereo downmix, Cobalt channel order FL FR C LFE SL SR. Centre and
+// surround go in at -3 dB, LFE is dropped, and the sum is normalised so a
+// full scale input on every channel can't clip.
+constexpr float kFrontGain = 0.41421356f;  // 1 / (1 + 2 * 0.7071)
+constexpr float kSideGain = 0.29289322f;   // 0.7071 / (1 + 2 * 0.7071)
+constexpr int16_t kFrontGainQ15 = 13573;
+constexpr int16_t kSideGainQ15 = 9598;
+
+// NaN fails every comparison and comes out as 0, which is what the NEON
+// conversion makes of it too.
+inline int16_t ScaledFloatToS16(float scaled) {
+  if (scaled >= 32767.f)
+    return 32767;
+  if (scaled > -32768.f)
+    return static_cast<int16_t>(scaled);
+  if (scaled <= -32768.f)
+    return -32768;
+  return 0;
+}
+
+inline int16_t SaturateS16(int32_t value) {
+  if (value > 32767)
+    return 32767;
+  if (value < -32768)
+    return -32768;
+  return static_cast<int16_t>(value);
+}
+
+void ConvertF32ToS16(const void* source, void* destination, int frames,
+                     int channels) {
+  const float* in = static_cast<const float*>(source);
+  int16_t* out = static_cast<int16_t*>(destination);
+  for (int i = 0; i < frames * channels; ++i)
+    out[i] = ScaledFloatToS16(in[i] * 32768.f);
+}
+
+void DownmixS16ToStereoS16(const void* source, void* destination, int frames,
+                           int channels) {
+  const int16_t* in = static_cast<const int16_t*>(source);
+  int16_t* out = static_cast<int16_t*>(destination);
+  for (int i = 0; i < frames; ++i, in += 6, out += 2) {
+    int32_t l = in[0] * kFrontGainQ15 + (in[2] + in[4]) * kSideGainQ15;
+    int32_t r = in[1] * kFrontGainQ15 + (in[2] + in[5]) * kSideGainQ15;
+    out[0] = SaturateS16(l >> 15);
+    out[1] = SaturateS16(r >> 15);
+  }
+}
+
+void DownmixF32ToStereoS16(const void* source, void* destination, int frames,
+                           int channels) {
+  const float* in = static_cast<const float*>(source);
+  int16_t* out = static_cast<int16_t*>(destination);
+  for (int i = 0; i < frames; ++i, in += 6, out += 2) {
+    float l = in[0] * kFrontGain + (in[2] + in[4]) * kSideGain;
+    float r = in[1] * kFrontGain + (in[2] + in[5]) * kSideGain;
+    out[0] = ScaledFloatToS16(l * 32768.f);
+    out[1] = ScaledFloatToS16(r * 32768.f);
+  }
+}
+
+#if defined(HAS_NEON_KERNELS)
+
+// vcvtq_s32_f32 truncates like the scalar cast and turns NaN into 0, and
+// vqmovn_s32 provides the clamping, so both paths produce identical output.
+void ConvertF32ToS16Neon(const void* source, void* destination, int frames,
+                         int channels) {
+  const float* in = static_cast<const float*>(source);
+  int16_t* out = static_cast<int16_t*>(destination);
+  const int samples = frames * channels;
+  const float32x4_t scale = vdupq_n_f32(32768.f);
+  int i = 0;
+  for (; i + 8 <= samples; i += 8) {
+    int32x4_t a = vcvtq_s32_f32(vmulq_f32(vld1q_f32(in + i), scale));
+    int32x4_t b = vcvtq_s32_f32(vmulq_f32(vld1q_f32(in + i + 4), scale));
+    vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+  }
+  for (; i < samples; ++i)
+    out[i] = ScaledFloatToS16(in[i] * 32768.f);
+}
+
+void DownmixS16ToStereoS16Neon(const void* source, void* destination,
+                               int frames, int channels) {
+  const int16_t* in = static_cast<const int16_t*>(source);
+  int16_t* out = static_cast<int16_t*>(destination);
+  int i = 0;
+  for (; i + 4 <= frames; i += 4, in += 24, out += 8) {
+    // Lanes alternate between two channels: {FL, LFE}, {FR, SL}, {C, SR}.
+    int16x8x3_t v = vld3q_s16(in);
+    int16x4x2_t fl_lfe = vuzp_s16(vget_low_s16(v.val[0]),
+                                  vget_high_s16(v.val[0]));
+    int16x4x2_t fr_sl = vuzp_s16(vget_low_s16(v.val[1]),
+                                 vget_high_s16(v.val[1]));
+    int16x4x2_t c_sr = vuzp_s16(vget_low_s16(v.val[2]),
+                                vget_high_s16(v.val[2]));
+
+    int32x4_t l = vmull_n_s16(fl_lfe.val[0], kFrontGainQ15);
+    l = vmlal_n_s16(l, c_sr.val[0], kSideGainQ15);
+    l = vmlal_n_s16(l, fr_sl.val[1], kSideGainQ15);
+    int32x4_t r = vmull_n_s16(fr_sl.val[0], kFrontGainQ15);
+    r = vmlal_n_s16(r, c_sr.val[0], kSideGainQ15);
+    r = vmlal_n_s16(r, c_sr.val[1], kSideGainQ15);
+
+    int16x4x2_t stereo;
+    stereo.val[0] = vqshrn_n_s32(l, 15);
+    stereo.val[1] = vqshrn_n_s32(r, 15);
+    vst2_s16(out, stereo);
+  }
+  DownmixS16ToStereoS16(in, out, frames - i, channels);
+}
+
+// Same operations in the same order as DownmixF32ToStereoS16(): the side
+// pair is summed, both gains applied, then the sum is scaled. The outputs
+// match as long as the compiler doesn't fuse the scalar multiply-adds.
+void DownmixF32ToStereoS16Neon(const void* source, void* destination,
+                               int frames, int channels) {
+  const float* in = static_cast<const float*>(source);
+  int16_t* out = static_cast<int16_t*>(destination);
+  const float32x4_t front = vdupq_n_f32(kFrontGain);
+  const float32x4_t side = vdupq_n_f32(kSideGain);
+  const float32x4_t scale = vdupq_n_f32(32768.f);
+  int i = 0;
+  for (; i + 4 <= frames; i += 4, in += 24, out += 8) {
+    float32x4x3_t a = vld3q_f32(in);
+    float32x4x3_t b = vld3q_f32(in + 12);
+    float32x4x2_t fl_lfe = vuzpq_f32(a.val[0], b.val[0]);
+    float32x4x2_t fr_sl = vuzpq_f32(a.val[1], b.val[1]);
+    float32x4x2_t c_sr = vuzpq_f32(a.val[2], b.val[2]);
+
+    float32x4_t l = vaddq_f32(
+        vmulq_f32(fl_lfe.val[0], front),
+        vmulq_f32(vaddq_f32(c_sr.val[0], fr_sl.val[1]), side));
+    float32x4_t r = vaddq_f32(
+        vmulq_f32(fr_sl.val[0], front),
+        vmulq_f32(vaddq_f32(c_sr.val[0], c_sr.val[1]), side));
+
+    int16x4x2_t stereo;
+    stereo.val[0] = vqmovn_s32(vcvtq_s32_f32(vmulq_f32(l, scale)));
+    stereo.val[1] = vqmovn_s32(vcvtq_s32_f32(vmulq_f32(r, scale)));
+    vst2_s16(out, stereo);
+  }
+  DownmixF32ToStereoS16(in, out, frames - i, channels);
+}
+
+bool CanUseNeon() {
+  static const bool has_neon = []() {
+    SbCPUFeatures features;
+    return SbCPUFeaturesGet(&features) && features.arm.has_neon;
+  }();
+  return has_neon;
+}
+
+#endif  // defined(HAS_NEON_KERNELS)
+
+}  // namespace
+
+// static
+std::unique_ptr<PcmConverter> PcmConverter::Create(
+    SbMediaAudioSampleType source_type,
+    int source_channels,
+    SbMediaAudioSampleType destination_type,
+    int destination_channels) {
+  if (destination_type != kSbMediaAudioSampleTypeInt16)
+    return nullptr;
+
+#if defined(HAS_NEON_KERNELS)
+  const bool neon = CanUseNeon();
+#endif
+  Kernel kernel = nullptr;
+  const char* name = nullptr;
+
+  if (source_type == kSbMediaAudioSampleTypeFloat32 &&
+      source_channels == destination_channels) {
+    kernel = ConvertF32ToS16;
+    name = "f32-to-s16";
+#if defined(HAS_NEON_KERNELS)
+    if (neon) {
+      kernel = ConvertF32ToS16Neon;
+      name = "f32-to-s16-neon";
+    }
+#endif
+  } else if (source_channels == 6 && destination_channels == 2 &&
+             source_type == kSbMediaAudioSampleTypeInt16) {
+    kernel = DownmixS16ToStereoS16;
+    name = "s16-5.1-to-s16-stereo";
+#if defined(HAS_NEON_KERNELS)
+    if (neon) {
+      kernel = DownmixS16ToStereoS16Neon;
+      name = "s16-5.1-to-s16-stereo-neon";
+    }
+#endif
+  } else if (source_channels == 6 && destination_channels == 2 &&
+             source_type == kSbMediaAudioSampleTypeFloat32) {
+    kernel = DownmixF32ToStereoS16;
+    name = "f32-5.1-to-s16-stereo";
+#if defined(HAS_NEON_KERNELS)
+    if (neon) {
+      kernel = DownmixF32ToStereoS16Neon;
+      name = "f32-5.1-to-s16-stereo-neon";
+    }
+#endif
+  }
+
+  if (!kernel)
+    return nullptr;
+  SB_LOG(INFO) << "Using " << name << " PCM conversion";
+  return std::unique_ptr<PcmConverter>(
+      new PcmConverter(kernel, source_channels, name));
+}
+
+}  // namespace audio_sink
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,71 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_AUDIO_SINK_PCM_CONVERTER_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_AUDIO_SINK_PCM_CONVERTER_H_
+
+#include <memory>
+
+#include "starboard/media.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace audio_sink {
+
+// Interleaved PCM conversions the audio sink does itself instead of going
+// through audioconvert. Supported pairs:
+//   F32 N ch -> S16 N ch
+//   S16 5.1  -> S16 stereo
+//   F32 5.1  -> S16 stereo
+// NEON kernels are used when the build has them and the CPU reports NEON.
+class PcmConverter {
+ public:
+  typedef void (*Kernel)(const void* source,
+                         void* destination,
+                         int frames,
+                         int channels);
+
+  // Returns null if there is no kernel for the requested pair.
+  static std::unique_ptr<PcmConverter> Create(
+      SbMediaAudioSampleType source_type,
+      int source_channels,
+      SbMediaAudioSampleType destination_type,
+      int destination_channels);
+
+  void Convert(const void* source, void* destination, int frames) const {
+    kernel_(source, destination, frames, source_channels_);
+  }
+
+  const char* name() const { return name_; }
+
+ private:
+  PcmConverter(Kernel kernel, int source_channels, const char* name)
+      : kernel_(kernel), source_channels_(source_channels), name_(name) {}
+
+  Kernel kernel_;
+  int source_channels_;
+  const char* name_;
+};
+
+}  // namespace audio_sink
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_AUDIO_SINK_PCM_CONVERTER_H_
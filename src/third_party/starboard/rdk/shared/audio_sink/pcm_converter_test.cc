@@ -0,0 +1,135 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/audio_sink/pcm_converter.h"
+
+#include <stdint.h>
+
+#include <limits>
+#include <vector>
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace audio_sink {
+namespace {
+
+// Runs whichever kernel Create() picks for this CPU. The sample counts are
+// chosen so the NEON kernels go through both their vector loop and the
+// scalar tail, and the two have to agree.
+
+const float kNaN = std::numeric_limits<float>::quiet_NaN();
+const float kInfinity = std::numeric_limits<float>::infinity();
+
+TEST(PcmConverterTest, UnsupportedPairs) {
+  EXPECT_FALSE(PcmConverter::Create(kSbMediaAudioSampleTypeInt16, 2,
+                                    kSbMediaAudioSampleTypeFloat32, 2));
+  EXPECT_FALSE(PcmConverter::Create(kSbMediaAudioSampleTypeFloat32, 2,
+                                    kSbMediaAudioSampleTypeInt16, 6));
+  EXPECT_FALSE(PcmConverter::Create(kSbMediaAudioSampleTypeInt16, 8,
+                                    kSbMediaAudioSampleTypeInt16, 2));
+}
+
+TEST(PcmConverterTest, FloatToS16) {
+  auto converter = PcmConverter::Create(kSbMediaAudioSampleTypeFloat32, 2,
+                                        kSbMediaAudioSampleTypeInt16, 2);
+  ASSERT_TRUE(converter);
+
+  const std::vector<float> in = {
+      0.f,  0.5f,  -0.5f,     1.f,        -1.f,  2.f,   -2.f,      0.25f,
+      -0.25f, 0.999f, -0.999f, 1e-6f,
+  };
+  const std::vector<int16_t> expected = {
+      0,     16384, -16384, 32767,  -32768, 32767, -32768, 8192,
+      -8192, 32735, -32735, 0,
+  };
+  std::vector<int16_t> out(in.size());
+  converter->Convert(in.data(), out.data(), in.size() / 2);
+  EXPECT_EQ(expected, out);
+}
+
+TEST(PcmConverterTest, FloatToS16NaNAndInfinity) {
+  auto converter = PcmConverter::Create(kSbMediaAudioSampleTypeFloat32, 2,
+                                        kSbMediaAudioSampleTypeInt16, 2);
+  ASSERT_TRUE(converter);
+
+  // NaN in the vector part and in the tail.
+  const std::vector<float> in = {
+      kNaN, 0.5f, kInfinity, -kInfinity, -kNaN, 0.f, 0.f, 0.f,
+      kNaN, -0.5f,
+  };
+  const std::vector<int16_t> expected = {
+      0, 16384, 32767, -32768, 0, 0, 0, 0,
+      0, -16384,
+  };
+  std::vector<int16_t> out(in.size());
+  converter->Convert(in.data(), out.data(), in.size() / 2);
+  EXPECT_EQ(expected, out);
+}
+
+TEST(PcmConverterTest, DownmixS16) {
+  auto converter = PcmConverter::Create(kSbMediaAudioSampleTypeInt16, 6,
+                                        kSbMediaAudioSampleTypeInt16, 2);
+  ASSERT_TRUE(converter);
+
+  // FL FR C LFE SL SR, five frames.
+  const std::vector<int16_t> in = {
+      0,      0,      0,      0,      0,      0,
+      32767,  0,      0,      32767,  0,      0,
+      0,      0,      32767,  0,      0,      0,
+      32767,  32767,  32767,  32767,  32767,  32767,
+      -32768, -32768, -32768, -32768, -32768, -32768,
+  };
+  const std::vector<int16_t> expected = {
+      0, 0, 13572, 0, 9597, 9597, 32767, 32767, -32768, -32768,
+  };
+  std::vector<int16_t> out(10);
+  converter->Convert(in.data(), out.data(), 5);
+  EXPECT_EQ(expected, out);
+}
+
+TEST(PcmConverterTest, DownmixFloatNaN) {
+  auto converter = PcmConverter::Create(kSbMediaAudioSampleTypeFloat32, 6,
+                                        kSbMediaAudioSampleTypeInt16, 2);
+  ASSERT_TRUE(converter);
+
+  // A NaN on one side only spoils that side, in the vector part and in the
+  // tail.
+  const std::vector<float> in = {
+      kNaN, 0.f,  0.f, 0.f, 0.f, 0.f,
+      1.f,  1.f,  1.f, 1.f, 1.f, 1.f,
+      0.f,  kNaN, 0.f, 0.f, 0.f, 0.f,
+      0.f,  0.f,  0.f, 0.f, 0.f, 0.f,
+      0.f,  0.f,  0.f, 0.f, 0.f, kNaN,
+  };
+  const std::vector<int16_t> expected = {
+      0, 0, 32767, 32767, 0, 0, 0, 0, 0, 0,
+  };
+  std::vector<int16_t> out(10);
+  converter->Convert(in.data(), out.data(), 5);
+  EXPECT_EQ(expected, out);
+}
+
+}  // namespace
+}  // namespace audio_sink
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
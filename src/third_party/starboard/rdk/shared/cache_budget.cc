@@ -0,0 +1,248 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/cache_budget.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "starboard/common/log.h"
+#include "starboard/media.h"
+#include "starboard/once.h"
+#include "starboard/thread.h"
+#include "starboard/time.h"
+
+#include "third_party/starboard/rdk/shared/application_rdk.h"
+#include "third_party/starboard/rdk/shared/device_properties.h"
+#include "third_party/starboard/rdk/shared/meminfo.h"
+#include "third_party/starboard/rdk/shared/tunables.h"
+
+#include "third_party/starboard/rdk/shared/log_override.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace {
+
+// Budgets at scale 1, what a 1080p box with about 1 GB of RAM runs well with.
+const int64_t kImageCacheBase = 32 * kMegabyte;
+const int64_t kSkiaCacheBase = 4 * kMegabyte;
+const int64_t kRemoteTypefaceCacheBase = 4 * kMegabyte;
+const int64_t kMeshCacheBase = 1 * kMegabyte;
+const int64_t kOffscreenTargetCacheBase = 8 * kMegabyte;
+
+// The device class comes from MemTotal: what is left once the media buffers
+// for the display, the system and the rest of Cobalt (JS heap, GL, decoders)
+// are taken out, relative to the same on the reference box. MemAvailable at
+// startup only caps it, so the caches always fit in what is free.
+const int64_t kReferenceTotal = 1024 * kMegabyte;
+const int64_t kMemoryClassStep = 256 * kMegabyte;
+const int64_t kSystemReserve = 320 * kMegabyte;
+const int64_t kOtherReserve = 160 * kMegabyte;
+const double kScaleStep = 0.25;
+const double kMinScale = 0.25;
+const double kMaxScale = 2.0;
+const double kLowMemScale = 0.5;
+
+// Cobalt sizes these two from the display resolution when left at -1, which
+// is what the reference box wants.
+const int kAutoSize = -1;
+
+const SbTime kMeasureInterval = 5 * kSbTimeSecond;
+const SbTime kMeasureReportInterval = kSbTimeMinute;
+
+struct MemInfo {
+  int64_t total { 0 };
+  int64_t available { 0 };
+};
+
+MemInfo ReadMemInfo() {
+  MemInfo info;
+  info.total = ReadProcValue("/proc/meminfo", "MemTotal");
+  info.available = GetMemAvailable();
+  return info;
+}
+
+
+// Media buffers for the resolution the display can show.
+int64_t GetMediaBudget() {
+  int width = 1920;
+  int height = 1080;
+  if (Application::Get()) {
+    ResolutionInfo resolution = Application::Get()->GetDisplayResolution();
+    width = resolution.Width;
+    height = resolution.Height;
+  }
+  return SbMediaGetMaxBufferCapacity(kSbMediaVideoCodecVp9, width, height, 8);
+}
+
+// MemTotal lacks what the kernel and the video carveouts took, so it is
+// rounded up to the RAM the box was sold with, and the scale is rounded down
+// to a step, so all boxes of one class end up with the same budgets.
+double GetScale(const MemInfo& mem, int64_t media) {
+  if (mem.total <= 0)
+    return 1.0;
+  const int64_t total = (mem.total + kMemoryClassStep - 1) / kMemoryClassStep * kMemoryClassStep;
+  const int64_t reference_media =
+      SbMediaGetMaxBufferCapacity(kSbMediaVideoCodecVp9, 1920, 1080, 8);
+  const double reference_pool =
+      kReferenceTotal - reference_media - kSystemReserve - kOtherReserve;
+  double scale = (total - media - kSystemReserve - kOtherReserve) / reference_pool;
+  if (mem.available > 0) {
+    // Never more than what would fit in what is free right now.
+    const double base = kImageCacheBase + kSkiaCacheBase + kRemoteTypefaceCacheBase +
+                        kMeshCacheBase + kOffscreenTargetCacheBase;
+    scale = std::min(scale, (mem.available - media - kOtherReserve) / base);
+  }
+  scale = static_cast<int64_t>(scale / kScaleStep) * kScaleStep;
+  return std::max(kMinScale, std::min(kMaxScale, scale));
+}
+
+// "16777216", "16384K" or "16M", always decimal.
+bool GetSizeOverride(const char* name, int* out_size) {
+  char value[32];
+  if (!GetDeviceProperty(name, value, sizeof(value)))
+    return false;
+  char* end = nullptr;
+  int64_t size = strtoll(value, &end, 10);
+  if (end == value || size < 0)
+    return false;
+  if (*end == 'K' || *end == 'k')
+    size *= 1024;
+  else if (*end == 'M' || *end == 'm')
+    size *= kMegabyte;
+  *out_size = static_cast<int>(std::min<int64_t>(size, INT32_MAX));
+  return true;
+}
+
+int Scaled(int64_t base, double scale) {
+  // Whole megabytes for the larger caches, the logs stay readable.
+  int64_t size = static_cast<int64_t>(base * scale);
+  if (size >= 4 * kMegabyte)
+    size = size / kMegabyte * kMegabyte;
+  return static_cast<int>(size);
+}
+
+class CacheBudgetCalculator {
+ public:
+  CacheBudgetCalculator() {
+    const MemInfo mem = ReadMemInfo();
+    const int64_t media = GetMediaBudget();
+    const bool low_mem = GetTunable(Tunable::kSupportLowMem) != 0;
+
+    double scale = GetScale(mem, media);
+    if (low_mem)
+      scale = std::min(scale, kLowMemScale);
+
+    const bool reference = scale == 1.0;
+    budget_.image_cache = reference ? kAutoSize : Scaled(kImageCacheBase, scale);
+    budget_.skia_cache = Scaled(kSkiaCacheBase, scale);
+    budget_.remote_typeface_cache = Scaled(kRemoteTypefaceCacheBase, scale);
+    budget_.mesh_cache = Scaled(kMeshCacheBase, scale);
+    budget_.offscreen_target_cache =
+        reference ? kAutoSize : Scaled(kOffscreenTargetCacheBase, scale);
+
+    int overrides = 0;
+    overrides += GetSizeOverride("COBALT_IMAGE_CACHE_SIZE_IN_BYTES", &budget_.image_cache);
+    overrides += GetSizeOverride("COBALT_SKIA_CACHE_SIZE_IN_BYTES", &budget_.skia_cache);
+    overrides += GetSizeOverride("COBALT_REMOTE_TYPEFACE_CACHE_SIZE_IN_BYTES",
+                                 &budget_.remote_typeface_cache);
+    overrides += GetSizeOverride("COBALT_MESH_CACHE_SIZE_IN_BYTES", &budget_.mesh_cache);
+    overrides += GetSizeOverride("COBALT_OFFSCREEN_TARGET_CACHE_SIZE_IN_BYTES",
+                                 &budget_.offscreen_target_cache);
+
+    SB_LOG(INFO) << "Cache budgets, total " << mem.total / kMegabyte << " MB, available "
+                 << mem.available / kMegabyte << " MB, media " << media / kMegabyte
+                 << " MB" << (low_mem ? ", lowmem" : "") << ", scale " << scale
+                 << ", " << overrides << " overridden: " << Describe();
+
+    const char* measure = getenv("COBALT_CACHE_BUDGET_MEASURE");
+    if (measure && strcmp(measure, "1") == 0) {
+      min_available_ = mem.available;
+      SbThread thread = SbThreadCreate(0, kSbThreadPriorityLow, kSbThreadNoAffinity, false,
+                                       "cache_measure", &CacheBudgetCalculator::MeasureEntryPoint,
+                                       this);
+      if (!SbThreadIsValid(thread))
+        SB_LOG(ERROR) << "Failed to start cache budget measurement";
+    }
+  }
+
+  const CacheBudget& budget() const { return budget_; }
+
+ private:
+  static void* MeasureEntryPoint(void* context) {
+    static_cast<CacheBudgetCalculator*>(context)->Measure();
+    return nullptr;
+  }
+
+  // Lives as long as the process, like the calculator.
+  void Measure() {
+    SbTimeMonotonic next_report = SbTimeGetMonotonicNow() + kMeasureReportInterval;
+    for (;;) {
+      SbThreadSleep(kMeasureInterval);
+      int64_t available = ReadMemInfo().available;
+      if (available > 0)
+        min_available_ = std::min(min_available_, available);
+      if (SbTimeGetMonotonicNow() < next_report)
+        continue;
+      next_report += kMeasureReportInterval;
+      SB_LOG(INFO) << "Cache budget measurement: rss "
+                   << ReadProcValue("/proc/self/status", "VmRSS") / kMegabyte << " MB, peak "
+                   << ReadProcValue("/proc/self/status", "VmHWM") / kMegabyte
+                   << " MB; available " << available / kMegabyte << " MB, lowest "
+                   << min_available_ / kMegabyte << " MB; " << Describe();
+    }
+  }
+
+  static std::string DescribeSize(const char* name, int size) {
+    char text[48];
+    if (size == kAutoSize)
+      snprintf(text, sizeof(text), "%s auto", name);
+    else
+      snprintf(text, sizeof(text), "%s %d KB", name, size / 1024);
+    return text;
+  }
+
+  std::string Describe() const {
+    return DescribeSize("image", budget_.image_cache) + ", " +
+           DescribeSize("skia", budget_.skia_cache) + ", " +
+           DescribeSize("remote typeface", budget_.remote_typeface_cache) + ", " +
+           DescribeSize("mesh", budget_.mesh_cache) + ", " +
+           DescribeSize("offscreen", budget_.offscreen_target_cache);
+  }
+
+  CacheBudget budget_;
+  int64_t min_available_ { 0 };
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(CacheBudgetCalculator, GetCalculator);
+
+}  // namespace
+
+const CacheBudget& GetCacheBudget() {
+  return GetCalculator()->budget();
+}
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
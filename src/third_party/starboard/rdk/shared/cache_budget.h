@@ -0,0 +1,53 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_CACHE_BUDGET_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_CACHE_BUDGET_H_
+
+#include <stdint.h>
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+
+// Renderer cache sizes for the Configuration extension, in bytes. They are
+// worked out once from MemTotal, less the media buffers the box may need, so
+// a 2 GB box gets larger caches than a 1 GB one; a low MemAvailable at
+// startup and the support_lowmem tunable only make them smaller. On the 1 GB
+// reference class the image and offscreen target caches stay at -1 and
+// Cobalt sizes them itself. Each can be pinned in the device properties
+// file, e.g. COBALT_IMAGE_CACHE_SIZE_IN_BYTES=16M.
+//
+// With COBALT_CACHE_BUDGET_MEASURE=1 the process' peak resident size and
+// the lowest MemAvailable seen are logged every minute next to the chosen
+// budgets, which is what tuning a device class needs.
+struct CacheBudget {
+  int image_cache;
+  int skia_cache;
+  int remote_typeface_cache;
+  int mesh_cache;
+  int offscreen_target_cache;
+};
+
+const CacheBudget& GetCacheBudget();
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_CACHE_BUDGET_H_
@@ -32,6 +32,7 @@
 
 #include "cobalt/extension/configuration.h"
 #include "starboard/common/configuration_defaults.h"
+#include "third_party/starboard/rdk/shared/cache_budget.h"
 
 namespace third_party {
 namespace starboard {
@@ -44,6 +45,26 @@ bool CobaltEnableQuic() {
   return false;
 }
 
+int CobaltSkiaCacheSizeInBytes() {
+  return GetCacheBudget().skia_cache;
+}
+
+int CobaltOffscreenTargetCacheSizeInBytes() {
+  return GetCacheBudget().offscreen_target_cache;
+}
+
+int CobaltImageCacheSizeInBytes() {
+  return GetCacheBudget().image_cache;
+}
+
+int CobaltRemoteTypefaceCacheSizeInBytes() {
+  return GetCacheBudget().remote_typeface_cache;
+}
+
+int CobaltMeshCacheSizeInBytes() {
+  return GetCacheBudget().mesh_cache;
+}
+
 const CobaltExtensionConfigurationApi kConfigurationApi = {
     kCobaltExtensionConfigurationName,
     2,
@@ -52,13 +73,13 @@ const CobaltExtensionConfigurationApi kConfigurationApi = {
     &::starboard::common::CobaltEglSwapIntervalDefault,
     &::starboard::common::CobaltFallbackSplashScreenUrlDefault,
     &CobaltEnableQuic,
-    &::starboard::common::CobaltSkiaCacheSizeInBytesDefault,
-    &::starboard::common::CobaltOffscreenTargetCacheSizeInBytesDefault,
+    &CobaltSkiaCacheSizeInBytes,
+    &CobaltOffscreenTargetCacheSizeInBytes,
     &::starboard::common::CobaltEncodedImageCacheSizeInBytesDefault,
-    &::starboard::common::CobaltImageCacheSizeInBytesDefault,
+    &CobaltImageCacheSizeInBytes,
     &::starboard::common::CobaltLocalTypefaceCacheSizeInBytesDefault,
-    &::starboard::common::CobaltRemoteTypefaceCacheSizeInBytesDefault,
-    &::starboard::common::CobaltMeshCacheSizeInBytesDefault,
+    &CobaltRemoteTypefaceCacheSizeInBytes,
+    &CobaltMeshCacheSizeInBytes,
     &::starboard::common::CobaltSoftwareSurfaceCacheSizeInBytesDefault,
     &::starboard::common::CobaltImageCacheCapacityMultiplierWhenPlayingVideoDefault,
     &::starboard::common::CobaltSkiaGlyphAtlasWidthDefault,
@@ -0,0 +1,250 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/device_properties.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "starboard/common/log.h"
+#include "starboard/common/mutex.h"
+#include "starboard/once.h"
+#include "starboard/thread.h"
+#include "starboard/time.h"
+
+#include "third_party/starboard/rdk/shared/log_override.h"
+
+#include "aml_device_property.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace {
+
+// The file libamldeviceproperty parses, COBALT_DEVICE_PROPERTIES_FILE
+// overrides it for images that keep it elsewhere.
+const char kDefaultStorePath[] = "/etc/device.properties";
+const size_t kMaxValueLength = 1024;
+// Without inotify the store is stat()ed on lookups, at most this often.
+const SbTime kStatInterval = kSbTimeSecond;
+
+class DevicePropertyCache {
+ public:
+  DevicePropertyCache() {
+    const char* path = getenv("COBALT_DEVICE_PROPERTIES_FILE");
+    store_path_ = path && *path ? path : kDefaultStorePath;
+    size_t slash = store_path_.rfind('/');
+    store_dir_ = slash == std::string::npos ? "." : store_path_.substr(0, slash);
+    if (store_dir_.empty())
+      store_dir_ = "/";
+    store_name_ = store_path_.substr(slash == std::string::npos ? 0 : slash + 1);
+    StartWatch();
+    if (!watching_)
+      GetStoreStamp(&store_stamp_);
+  }
+
+  bool Get(const char* name, char* out_value, int value_length) {
+    ::starboard::ScopedLock lock(mutex_);
+    ++stats_.lookups;
+    if (!watching_)
+      CheckStoreLocked();
+
+    auto it = entries_.find(name);
+    if (it == entries_.end()) {
+      // Held across the read so an invalidation can't slip in between.
+      char value[kMaxValueLength] = {0};
+      Entry entry;
+      entry.found = AmlDeviceGetProperty(name, value, sizeof(value)) ==
+                    AMLDEVICE_SUCCESS;
+      if (entry.found)
+        entry.value.assign(value, strnlen(value, sizeof(value)));
+      ++stats_.store_reads;
+      SB_LOG(INFO) << "Read device property " << name << " from the store ("
+                   << stats_.store_reads << " reads, " << stats_.lookups
+                   << " lookups)";
+      it = entries_.emplace(name, std::move(entry)).first;
+    }
+
+    const Entry& entry = it->second;
+    if (!entry.found || !out_value || value_length <= 0)
+      return false;
+    // Cut to fit, as AmlDeviceGetProperty() does for short buffers.
+    size_t length =
+        std::min(entry.value.size(), static_cast<size_t>(value_length) - 1);
+    memcpy(out_value, entry.value.data(), length);
+    out_value[length] = '\0';
+    return true;
+  }
+
+  DevicePropertyStats GetStats() {
+    ::starboard::ScopedLock lock(mutex_);
+    return stats_;
+  }
+
+ private:
+  struct Entry {
+    bool found{false};
+    std::string value;
+  };
+
+  struct StoreStamp {
+    bool exists{false};
+    off_t size{0};
+    time_t mtime{0};
+  };
+
+  static void* WatchThreadEntryPoint(void* context) {
+    static_cast<DevicePropertyCache*>(context)->RunWatch();
+    return nullptr;
+  }
+
+  void StartWatch() {
+    inotify_fd_ = inotify_init1(IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+      SB_LOG(WARNING) << "inotify unavailable (" << strerror(errno)
+                      << "), polling " << store_path_;
+      return;
+    }
+    // The directory, not the file, so replacing the file by a rename is
+    // seen and the watch survives it.
+    if (inotify_add_watch(inotify_fd_, store_dir_.c_str(),
+                          IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                              IN_CREATE | IN_DELETE) < 0) {
+      SB_LOG(WARNING) << "Can't watch " << store_dir_ << " ("
+                      << strerror(errno) << "), polling " << store_path_;
+      close(inotify_fd_);
+      inotify_fd_ = -1;
+      return;
+    }
+    // Lives as long as the process, like the cache. Set before the thread
+    // starts, which clears it if the watch breaks.
+    watching_ = true;
+    SbThread thread =
+        SbThreadCreate(0, kSbThreadPriorityLow, kSbThreadNoAffinity, false,
+                       "prop_watch", &WatchThreadEntryPoint, this);
+    if (!SbThreadIsValid(thread)) {
+      SB_LOG(WARNING) << "Failed to start the device property watch";
+      close(inotify_fd_);
+      inotify_fd_ = -1;
+      watching_ = false;
+    }
+  }
+
+  void RunWatch() {
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;) {
+      ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+      if (length < 0 && errno == EINTR)
+        continue;
+      if (length <= 0) {
+        SB_LOG(ERROR) << "Device property watch failed (" << strerror(errno)
+                      << "), polling " << store_path_;
+        ::starboard::ScopedLock lock(mutex_);
+        watching_ = false;
+        InvalidateLocked("watch lost");
+        GetStoreStamp(&store_stamp_);
+        return;
+      }
+      bool changed = false;
+      for (char* p = buffer; p < buffer + length;) {
+        const struct inotify_event* event =
+            reinterpret_cast<const struct inotify_event*>(p);
+        if ((event->mask & IN_Q_OVERFLOW) ||
+            (event->len && store_name_ == event->name)) {
+          changed = true;
+        }
+        p += sizeof(struct inotify_event) + event->len;
+      }
+      if (changed) {
+        ::starboard::ScopedLock lock(mutex_);
+        InvalidateLocked("store changed");
+      }
+    }
+  }
+
+  bool GetStoreStamp(StoreStamp* stamp) {
+    struct stat info;
+    StoreStamp current;
+    if (stat(store_path_.c_str(), &info) == 0) {
+      current.exists = true;
+      current.size = info.st_size;
+      current.mtime = info.st_mtime;
+    }
+    bool changed = current.exists != stamp->exists ||
+                   current.size != stamp->size || current.mtime != stamp->mtime;
+    *stamp = current;
+    return changed;
+  }
+
+  void CheckStoreLocked() {
+    SbTimeMonotonic now = SbTimeGetMonotonicNow();
+    if (now - last_stat_ < kStatInterval)
+      return;
+    last_stat_ = now;
+    if (GetStoreStamp(&store_stamp_))
+      InvalidateLocked("store changed");
+  }
+
+  void InvalidateLocked(const char* reason) {
+    if (entries_.empty())
+      return;
+    ++stats_.invalidations;
+    SB_LOG(INFO) << "Dropping " << entries_.size() << " device properties, "
+                 << reason << " (" << stats_.store_reads << " reads, "
+                 << stats_.lookups << " lookups)";
+    entries_.clear();
+  }
+
+  ::starboard::Mutex mutex_;
+  std::map<std::string, Entry> entries_;
+  DevicePropertyStats stats_{};
+  std::string store_path_;
+  std::string store_dir_;
+  std::string store_name_;
+  int inotify_fd_{-1};
+  bool watching_{false};
+  StoreStamp store_stamp_;
+  SbTimeMonotonic last_stat_{0};
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(DevicePropertyCache, GetDevicePropertyCache);
+
+}  // namespace
+
+bool GetDeviceProperty(const char* name, char* out_value, int value_length) {
+  if (!name)
+    return false;
+  return GetDevicePropertyCache()->Get(name, out_value, value_length);
+}
+
+DevicePropertyStats GetDevicePropertyStats() {
+  return GetDevicePropertyCache()->GetStats();
+}
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,51 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_DEVICE_PROPERTIES_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_DEVICE_PROPERTIES_H_
+
+#include <stdint.h>
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+
+// Cached AmlDeviceGetProperty(). Every property, present or not, is read
+// from the store once and served from memory until the store file changes,
+// which an inotify watch on its directory reports. Use this instead of
+// calling AmlDeviceGetProperty() directly, so the store is not parsed again
+// on every query.
+//
+// Returns false when the property is not set. A value longer than
+// |value_length| allows is truncated, and always NUL terminated.
+bool GetDeviceProperty(const char* name, char* out_value, int value_length);
+
+struct DevicePropertyStats {
+  uint64_t lookups;
+  // Lookups that went to the store, once per property and invalidation.
+  uint64_t store_reads;
+  uint64_t invalidations;
+};
+
+DevicePropertyStats GetDevicePropertyStats();
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_DEVICE_PROPERTIES_H_
@@ -26,6 +26,7 @@
 
 #include "opencdm/open_cdm.h"
 #include "opencdm/open_cdm_adapter.h"
+#include "third_party/starboard/rdk/shared/media/media_support_cache.h"
 
 #include "third_party/starboard/rdk/shared/log_override.h"
 
@@ -419,6 +420,7 @@ void Session::OnError(struct OpenCDMSession* /*ocdm_session*/,
 }  // namespace session
 
 using session::Session;
+using third_party::starboard::rdk::shared::media::GetKeySystemSupportCache;
 
 DrmSystemOcdm::DrmSystemOcdm(
     const char* key_system,
@@ -437,6 +439,10 @@ DrmSystemOcdm::DrmSystemOcdm(
       session_closed_callback_(session_closed_callback) {
   SB_LOG(INFO) << "Create DRM system ";
   ocdm_system_ = opencdm_create_system(key_system_.c_str());
+  // Creating a system is the only sign we get of the OCDM service coming up
+  // or going away, either way earlier answers may be stale.
+  GetKeySystemSupportCache()->Invalidate(
+      ocdm_system_ ? "DRM system created" : "DRM system creation failed");
 
   static std::once_flag flag;
   /*
@@ -502,7 +508,19 @@ SbDrmKeyStatus DrmSystemOcdm::GetKeyStatus(const uint8_t * key, uint32_t key_siz
 // static
 bool DrmSystemOcdm::IsKeySystemSupported(const char* key_system,
                                          const char* mime_type) {
-  return opencdm_is_type_supported(key_system, mime_type) == ERROR_NONE;
+  if (!key_system || !mime_type)
+    return opencdm_is_type_supported(key_system, mime_type) == ERROR_NONE;
+
+  // Every query is an IPC to the OCDM service, and Cobalt repeats the same
+  // few many times.
+  std::string key = std::string(key_system) + '|' + mime_type;
+  bool supported = false;
+  uint32_t generation = 0;
+  if (GetKeySystemSupportCache()->Lookup(key, &supported, &generation))
+    return supported;
+  supported = opencdm_is_type_supported(key_system, mime_type) == ERROR_NONE;
+  GetKeySystemSupportCache()->Store(key, supported, generation);
+  return supported;
 }
 
 void DrmSystemOcdm::GenerateSessionUpdateRequest(
@@ -0,0 +1,837 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// In-process stand-in for the OpenCDM client library. It implements the
+// subset of the OpenCDM API used by DrmSystemOcdm with ClearKey semantics
+// so the encrypted playback path can be exercised and measured without the
+// OCDM daemon, a license server or secure video hardware.
+//
+// Build with 'use_mock_ocdm=1'. Runtime knobs:
+//   COBALT_MOCK_OCDM_LATENCY_MS          delay of every daemon round trip
+//                                        (challenge and license processing)
+//   COBALT_MOCK_OCDM_KEY_DELAY_MS        extra delay before keys become usable
+//   COBALT_MOCK_OCDM_DECRYPT_LATENCY_US  extra per-sample decrypt latency
+//   COBALT_MOCK_OCDM_KEYS                "kid:key,kid:key" in hex, keys made
+//                                        available by any license update
+//   COBALT_MOCK_OCDM_KEY_SYSTEMS         comma separated list of supported key
+//                                        systems, all are accepted when unset
+//
+// License updates in ClearKey JSON format ({"keys":[{"kid":..,"k":..}]}) are
+// honoured as well. Samples are decrypted in place: AES-CTR ('cenc') and
+// AES-CBC with an optional pattern ('cbcs').
+//
+// The build also defines DRM_PATH_STATS, which makes every player log its
+// decrypt, key to first push and pending sample drain timings on teardown.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gst/base/gstbytereader.h>
+#include <gst/gst.h>
+#include <openssl/aes.h>
+
+#include "opencdm/open_cdm.h"
+#include "opencdm/open_cdm_adapter.h"
+
+struct OpenCDMSystem {
+  std::string key_system;
+};
+
+struct OpenCDMSession {
+  OpenCDMSystem* system{nullptr};
+  std::string id;
+  OpenCDMSessionCallbacks callbacks;
+  void* user_data{nullptr};
+  int refs{1};
+  int callbacks_in_flight{0};
+  bool closed{false};
+  std::vector<std::string> requested_kids;
+  std::map<std::string, std::string> keys;
+  uint32_t frame_width{0};
+  uint32_t frame_height{0};
+};
+
+namespace {
+
+const size_t kAesBlockSize = 16;
+const uint32_t kSchemeAesCtr = 0;
+
+using Clock = std::chrono::steady_clock;
+
+int EnvInt(const char* name, int fallback) {
+  const char* env = getenv(name);
+  return env ? atoi(env) : fallback;
+}
+
+bool HexToBytes(const std::string& hex, std::string* out) {
+  if (hex.size() % 2)
+    return false;
+  out->clear();
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    char byte[3] = {hex[i], hex[i + 1], 0};
+    char* end = nullptr;
+    long value = strtol(byte, &end, 16);
+    if (end != byte + 2)
+      return false;
+    out->push_back(static_cast<char>(value));
+  }
+  return true;
+}
+
+bool Base64UrlDecode(const std::string& in, std::string* out) {
+  out->clear();
+  uint32_t acc = 0;
+  int bits = 0;
+  for (char c : in) {
+    int v;
+    if (c >= 'A' && c <= 'Z') v = c - 'A';
+    else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+    else if (c >= '0' && c <= '9') v = c - '0' + 52;
+    else if (c == '-' || c == '+') v = 62;
+    else if (c == '_' || c == '/') v = 63;
+    else if (c == '=') break;
+    else return false;
+    acc = (acc << 6) | v;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out->push_back(static_cast<char>((acc >> bits) & 0xff));
+    }
+  }
+  return true;
+}
+
+std::string Base64UrlEncode(const std::string& in) {
+  static const char kTable[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+  std::string out;
+  uint32_t acc = 0;
+  int bits = 0;
+  for (unsigned char c : in) {
+    acc = (acc << 8) | c;
+    bits += 8;
+    while (bits >= 6) {
+      bits -= 6;
+      out.push_back(kTable[(acc >> bits) & 0x3f]);
+    }
+  }
+  if (bits > 0)
+    out.push_back(kTable[(acc << (6 - bits)) & 0x3f]);
+  return out;
+}
+
+// Returns the string value of "name" inside |object|, no nesting support.
+bool FindJsonString(const std::string& object,
+                    const char* name,
+                    std::string* value) {
+  std::string quoted = std::string("\"") + name + "\"";
+  size_t pos = object.find(quoted);
+  while (pos != std::string::npos) {
+    size_t colon = object.find_first_not_of(" \t\r\n", pos + quoted.size());
+    if (colon != std::string::npos && object[colon] == ':') {
+      size_t open = object.find('"', colon);
+      size_t close =
+          open == std::string::npos ? open : object.find('"', open + 1);
+      if (close == std::string::npos)
+        return false;
+      *value = object.substr(open + 1, close - open - 1);
+      return true;
+    }
+    pos = object.find(quoted, pos + 1);
+  }
+  return false;
+}
+
+// ClearKey JSON license: {"keys":[{"kty":"oct","kid":"..","k":".."}]}
+void ParseClearKeyLicense(const std::string& license,
+                          std::map<std::string, std::string>* keys) {
+  size_t pos = license.find("\"keys\"");
+  while (pos != std::string::npos) {
+    size_t open = license.find('{', pos);
+    size_t close =
+        open == std::string::npos ? open : license.find('}', open);
+    if (close == std::string::npos)
+      break;
+    std::string object = license.substr(open, close - open + 1);
+    std::string kid, k, kid_raw, k_raw;
+    if (FindJsonString(object, "kid", &kid) &&
+        FindJsonString(object, "k", &k) && Base64UrlDecode(kid, &kid_raw) &&
+        Base64UrlDecode(k, &k_raw) && k_raw.size() == kAesBlockSize) {
+      (*keys)[kid_raw] = k_raw;
+    }
+    pos = close;
+  }
+}
+
+// Key ids from 'cenc' (PSSH v1), 'keyids' (ClearKey JSON) or 'webm' data.
+std::vector<std::string> ParseInitData(const std::string& type,
+                                       const uint8_t* data,
+                                       uint16_t size) {
+  std::vector<std::string> kids;
+  std::string init(reinterpret_cast<const char*>(data), size);
+  if (type == "webm") {
+    kids.push_back(init);
+  } else if (type == "keyids") {
+    size_t open = init.find('[');
+    size_t close = init.find(']', open);
+    size_t pos = open;
+    while (pos != std::string::npos && pos < close) {
+      size_t begin = init.find('"', pos + 1);
+      size_t end = begin == std::string::npos ? begin
+                                              : init.find('"', begin + 1);
+      if (end == std::string::npos || end > close)
+        break;
+      std::string kid;
+      if (Base64UrlDecode(init.substr(begin + 1, end - begin - 1), &kid))
+        kids.push_back(kid);
+      pos = end;
+    }
+  } else {
+    GstByteReader reader;
+    gst_byte_reader_init(&reader, data, size);
+    while (gst_byte_reader_get_remaining(&reader) >= 8) {
+      guint pos = gst_byte_reader_get_pos(&reader);
+      guint32 box_size = 0, box_type = 0;
+      gst_byte_reader_get_uint32_be(&reader, &box_size);
+      gst_byte_reader_get_uint32_le(&reader, &box_type);
+      if (box_size < 8 || box_size > size - pos)
+        break;
+      guint8 version = 0;
+      guint32 kid_count = 0;
+      if (box_type == GST_MAKE_FOURCC('p', 's', 's', 'h') &&
+          gst_byte_reader_get_uint8(&reader, &version) && version > 0 &&
+          gst_byte_reader_skip(&reader, 3 + 16) &&
+          gst_byte_reader_get_uint32_be(&reader, &kid_count)) {
+        const guint8* kid = nullptr;
+        for (guint32 i = 0; i < kid_count &&
+             gst_byte_reader_get_data(&reader, 16, &kid); ++i) {
+          kids.emplace_back(reinterpret_cast<const char*>(kid), 16);
+        }
+      }
+      gst_byte_reader_set_pos(&reader, pos + box_size);
+    }
+  }
+  return kids;
+}
+
+void CtrIncrement(uint8_t counter[kAesBlockSize]) {
+  // CENC increments the low 64 bits only.
+  for (int i = kAesBlockSize - 1; i >= 8; --i) {
+    if (++counter[i] != 0)
+      break;
+  }
+}
+
+class CtrDecryptor {
+ public:
+  CtrDecryptor(const std::string& key, const uint8_t iv[kAesBlockSize]) {
+    AES_set_encrypt_key(reinterpret_cast<const uint8_t*>(key.data()), 128,
+                        &key_);
+    memcpy(counter_, iv, kAesBlockSize);
+  }
+
+  void Decrypt(uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      if (offset_ == 0)
+        AES_encrypt(counter_, keystream_, &key_);
+      data[i] ^= keystream_[offset_];
+      if (++offset_ == kAesBlockSize) {
+        offset_ = 0;
+        CtrIncrement(counter_);
+      }
+    }
+  }
+
+ private:
+  AES_KEY key_;
+  uint8_t counter_[kAesBlockSize];
+  uint8_t keystream_[kAesBlockSize];
+  size_t offset_{0};
+};
+
+void CbcsDecrypt(const AES_KEY& key,
+                 const uint8_t iv[kAesBlockSize],
+                 uint32_t crypt_blocks,
+                 uint32_t skip_blocks,
+                 uint8_t* data,
+                 size_t size) {
+  uint8_t chain[kAesBlockSize];
+  memcpy(chain, iv, kAesBlockSize);
+  if (crypt_blocks == 0 && skip_blocks == 0)
+    crypt_blocks = 1;
+
+  size_t pos = 0;
+  while (pos + kAesBlockSize <= size) {
+    for (uint32_t i = 0; i < crypt_blocks && pos + kAesBlockSize <= size;
+         ++i, pos += kAesBlockSize) {
+      uint8_t cipher[kAesBlockSize];
+      memcpy(cipher, data + pos, kAesBlockSize);
+      AES_decrypt(cipher, data + pos, &key);
+      for (size_t j = 0; j < kAesBlockSize; ++j)
+        data[pos + j] ^= chain[j];
+      memcpy(chain, cipher, kAesBlockSize);
+    }
+    pos += static_cast<size_t>(skip_blocks) * kAesBlockSize;
+  }
+}
+
+struct Stats {
+  uint64_t sessions{0};
+  uint64_t decrypted_samples{0};
+  uint64_t decrypted_bytes{0};
+  uint64_t decrypt_time_us{0};
+  uint64_t decrypt_failures{0};
+  uint64_t licenses{0};
+};
+
+class MockOcdm {
+ public:
+  static MockOcdm& Get() {
+    // Intentionally leaked, callbacks may still run during process exit.
+    static MockOcdm* instance = new MockOcdm();
+    return *instance;
+  }
+
+  bool IsKeySystemSupported(const char* key_system) const {
+    if (supported_systems_.empty())
+      return true;
+    std::string name = key_system ? key_system : "";
+    return std::find(supported_systems_.begin(), supported_systems_.end(),
+                     name) != supported_systems_.end();
+  }
+
+  std::mutex& Lock() { return mutex_; }
+  std::condition_variable& Condition() { return condition_; }
+  Stats& GetStats() { return stats_; }
+  std::vector<OpenCDMSession*>& Sessions() { return sessions_; }
+  const std::map<std::string, std::string>& PresetKeys() const {
+    return preset_keys_;
+  }
+  int KeyDelayMs() const { return key_delay_ms_; }
+  int DecryptLatencyUs() const { return decrypt_latency_us_; }
+
+  std::string NextSessionId() {
+    return "mock-ocdm-" + std::to_string(++session_counter_);
+  }
+
+  // Runs |task| on the callback thread after the daemon round trip plus
+  // |extra_delay_ms|.
+  void Post(std::function<void()> task, int extra_delay_ms = 0) {
+    auto deadline = Clock::now() +
+                    std::chrono::milliseconds(latency_ms_ + extra_delay_ms);
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.emplace(deadline, std::move(task));
+    condition_.notify_all();
+  }
+
+  // Invokes |fn| unless the session was closed meanwhile. close() waits for
+  // callbacks in flight, mirroring the real client unregistering the
+  // session synchronously.
+  void RunSessionCallback(OpenCDMSession* session,
+                          const std::function<void(OpenCDMSession*)>& fn) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (session->closed)
+        return;
+      ++session->callbacks_in_flight;
+    }
+    fn(session);
+    std::lock_guard<std::mutex> lock(mutex_);
+    --session->callbacks_in_flight;
+    condition_.notify_all();
+  }
+
+  // Must be called with Lock() held.
+  bool OnCallbackThread() const {
+    return std::this_thread::get_id() == callback_thread_id_;
+  }
+
+  void Release(OpenCDMSession* session) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (--session->refs > 0)
+      return;
+    sessions_.erase(std::remove(sessions_.begin(), sessions_.end(), session),
+                    sessions_.end());
+    lock.unlock();
+    delete session;
+  }
+
+ private:
+  MockOcdm()
+      : latency_ms_(EnvInt("COBALT_MOCK_OCDM_LATENCY_MS", 0)),
+        key_delay_ms_(EnvInt("COBALT_MOCK_OCDM_KEY_DELAY_MS", 0)),
+        decrypt_latency_us_(EnvInt("COBALT_MOCK_OCDM_DECRYPT_LATENCY_US", 0)) {
+    if (const char* env = getenv("COBALT_MOCK_OCDM_KEYS")) {
+      std::string list = env;
+      size_t pos = 0;
+      while (pos < list.size()) {
+        size_t comma = list.find(',', pos);
+        std::string entry = list.substr(pos, comma - pos);
+        size_t colon = entry.find(':');
+        std::string kid, key;
+        if (colon != std::string::npos &&
+            HexToBytes(entry.substr(0, colon), &kid) &&
+            HexToBytes(entry.substr(colon + 1), &key) &&
+            key.size() == kAesBlockSize) {
+          preset_keys_[kid] = key;
+        } else {
+          GST_WARNING("mock-ocdm: ignoring malformed key '%s'", entry.c_str());
+        }
+        if (comma == std::string::npos)
+          break;
+        pos = comma + 1;
+      }
+    }
+    if (const char* env = getenv("COBALT_MOCK_OCDM_KEY_SYSTEMS")) {
+      std::string list = env;
+      size_t pos = 0;
+      while (pos <= list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos)
+          comma = list.size();
+        if (comma > pos)
+          supported_systems_.push_back(list.substr(pos, comma - pos));
+        pos = comma + 1;
+      }
+    }
+    std::thread(&MockOcdm::Run, this).detach();
+  }
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    callback_thread_id_ = std::this_thread::get_id();
+    for (;;) {
+      if (tasks_.empty()) {
+        condition_.wait(lock);
+        continue;
+      }
+      auto next = tasks_.begin();
+      if (next->first > Clock::now()) {
+        condition_.wait_until(lock, next->first);
+        continue;
+      }
+      std::function<void()> task = std::move(next->second);
+      tasks_.erase(next);
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+
+  const int latency_ms_;
+  const int key_delay_ms_;
+  const int decrypt_latency_us_;
+  std::map<std::string, std::string> preset_keys_;
+  std::vector<std::string> supported_systems_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::multimap<Clock::time_point, std::function<void()>> tasks_;
+  std::vector<OpenCDMSession*> sessions_;
+  std::atomic<uint32_t> session_counter_{0};
+  Stats stats_;
+  std::thread::id callback_thread_id_;
+};
+
+void DeliverChallenge(OpenCDMSession* session) {
+  std::string request = "{\"kids\":[";
+  for (size_t i = 0; i < session->requested_kids.size(); ++i) {
+    if (i)
+      request += ",";
+    request += "\"" + Base64UrlEncode(session->requested_kids[i]) + "\"";
+  }
+  request += "],\"type\":\"temporary\"}";
+  if (session->callbacks.process_challenge_callback) {
+    session->callbacks.process_challenge_callback(
+        session, session->user_data, "",
+        reinterpret_cast<const uint8_t*>(request.data()), request.size());
+  }
+}
+
+void DeliverKeys(OpenCDMSession* session) {
+  std::vector<std::string> kids;
+  {
+    std::lock_guard<std::mutex> lock(MockOcdm::Get().Lock());
+    for (const auto& entry : session->keys)
+      kids.push_back(entry.first);
+  }
+  for (const auto& kid : kids) {
+    if (session->callbacks.key_update_callback) {
+      session->callbacks.key_update_callback(
+          session, session->user_data,
+          reinterpret_cast<const uint8_t*>(kid.data()), kid.size());
+    }
+  }
+  if (session->callbacks.keys_updated_callback)
+    session->callbacks.keys_updated_callback(session, session->user_data);
+  MockOcdm::Get().Condition().notify_all();
+}
+
+bool FindKey(OpenCDMSession* session, GstBuffer* key_id, std::string* key) {
+  GstMapInfo info;
+  if (!key_id || !gst_buffer_map(key_id, &info, GST_MAP_READ))
+    return false;
+  std::string kid(reinterpret_cast<const char*>(info.data), info.size);
+  gst_buffer_unmap(key_id, &info);
+
+  std::lock_guard<std::mutex> lock(MockOcdm::Get().Lock());
+  auto it = session->keys.find(kid);
+  if (it == session->keys.end())
+    return false;
+  *key = it->second;
+  return true;
+}
+
+OpenCDMError DecryptBuffer(OpenCDMSession* session,
+                           GstBuffer* buffer,
+                           GstBuffer* sub_sample,
+                           uint32_t sub_sample_count,
+                           GstBuffer* iv_buffer,
+                           GstBuffer* key_id,
+                           uint32_t crypt_byte_block,
+                           uint32_t skip_byte_block,
+                           uint32_t encryption_scheme) {
+  MockOcdm& mock = MockOcdm::Get();
+  auto start = Clock::now();
+
+  std::string key;
+  if (!session || !FindKey(session, key_id, &key)) {
+    std::lock_guard<std::mutex> lock(mock.Lock());
+    ++mock.GetStats().decrypt_failures;
+    return ERROR_INVALID_SESSION;
+  }
+
+  uint8_t iv[kAesBlockSize] = {0};
+  GstMapInfo iv_info;
+  if (!iv_buffer || !gst_buffer_map(iv_buffer, &iv_info, GST_MAP_READ))
+    return ERROR_INVALID_DECRYPT_BUFFER;
+  memcpy(iv, iv_info.data, std::min<size_t>(iv_info.size, kAesBlockSize));
+  gst_buffer_unmap(iv_buffer, &iv_info);
+
+  GstMapInfo info;
+  if (!gst_buffer_map(buffer, &info, GST_MAP_READWRITE))
+    return ERROR_INVALID_DECRYPT_BUFFER;
+
+  // (clear, encrypted) byte ranges, a single encrypted range if none given.
+  std::vector<std::pair<size_t, size_t>> ranges;
+  GstMapInfo sub_info;
+  if (sub_sample && sub_sample_count &&
+      gst_buffer_map(sub_sample, &sub_info, GST_MAP_READ)) {
+    GstByteReader reader;
+    gst_byte_reader_init(&reader, sub_info.data, sub_info.size);
+    for (uint32_t i = 0; i < sub_sample_count; ++i) {
+      guint16 clear = 0;
+      guint32 encrypted = 0;
+      if (!gst_byte_reader_get_uint16_be(&reader, &clear) ||
+          !gst_byte_reader_get_uint32_be(&reader, &encrypted))
+        break;
+      ranges.emplace_back(clear, encrypted);
+    }
+    gst_buffer_unmap(sub_sample, &sub_info);
+  } else {
+    ranges.emplace_back(0, info.size);
+  }
+
+  bool ok = true;
+  size_t pos = 0;
+  if (encryption_scheme == kSchemeAesCtr) {
+    CtrDecryptor ctr(key, iv);
+    for (const auto& range : ranges) {
+      pos += range.first;
+      if (pos + range.second > info.size) {
+        ok = false;
+        break;
+      }
+      ctr.Decrypt(info.data + pos, range.second);
+      pos += range.second;
+    }
+  } else {
+    AES_KEY aes;
+    AES_set_decrypt_key(reinterpret_cast<const uint8_t*>(key.data()), 128,
+                        &aes);
+    for (const auto& range : ranges) {
+      pos += range.first;
+      if (pos + range.second > info.size) {
+        ok = false;
+        break;
+      }
+      CbcsDecrypt(aes, iv, crypt_byte_block, skip_byte_block, info.data + pos,
+                  range.second);
+      pos += range.second;
+    }
+  }
+  size_t size = info.size;
+  gst_buffer_unmap(buffer, &info);
+
+  if (mock.DecryptLatencyUs() > 0)
+    usleep(mock.DecryptLatencyUs());
+
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      Clock::now() - start);
+  std::lock_guard<std::mutex> lock(mock.Lock());
+  Stats& stats = mock.GetStats();
+  if (ok) {
+    ++stats.decrypted_samples;
+    stats.decrypted_bytes += size;
+    stats.decrypt_time_us += elapsed.count();
+  } else {
+    ++stats.decrypt_failures;
+  }
+  return ok ? ERROR_NONE : ERROR_INVALID_DECRYPT_BUFFER;
+}
+
+}  // namespace
+
+struct OpenCDMSystem* opencdm_create_system(const char key_system[]) {
+  OpenCDMSystem* system = new OpenCDMSystem;
+  system->key_system = key_system ? key_system : "";
+  return system;
+}
+
+OpenCDMError opencdm_destruct_system(struct OpenCDMSystem* system) {
+  delete system;
+  return ERROR_NONE;
+}
+
+OpenCDMError opencdm_is_type_supported(const char key_system[],
+                                       const char mime_type[]) {
+  return MockOcdm::Get().IsKeySystemSupported(key_system) ? ERROR_NONE
+                                                          : ERROR_KEYSYSTEM_NOT_SUPPORTED;
+}
+
+OpenCDMError opencdm_system_set_server_certificate(
+    struct OpenCDMSystem* system,
+    const uint8_t server_certificate[],
+    const uint16_t server_certificate_length) {
+  return ERROR_NONE;
+}
+
+OpenCDMError opencdm_construct_session(struct OpenCDMSystem* system,
+                                       const LicenseType license_type,
+                                       const char init_data_type[],
+                                       const uint8_t init_data[],
+                                       const uint16_t init_data_length,
+                                       const uint8_t cdm_data[],
+                                       const uint16_t cdm_data_length,
+                                       OpenCDMSessionCallbacks* callbacks,
+                                       void* user_data,
+                                       struct OpenCDMSession** out_session) {
+  if (!system || !out_session)
+    return ERROR_INVALID_ARG;
+
+  MockOcdm& mock = MockOcdm::Get();
+  OpenCDMSession* session = new OpenCDMSession;
+  session->system = system;
+  session->id = mock.NextSessionId();
+  if (callbacks)
+    session->callbacks = *callbacks;
+  else
+    memset(&session->callbacks, 0, sizeof(session->callbacks));
+  session->user_data = user_data;
+  session->requested_kids = ParseInitData(
+      init_data_type ? init_data_type : "", init_data, init_data_length);
+  {
+    std::lock_guard<std::mutex> lock(mock.Lock());
+    mock.Sessions().push_back(session);
+    ++mock.GetStats().sessions;
+    ++session->refs;  // Held by the pending challenge.
+  }
+  *out_session = session;
+
+  mock.Post([session]() {
+    MockOcdm::Get().RunSessionCallback(session, DeliverChallenge);
+    MockOcdm::Get().Release(session);
+  });
+  return ERROR_NONE;
+}
+
+OpenCDMError opencdm_destruct_session(struct OpenCDMSession* session) {
+  if (!session)
+    return ERROR_INVALID_SESSION;
+  MockOcdm::Get().Release(session);
+  return ERROR_NONE;
+}
+
+const char* opencdm_session_id(const struct OpenCDMSession* session) {
+  return session ? session->id.c_str() : nullptr;
+}
+
+KeyStatus opencdm_session_status(const struct OpenCDMSession* session,
+                                 const uint8_t key_id[],
+                                 const uint8_t length) {
+  if (!session)
+    return InternalError;
+  std::string kid(reinterpret_cast<const char*>(key_id), length);
+  std::lock_guard<std::mutex> lock(MockOcdm::Get().Lock());
+  return session->keys.count(kid) ? Usable : StatusPending;
+}
+
+OpenCDMError opencdm_session_update(struct OpenCDMSession* session,
+                                    const uint8_t key_message[],
+                                    const uint16_t key_length) {
+  if (!session)
+    return ERROR_INVALID_SESSION;
+
+  MockOcdm& mock = MockOcdm::Get();
+  std::string license(reinterpret_cast<const char*>(key_message), key_length);
+  std::map<std::string, std::string> keys = mock.PresetKeys();
+  ParseClearKeyLicense(license, &keys);
+  {
+    std::lock_guard<std::mutex> lock(mock.Lock());
+    ++mock.GetStats().licenses;
+    ++session->refs;  // Held by the pending key delivery.
+  }
+
+  mock.Post([session, keys]() {
+    MockOcdm& mock = MockOcdm::Get();
+    {
+      std::lock_guard<std::mutex> lock(mock.Lock());
+      for (const auto& entry : keys)
+        session->keys[entry.first] = entry.second;
+    }
+    mock.RunSessionCallback(session, DeliverKeys);
+    mock.Release(session);
+  }, mock.KeyDelayMs());
+  return ERROR_NONE;
+}
+
+OpenCDMError opencdm_session_close(struct OpenCDMSession* session) {
+  if (!session)
+    return ERROR_INVALID_SESSION;
+  MockOcdm& mock = MockOcdm::Get();
+  std::unique_lock<std::mutex> lock(mock.Lock());
+  session->closed = true;
+  if (!mock.OnCallbackThread()) {
+    mock.Condition().wait(lock, [session]() {
+      return session->callbacks_in_flight == 0;
+    });
+  }
+  return ERROR_NONE;
+}
+
+struct OpenCDMSession* opencdm_get_system_session(struct OpenCDMSystem* system,
+                                                  const uint8_t key_id[],
+                                                  const uint8_t length,
+                                                  const uint32_t wait_time) {
+  MockOcdm& mock = MockOcdm::Get();
+  std::string kid(reinterpret_cast<const char*>(key_id), length);
+  auto find = [&]() -> OpenCDMSession* {
+    for (OpenCDMSession* session : mock.Sessions()) {
+      if (session->system == system && !session->closed &&
+          session->keys.count(kid))
+        return session;
+    }
+    return nullptr;
+  };
+
+  std::unique_lock<std::mutex> lock(mock.Lock());
+  OpenCDMSession* session = find();
+  if (!session && wait_time > 0) {
+    mock.Condition().wait_for(lock, std::chrono::milliseconds(wait_time),
+                              [&]() { return (session = find()) != nullptr; });
+  }
+  if (session)
+    ++session->refs;
+  return session;
+}
+
+OpenCDMError opencdm_session_set_parameter(struct OpenCDMSession* session,
+                                           const std::string& name,
+                                           const std::string& value) {
+  if (!session)
+    return ERROR_INVALID_SESSION;
+  if (name == "RESOLUTION") {
+    unsigned width = 0, height = 0;
+    if (sscanf(value.c_str(), "%u,%u", &width, &height) == 2) {
+      session->frame_width = width;
+      session->frame_height = height;
+    }
+  }
+  return ERROR_NONE;
+}
+
+OpenCDMError opencdm_get_metrics(struct OpenCDMSystem* system,
+                                 std::string& metrics) {
+  MockOcdm& mock = MockOcdm::Get();
+  std::lock_guard<std::mutex> lock(mock.Lock());
+  const Stats& stats = mock.GetStats();
+  metrics = "{\"sessions\":" + std::to_string(stats.sessions) +
+            ",\"licenses\":" + std::to_string(stats.licenses) +
+            ",\"decrypted_samples\":" +
+            std::to_string(stats.decrypted_samples) +
+            ",\"decrypted_bytes\":" + std::to_string(stats.decrypted_bytes) +
+            ",\"decrypt_time_us\":" + std::to_string(stats.decrypt_time_us) +
+            ",\"decrypt_failures\":" +
+            std::to_string(stats.decrypt_failures) + "}";
+  return ERROR_NONE;
+}
+
+OpenCDMError opencdm_gstreamer_session_decrypt(struct OpenCDMSession* session,
+                                               GstBuffer* buffer,
+                                               GstBuffer* sub_sample,
+                                               const uint32_t sub_sample_count,
+                                               GstBuffer* iv,
+                                               GstBuffer* key_id,
+                                               uint32_t init_with_last15) {
+  return DecryptBuffer(session, buffer, sub_sample, sub_sample_count, iv,
+                       key_id, 0, 0, kSchemeAesCtr);
+}
+
+OpenCDMError opencdm_gstreamer_session_decrypt_new(
+    struct OpenCDMSession* session,
+    GstBuffer* buffer,
+    GstBuffer* sub_sample,
+    const uint32_t sub_sample_count,
+    GstBuffer* iv,
+    GstBuffer* key_id,
+    uint32_t init_with_last15,
+    uint32_t crypt_byte_block,
+    uint32_t skip_byte_block,
+    uint32_t encryption_scheme) {
+  return DecryptBuffer(session, buffer, sub_sample, sub_sample_count, iv,
+                       key_id, crypt_byte_block, skip_byte_block,
+                       encryption_scheme);
+}
+
+OpenCDMError opencdm_gstreamer_session_decrypt_ex_new(
+    struct OpenCDMSession* session,
+    GstBuffer* buffer,
+    GstBuffer* sub_sample,
+    const uint32_t sub_sample_count,
+    GstBuffer* iv,
+    GstBuffer* key_id,
+    uint32_t init_with_last15,
+    uint32_t crypt_byte_block,
+    uint32_t skip_byte_block,
+    uint32_t encryption_scheme,
+    GstCaps* caps) {
+  return DecryptBuffer(session, buffer, sub_sample, sub_sample_count, iv,
+                       key_id, crypt_byte_block, skip_byte_block,
+                       encryption_scheme);
+}
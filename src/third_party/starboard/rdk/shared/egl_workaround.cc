@@ -32,11 +32,14 @@
 #include "starboard/common/log.h"
 
 #include "third_party/starboard/rdk/shared/application_rdk.h"
+#include "third_party/starboard/rdk/shared/system/frame_pacer.h"
 
 #include <essos-app.h>
 
 extern "C" EGLDisplay __real_eglGetDisplay(EGLNativeDisplayType native_display);
 extern "C" SB_EXPORT_PLATFORM EGLDisplay __wrap_eglGetDisplay(EGLNativeDisplayType native_display);
+extern "C" EGLBoolean __real_eglSwapBuffers(EGLDisplay display, EGLSurface surface);
+extern "C" SB_EXPORT_PLATFORM EGLBoolean __wrap_eglSwapBuffers(EGLDisplay display, EGLSurface surface);
 
 extern "C" SB_EXPORT_PLATFORM EGLDisplay __wrap_eglGetDisplay(
     EGLNativeDisplayType native_display) {
@@ -46,3 +49,11 @@ extern "C" SB_EXPORT_PLATFORM EGLDisplay __wrap_eglGetDisplay(
     return __real_eglGetDisplay(reinterpret_cast<EGLNativeDisplayType>(display_type));
   return __real_eglGetDisplay(native_display);
 }
+
+// Counts composited UI frames for the frame pacer, which may hold the swap
+// back while a video plays.
+extern "C" SB_EXPORT_PLATFORM EGLBoolean __wrap_eglSwapBuffers(
+    EGLDisplay display, EGLSurface surface) {
+  third_party::starboard::rdk::shared::system::FramePacer::Get()->OnCompositorFrame();
+  return __real_eglSwapBuffers(display, surface);
+}
@@ -17,18 +17,27 @@
 #include "third_party/starboard/rdk/shared/hang_detector.h"
 
 #include <algorithm>
+#include <atomic>
+#include <sstream>
 #include <vector>
 
+#include <errno.h>
+#include <execinfo.h>
+#include <semaphore.h>
+#include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include "starboard/once.h"
 #include "starboard/thread.h"
 #include "starboard/common/condition_variable.h"
 #include "starboard/common/mutex.h"
 
+#include "third_party/starboard/rdk/shared/tunables.h"
 #include "third_party/starboard/rdk/shared/log_override.h"
 
 namespace third_party {
@@ -40,12 +49,270 @@ namespace {
 
 const uint32_t kMaxExpirationCount = 6;
 
+const int kMaxStalls = 16;
+const int kMaxStallFrames = 32;
+// How long the sampled thread gets to run the handler.
+const SbTime kSampleTimeout = 100 * kSbTimeMillisecond;
+
+SbTime get_stall_deadline() {
+  const char* env = std::getenv("COBALT_STALL_PROFILER_DEADLINE_MS");
+  if ( env ) {
+    int64_t t = strtol(env, nullptr, 0);
+    if ( 0 < t )
+      return kSbTimeMillisecond * t;
+  }
+  return 0;
+}
+
+class StallProfiler {
+public:
+  StallProfiler() {
+    if ( deadline_ == 0 )
+      return;
+
+    // The first backtrace() loads the unwinder, which is not safe to do
+    // from a signal handler.
+    void* warmup[2];
+    backtrace(warmup, 2);
+
+    sem_init(&sample_done_, 0, 0);
+    struct sigaction action = {};
+    action.sa_sigaction = &StallProfiler::SignalHandler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if ( sigaction(SIGPROF, &action, nullptr) != 0 ) {
+      SB_LOG(ERROR) << "Stall profiler disabled, sigaction failed: " << errno;
+      return;
+    }
+    instance_ = this;
+
+    thread_ =
+      SbThreadCreate(0, kSbThreadPriorityHigh, kSbThreadNoAffinity, false,
+                     "stall_profiler", &StallProfiler::ThreadEntryPoint, this);
+    if ( !SbThreadIsValid(thread_) ) {
+      SB_LOG(ERROR) << "Stall profiler disabled, no thread";
+      instance_ = nullptr;
+      return;
+    }
+    SB_LOG(INFO) << "Stall profiler armed, deadline " << deadline_ / kSbTimeMillisecond << " ms";
+  }
+
+  // Beats pack the time and an idle bit, so one store publishes both.
+  void Beat(bool idle) {
+    if ( instance_ == nullptr )
+      return;
+    if ( tid_.load(std::memory_order_relaxed) == 0 )
+      tid_.store(syscall(SYS_gettid));
+    beat_.store((SbTimeGetMonotonicNow() << 1) | (idle ? 1 : 0),
+                std::memory_order_relaxed);
+  }
+
+  // Records the stack of the watched thread as it is now, without waiting
+  // for the deadline. Used right before the hang detector kills us.
+  void SampleNow() {
+    if ( instance_ == nullptr )
+      return;
+    ::starboard::ScopedLock lock(mutex_);
+    SbTimeMonotonic now = SbTimeGetMonotonicNow();
+    SbTimeMonotonic start = now;
+    if ( current_ >= 0 ) {
+      // The new sample takes over the stall, the one from the deadline
+      // keeps its frames and the time up to now.
+      Stall& stall = stalls_[current_];
+      start = stall.start;
+      stall.duration = now - stall.start;
+      stall.ongoing = false;
+    }
+    if ( Sample(start) )
+      stalls_[current_].ongoing = true;
+    current_ = -1;
+  }
+
+  std::string ReportsAsJson() {
+    std::ostringstream json;
+    json << '[';
+    ::starboard::ScopedLock lock(mutex_);
+    SbTimeMonotonic now = SbTimeGetMonotonicNow();
+    bool first = true;
+    for (int i = 0; i < kMaxStalls; ++i) {
+      const Stall& stall = stalls_[(next_ + i) % kMaxStalls];
+      if ( stall.start == 0 )
+        continue;
+      json << (first ? "" : ",") << "{\"start_us_ago\":" << now - stall.start
+           << ",\"duration_us\":" << (stall.ongoing ? now - stall.start : stall.duration)
+           << ",\"ongoing\":" << (stall.ongoing ? "true" : "false") << ",\"frames\":[";
+      char** symbols = backtrace_symbols(stall.frames, stall.depth);
+      for (int f = 0; symbols && f < stall.depth; ++f) {
+        json << (f ? "," : "") << '"';
+        for (const char* c = symbols[f]; *c; ++c) {
+          if ( *c == '"' || *c == '\\' )
+            json << '\\';
+          json << *c;
+        }
+        json << '"';
+      }
+      free(symbols);
+      json << "]}";
+      first = false;
+    }
+    json << ']';
+    return json.str();
+  }
+
+  // Runs on the hang detector thread right before the kill, not in a signal
+  // handler. The main thread may be wedged in malloc, so nothing here
+  // allocates: stderr is unbuffered and backtrace_symbols_fd() writes
+  // straight to the fd. |mutex_| is only ever held briefly by the profiler
+  // thread and GetStallReports().
+  void DumpToStderr() {
+    if ( instance_ == nullptr )
+      return;
+    ::starboard::ScopedLock lock(mutex_);
+    SbTimeMonotonic now = SbTimeGetMonotonicNow();
+    for (int i = 0; i < kMaxStalls; ++i) {
+      const Stall& stall = stalls_[(next_ + i) % kMaxStalls];
+      if ( stall.start == 0 )
+        continue;
+      fprintf(stderr, "*** Main thread stall %lld ms ago, %lld ms%s:\n",
+              (long long)((now - stall.start) / kSbTimeMillisecond),
+              (long long)((stall.ongoing ? now - stall.start : stall.duration) / kSbTimeMillisecond),
+              stall.ongoing ? " and counting" : "");
+      backtrace_symbols_fd(stall.frames, stall.depth, STDERR_FILENO);
+    }
+  }
+
+private:
+  struct Stall {
+    SbTimeMonotonic start { 0 };
+    SbTime duration { 0 };
+    bool ongoing { false };
+    int depth { 0 };
+    void* frames[kMaxStallFrames];
+  };
+
+  enum SampleState { kSampleIdle, kSampleRequested, kSampleWriting, kSampleDone };
+
+  static void* ThreadEntryPoint(void* context) {
+    static_cast<StallProfiler*>(context)->DoWork();
+    return nullptr;
+  }
+
+  static void SignalHandler(int, siginfo_t*, void*) {
+    int saved_errno = errno;
+    StallProfiler* self = instance_;
+    int expected = kSampleRequested;
+    if ( self && self->sample_state_.compare_exchange_strong(expected, kSampleWriting) ) {
+      self->sample_depth_ = backtrace(self->sample_frames_, kMaxStallFrames);
+      self->sample_state_.store(kSampleDone);
+      sem_post(&self->sample_done_);
+    }
+    errno = saved_errno;
+  }
+
+  void DoWork() {
+    for (;;) {
+      SbThreadSleep(deadline_ / 2);
+
+      int64_t beat = beat_.load(std::memory_order_relaxed);
+      SbTimeMonotonic beat_time = beat >> 1;
+      bool idle = (beat & 1) != 0;
+      SbTimeMonotonic now = SbTimeGetMonotonicNow();
+
+      ::starboard::ScopedLock lock(mutex_);
+      if ( current_ >= 0 && beat != stall_beat_ ) {
+        Stall& stall = stalls_[current_];
+        stall.duration = beat_time - stall.start;
+        stall.ongoing = false;
+        SB_LOG(WARNING) << "Main thread stalled for " << stall.duration / kSbTimeMillisecond
+                        << " ms, " << stall.depth << " frames recorded";
+        current_ = -1;
+      }
+      if ( current_ < 0 && beat_time != 0 && !idle && now - beat_time > deadline_ ) {
+        if ( Sample(beat_time) ) {
+          stalls_[current_].ongoing = true;
+          stall_beat_ = beat;
+        }
+      }
+    }
+  }
+
+  // Takes the next slot of the ring and signals the watched thread to fill
+  // it. Leaves the slot in |current_|.
+  bool Sample(SbTimeMonotonic start) {
+    pid_t tid = tid_.load();
+    if ( tid == 0 )
+      return false;
+
+    // A handler that finished after the last wait timed out has posted
+    // already; that post must not complete this sample.
+    while ( sem_trywait(&sample_done_) == 0 ) {
+    }
+
+    sample_state_.store(kSampleRequested);
+    if ( syscall(SYS_tgkill, getpid(), tid, SIGPROF) != 0 ) {
+      sample_state_.store(kSampleIdle);
+      return false;
+    }
+
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += kSampleTimeout * kSbTimeNanosecondsPerMicrosecond;
+    until.tv_sec += until.tv_nsec / 1000000000;
+    until.tv_nsec %= 1000000000;
+    while ( sem_timedwait(&sample_done_, &until) != 0 && errno == EINTR ) {
+    }
+
+    int expected = kSampleRequested;
+    if ( sample_state_.compare_exchange_strong(expected, kSampleIdle) )
+      return false;  // the handler never ran
+    while ( sample_state_.load() != kSampleDone ) {
+      SbThreadYield();
+    }
+
+    current_ = next_;
+    next_ = (next_ + 1) % kMaxStalls;
+    Stall& stall = stalls_[current_];
+    stall.start = start;
+    stall.duration = 0;
+    stall.ongoing = false;
+    stall.depth = sample_depth_;
+    memcpy(stall.frames, sample_frames_, sizeof(void*) * sample_depth_);
+    sample_state_.store(kSampleIdle);
+    return true;
+  }
+
+  static StallProfiler* instance_;
+
+  const SbTime deadline_ { get_stall_deadline() };
+  SbThread thread_ { kSbThreadInvalid };
+  std::atomic<pid_t> tid_ { 0 };
+  std::atomic<int64_t> beat_ { 0 };
+
+  // Written by the signal handler while |sample_state_| is kSampleWriting.
+  std::atomic<int> sample_state_ { kSampleIdle };
+  sem_t sample_done_;
+  void* sample_frames_[kMaxStallFrames];
+  int sample_depth_ { 0 };
+
+  ::starboard::Mutex mutex_;
+  Stall stalls_[kMaxStalls];
+  int next_ { 0 };
+  int current_ { -1 };
+  int64_t stall_beat_ { 0 };
+};
+
+StallProfiler* StallProfiler::instance_ = nullptr;
+
+SB_ONCE_INITIALIZE_FUNCTION(StallProfiler, GetStallProfiler);
+
 void print_action(pid_t pid, const std::string& name) {
   fprintf(stderr, "\n*** Cobalt hang monitor expired!!! pid=%ld, monitor='%s'. Continue.\n", (long)pid, name.c_str());
 }
 
 void kill_action(pid_t pid, const std::string& name) {
   fprintf(stderr, "\n*** Hang detected in Cobalt!!! pid=%ld, monitor='%s'. sending SIGFPE \n", (long)pid, name.c_str());
+  GetStallProfiler()->SampleNow();
+  GetStallProfiler()->DumpToStderr();
   kill(pid, SIGFPE);
 
   SbThreadSleep( kSbTimeMinute );
@@ -58,15 +325,10 @@ void kill_action(pid_t pid, const std::string& name) {
 }
 
 SbTime get_check_interval() {
-  const char* env = std::getenv("COBALT_HANG_DETECTOR_INTERVAL_IN_SECONDS");
-  if( env ) {
-    int64_t t = strtol(env, nullptr, 0);
-    if ( 0 >= t )
-      return kSbTimeMax;
-    else
-      return kSbTimeSecond * t;
-  }
-  return kSbTimeSecond * 30;
+  int64_t t = GetTunable(Tunable::kHangDetectorInterval);
+  if ( 0 >= t )
+    return kSbTimeMax;
+  return kSbTimeSecond * t;
 }
 
 struct HangDetector
@@ -206,6 +468,18 @@ void HangMonitor::Reset() {
   expiration_count_ = 0;
 }
 
+void MarkMainThreadBusy() {
+  GetStallProfiler()->Beat(false);
+}
+
+void MarkMainThreadIdle() {
+  GetStallProfiler()->Beat(true);
+}
+
+std::string GetStallReports() {
+  return GetStallProfiler()->ReportsAsJson();
+}
+
 }  // namespace shared
 }  // namespace rdk
 }  // namespace starboard
@@ -42,6 +42,18 @@ private:
   int expiration_count_ { 0 };
 };
 
+// Stall profiler, enabled with COBALT_STALL_PROFILER_DEADLINE_MS. The main
+// thread marks when it blocks for events and when it works; when it works
+// past the deadline without coming back, its stack is sampled once and the
+// stall is kept, with its duration, in a short ring.
+void MarkMainThreadBusy();
+void MarkMainThreadIdle();
+
+// The recorded stalls, oldest first, frames symbolized:
+//   [{"start_us_ago":5300000,"duration_us":412000,"ongoing":false,
+//     "frames":["libcobalt.so(+0x1234) [0xb6f01234]", ...]}, ...]
+std::string GetStallReports();
+
 }  // namespace shared
 }  // namespace rdk
 }  // namespace starboard
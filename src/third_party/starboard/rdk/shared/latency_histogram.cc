@@ -0,0 +1,50 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/latency_histogram.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+
+void LatencyHistogram::Add(SbTime latency) {
+  int bucket = 0;
+  while (bucket < bucket_count_ - 1 && latency >= bounds_[bucket])
+    ++bucket;
+  ++counts_[bucket];
+}
+
+void LatencyHistogram::PrintCounts(std::ostream& out) const {
+  for (int i = 0; i < bucket_count_; ++i)
+    out << (i ? "," : "") << counts_[i];
+}
+
+std::ostream& operator<<(std::ostream& out, const LatencyHistogram& histogram) {
+  const int last = histogram.bucket_count() - 1;
+  for (int i = 0; i < last; ++i) {
+    out << "<" << histogram.bound(i) / kSbTimeMillisecond << "ms "
+        << histogram.count(i) << ", ";
+  }
+  return out << ">=" << histogram.bound(last - 1) / kSbTimeMillisecond
+             << "ms " << histogram.count(last);
+}
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
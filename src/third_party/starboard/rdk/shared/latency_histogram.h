@@ -0,0 +1,70 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_LATENCY_HISTOGRAM_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_LATENCY_HISTOGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ostream>
+
+#include "starboard/time.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+
+// Counts durations into buckets. |bounds| are the upper bounds of every
+// bucket but the last, which is open, ascending and in whole milliseconds.
+// They must outlive the histogram, a file level constant does. Not thread
+// safe, callers count under the lock of whatever the histogram belongs to.
+class LatencyHistogram {
+ public:
+  static const int kMaxBuckets = 8;
+
+  template <size_t N>
+  explicit LatencyHistogram(const SbTime (&bounds)[N])
+      : bounds_(bounds), bucket_count_(N + 1) {
+    static_assert(N + 1 <= kMaxBuckets, "Too many latency buckets");
+  }
+
+  void Add(SbTime latency);
+
+  int bucket_count() const { return bucket_count_; }
+  SbTime bound(int bucket) const { return bounds_[bucket]; }
+  uint64_t count(int bucket) const { return counts_[bucket]; }
+
+  // "12,3,0", the counts alone, for JSON arrays. operator<< below has the
+  // labelled form for logs.
+  void PrintCounts(std::ostream& out) const;
+
+ private:
+  const SbTime* bounds_;
+  int bucket_count_;
+  uint64_t counts_[kMaxBuckets]{};
+};
+
+// "<1ms 12, <4ms 3, >=4ms 0".
+std::ostream& operator<<(std::ostream& out, const LatencyHistogram& histogram);
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_LATENCY_HISTOGRAM_H_
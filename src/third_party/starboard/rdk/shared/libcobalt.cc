@@ -17,12 +17,23 @@
 
 #include "third_party/starboard/rdk/shared/libcobalt.h"
 
+#include <string.h>
+
+#include <string>
+
 #include "starboard/common/condition_variable.h"
+#include "starboard/common/log.h"
 #include "starboard/common/mutex.h"
 #include "starboard/common/semaphore.h"
 #include "starboard/once.h"
 
 #include "third_party/starboard/rdk/shared/application_rdk.h"
+#include "third_party/starboard/rdk/shared/hang_detector.h"
+#include "third_party/starboard/rdk/shared/player/player_replay.h"
+#include "third_party/starboard/rdk/shared/player/player_startup_trace.h"
+#include "third_party/starboard/rdk/shared/rdkservices.h"
+#include "third_party/starboard/rdk/shared/system/frame_pacer.h"
+#include "third_party/starboard/rdk/shared/tunables.h"
 
 using namespace third_party::starboard::rdk::shared;
 
@@ -104,6 +115,35 @@ struct APIContext
     sem.Take();
   }
 
+  int ReplayPlayerCapture(const char* path, bool max_speed) {
+    {
+      starboard::ScopedLock lock(mutex_);
+      WaitForApp(lock);
+    }
+    // No DRM system can be made here, refuse before creating a player
+    // rather than failing at the first encrypted sample.
+    if (player::IsEncryptedCapture(path)) {
+      SB_LOG(ERROR) << "Capture '" << path << "' is encrypted, replaying it"
+                    << " needs a DRM system and this call has none";
+      return -2;
+    }
+    bool result = player::ReplayPlayerCapture(path, max_speed, kSbDrmSystemInvalid, nullptr);
+    return result ? 0 : -1;
+  }
+
+  int RunServiceLatencyBenchmark(int iterations, char** out_json) {
+    {
+      starboard::ScopedLock lock(mutex_);
+      WaitForApp(lock);
+    }
+    std::string report = ServiceLatencyBenchmark::Run(iterations);
+    if (report.empty())
+      return -1;
+    if (out_json)
+      *out_json = strdup(report.c_str());
+    return 0;
+  }
+
   void RequestStop()
   {
     starboard::ScopedLock lock(mutex_);
@@ -176,10 +216,41 @@ void SbRdkQuit() {
 }
 
 void SbRdkSetSetting(const char* key, const char* json) {
+  SetTunable(key, json);
 }
 
 int SbRdkGetSetting(const char* key, char** out_json) {
+  std::string json;
+  if (!out_json || !GetTunableJson(key, &json))
     return -1;
+  *out_json = strdup(json.c_str());
+  return 0;
+}
+
+int SbRdkReplayPlayerCapture(const char* path, int max_speed) {
+  return GetContext()->ReplayPlayerCapture(path, max_speed != 0);
+}
+
+int SbRdkRunServiceLatencyBenchmark(int iterations, char** out_json) {
+  return GetContext()->RunServiceLatencyBenchmark(iterations, out_json);
+}
+
+int SbRdkGetPlayerStartupTraces(char** out_json) {
+  if (!out_json)
+    return -1;
+  *out_json = strdup(player::GetStartupTraces().c_str());
+  return 0;
+}
+
+int SbRdkGetStallReports(char** out_json) {
+  if (!out_json)
+    return -1;
+  *out_json = strdup(GetStallReports().c_str());
+  return 0;
+}
+
+void SbRdkSetUiAnimating(int animating) {
+  system::FramePacer::Get()->SetUiAnimating(animating != 0);
 }
 
 bool SbRdkIsResumed() {
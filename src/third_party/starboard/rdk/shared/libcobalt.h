@@ -35,9 +35,14 @@ SB_EXPORT_PLATFORM void SbRdkResume();
 SB_EXPORT_PLATFORM void SbRdkPause();
 SB_EXPORT_PLATFORM void SbRdkUnpause();
 SB_EXPORT_PLATFORM void SbRdkQuit();
-SB_EXPORT_PLATFORM void SbRdkSetSetting(const char* key, const char* json);
-SB_EXPORT_PLATFORM int  SbRdkGetSetting(const char* key, char** out_json);  // caller is responsible to free
+SB_EXPORT_PLATFORM void SbRdkSetSetting(const char* key, const char* json); // tunables.h, json null drops a stored value
+SB_EXPORT_PLATFORM int  SbRdkGetSetting(const char* key, char** out_json);  // empty key for all, caller is responsible to free
 SB_EXPORT_PLATFORM void SbRdkRegisterNotify(libCobaltCallback callback); // Register callback
+SB_EXPORT_PLATFORM int  SbRdkReplayPlayerCapture(const char* path, int max_speed); // blocks until replay ends, 0 on success, -2 for encrypted captures
+SB_EXPORT_PLATFORM int  SbRdkRunServiceLatencyBenchmark(int iterations, char** out_json); // needs tools/thunder_mock.py, caller is responsible to free
+SB_EXPORT_PLATFORM int  SbRdkGetPlayerStartupTraces(char** out_json); // recent player start timelines, caller is responsible to free
+SB_EXPORT_PLATFORM int  SbRdkGetStallReports(char** out_json); // main thread stalls, needs COBALT_STALL_PROFILER_DEADLINE_MS, caller is responsible to free
+SB_EXPORT_PLATFORM void SbRdkSetUiAnimating(int animating); // renderer, per submitted frame: animations pending or not, see system/frame_pacer.h
 
 #ifdef __cplusplus
 }  // extern "C"
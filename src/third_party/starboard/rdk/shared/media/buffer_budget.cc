@@ -0,0 +1,224 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/media/buffer_budget.h"
+
+#include <algorithm>
+
+#include "starboard/common/log.h"
+
+#include "third_party/starboard/rdk/shared/meminfo.h"
+
+#include "third_party/starboard/rdk/shared/log_override.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+namespace {
+
+// Media time the player keeps buffered ahead at most, what a measured
+// bitrate has to cover, with headroom for the peaks a 10 s average hides.
+const int64_t kBufferedSeconds = 60;
+const double kBitrateHeadroom = 1.25;
+// Trimmed budgets never go below a quarter of the fixed ones.
+const int kMinVideoBudgetDivisor = 4;
+const int kMinAudioBudgetDivisor = 2;
+// The max capacity has to hold the budgets of every stream plus this.
+const int64_t kCapacitySlack = 8 * kMegabyte;
+
+const int64_t kLowMemory = 128 * kMegabyte;
+const int64_t kCriticalMemory = 64 * kMegabyte;
+const SbTime kPressureCheckInterval = kSbTimeSecond;
+const SbTime kSharedGcThreshold = 90 * kSbTimeSecond;
+const SbTime kLowMemoryGcThreshold = 90 * kSbTimeSecond;
+const SbTime kCriticalMemoryGcThreshold = 45 * kSbTimeSecond;
+
+// Bytes per second of video relative to VP9 at the same quality. Only codecs
+// known to do better are trimmed, the fixed budgets are sized for VP9.
+double GetCodecFactor(SbMediaVideoCodec codec) {
+  switch (codec) {
+    case kSbMediaVideoCodecAv1:
+      return 0.75;
+    default:
+      return 1.0;
+  }
+}
+
+// Whole megabytes, the allocator hands out 1 MB units anyway.
+int RoundToMegabytes(int64_t size) {
+  return static_cast<int>((size + kMegabyte / 2) / kMegabyte * kMegabyte);
+}
+
+}  // namespace
+
+BufferBudget::BufferBudget(Environment* environment)
+    : environment_(environment) {}
+
+void BufferBudget::AddPlayer(const void* player, SbMediaVideoCodec codec) {
+  ::starboard::ScopedLock lock(mutex_);
+  players_[player].codec = codec;
+  SB_LOG(INFO) << "Media budget: " << players_.size() << " video players";
+}
+
+// Rises at once, falls over a few windows, so a quiet scene doesn't shrink
+// the budget right before a busy one.
+void BufferBudget::SetVideoBitrate(const void* player, int64_t bits_per_second) {
+  ::starboard::ScopedLock lock(mutex_);
+  auto it = players_.find(player);
+  if (it == players_.end())
+    return;
+  int64_t& bitrate = it->second.bitrate;
+  bitrate = bits_per_second >= bitrate
+                ? bits_per_second
+                : (bitrate * 3 + bits_per_second) / 4;
+}
+
+void BufferBudget::Remove(const void* player) {
+  ::starboard::ScopedLock lock(mutex_);
+  if (players_.erase(player))
+    SB_LOG(INFO) << "Media budget: " << players_.size() << " video players";
+}
+
+int BufferBudget::GetVideoBudget(SbMediaVideoCodec codec, int fixed_budget) {
+  if (!environment_->IsDynamic())
+    return fixed_budget;
+  ::starboard::ScopedLock lock(mutex_);
+  UpdatePressureLocked();
+  return GetVideoBudgetLocked(codec, fixed_budget);
+}
+
+int BufferBudget::GetAudioBudget(int fixed_budget) {
+  if (!environment_->IsDynamic())
+    return fixed_budget;
+  ::starboard::ScopedLock lock(mutex_);
+  UpdatePressureLocked();
+  int64_t budget = fixed_budget * PressureScaleLocked();
+  return std::max(static_cast<int>(budget),
+                  fixed_budget / kMinAudioBudgetDivisor);
+}
+
+int BufferBudget::GetMaxCapacity(int fixed_capacity,
+                                 int video_budget,
+                                 int audio_budget) {
+  if (!environment_->IsDynamic())
+    return fixed_capacity;
+  ::starboard::ScopedLock lock(mutex_);
+  UpdatePressureLocked();
+  const int64_t streams = std::max<size_t>(players_.size(), 1);
+  const int64_t needed =
+      streams * (static_cast<int64_t>(video_budget) + audio_budget) +
+      kCapacitySlack;
+  int64_t capacity = fixed_capacity * PressureScaleLocked();
+  capacity = std::min<int64_t>(std::max(capacity, needed), fixed_capacity);
+  return RoundToMegabytes(capacity);
+}
+
+SbTime BufferBudget::GetGarbageCollectionDurationThreshold(
+    SbTime fixed_threshold) {
+  if (!environment_->IsDynamic())
+    return fixed_threshold;
+  ::starboard::ScopedLock lock(mutex_);
+  SbTime threshold = fixed_threshold;
+  if (players_.size() > 1)
+    threshold = std::min(threshold, kSharedGcThreshold);
+  switch (UpdatePressureLocked()) {
+    case Pressure::kLow:
+      threshold = std::min(threshold, kLowMemoryGcThreshold);
+      break;
+    case Pressure::kCritical:
+      threshold = std::min(threshold, kCriticalMemoryGcThreshold);
+      break;
+    case Pressure::kNone:
+      break;
+  }
+  return threshold;
+}
+
+BufferBudget::Pressure BufferBudget::UpdatePressureLocked() {
+  SbTimeMonotonic now = environment_->GetMonotonicNow();
+  if (pressure_checked_at_ && now - pressure_checked_at_ < kPressureCheckInterval)
+    return pressure_;
+  pressure_checked_at_ = now;
+
+  int64_t available = environment_->GetMemAvailable();
+  Pressure pressure = Pressure::kNone;
+  if (available > 0 && available < kCriticalMemory)
+    pressure = Pressure::kCritical;
+  else if (available > 0 && available < kLowMemory)
+    pressure = Pressure::kLow;
+  if (pressure != pressure_) {
+    static const char* const kNames[] = {"none", "low", "critical"};
+    SB_LOG(INFO) << "Media budget: memory pressure "
+                 << kNames[static_cast<int>(pressure)] << ", "
+                 << available / kMegabyte << " MB available";
+    pressure_ = pressure;
+  }
+  return pressure_;
+}
+
+double BufferBudget::PressureScaleLocked() const {
+  switch (pressure_) {
+    case Pressure::kLow:
+      return 0.5;
+    case Pressure::kCritical:
+      return 0.25;
+    case Pressure::kNone:
+      break;
+  }
+  return 1.0;
+}
+
+int BufferBudget::GetVideoBudgetLocked(SbMediaVideoCodec codec,
+                                       int fixed_budget) {
+  int64_t budget = fixed_budget * GetCodecFactor(codec);
+
+  // The fastest stream of that codec, others don't say much about it.
+  int64_t bitrate = 0;
+  for (const auto& entry : players_) {
+    if (entry.second.codec == codec)
+      bitrate = std::max(bitrate, entry.second.bitrate);
+  }
+  if (bitrate > 0) {
+    int64_t needed = bitrate / 8 * kBufferedSeconds * kBitrateHeadroom;
+    budget = std::min(budget, needed);
+  }
+
+  // Every player's source buffer applies the budget on its own.
+  if (players_.size() > 1)
+    budget /= static_cast<int64_t>(players_.size());
+  budget *= PressureScaleLocked();
+
+  budget = std::max<int64_t>(budget, fixed_budget / kMinVideoBudgetDivisor);
+  int result = RoundToMegabytes(budget);
+  int& last = video_budgets_[std::make_pair(codec, fixed_budget)];
+  if (result != last) {
+    SB_LOG(INFO) << "Media budget: video " << result / kMegabyte << " MB of "
+                 << fixed_budget / kMegabyte << " MB, codec " << codec
+                 << ", bitrate " << bitrate / 1000 << " kbps, "
+                 << players_.size() << " players";
+    last = result;
+  }
+  return result;
+}
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
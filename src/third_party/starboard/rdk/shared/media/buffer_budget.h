@@ -0,0 +1,103 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_BUFFER_BUDGET_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_BUFFER_BUDGET_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <utility>
+
+#include "starboard/common/mutex.h"
+#include "starboard/media.h"
+#include "starboard/time.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+
+// Trims the media source budgets to what the playing streams need. The
+// fixed SbMediaGet*Budget() values stay the upper bound and are what a
+// single stream gets until more is known. They shrink for codecs that pack
+// the same duration into fewer bytes, for streams whose measured bitrate
+// doesn't need them, when several players share the memory and when
+// MemAvailable runs low, which also shortens the garbage collection
+// threshold. All of it is off unless the media_budget_dynamic tunable is
+// set, buffer_budget_test.cc replays a few streams through it.
+class BufferBudget {
+ public:
+  // What the budget reads from the system. The test plays it back from a
+  // profile instead.
+  class Environment {
+   public:
+    virtual ~Environment() {}
+    virtual bool IsDynamic() = 0;
+    // Bytes, 0 when unknown.
+    virtual int64_t GetMemAvailable() = 0;
+    virtual SbTimeMonotonic GetMonotonicNow() = 0;
+  };
+
+  // The one the SbMedia functions use, reading the tunable, MemAvailable and
+  // the monotonic clock. Both are in buffer_budget_system.cc.
+  static BufferBudget* Get();
+  BufferBudget();
+  // |environment| must outlive the budget.
+  explicit BufferBudget(Environment* environment);
+
+  // Players with video register on creation, report the bitrate of what
+  // they are fed once it is measured and Remove() themselves at the end.
+  void AddPlayer(const void* player, SbMediaVideoCodec codec);
+  void SetVideoBitrate(const void* player, int64_t bits_per_second);
+  void Remove(const void* player);
+
+  int GetVideoBudget(SbMediaVideoCodec codec, int fixed_budget);
+  int GetAudioBudget(int fixed_budget);
+  // Never below what the video and audio budgets, as returned above, of
+  // every player add up to.
+  int GetMaxCapacity(int fixed_capacity, int video_budget, int audio_budget);
+  SbTime GetGarbageCollectionDurationThreshold(SbTime fixed_threshold);
+
+ private:
+  enum class Pressure { kNone, kLow, kCritical };
+
+  struct Player {
+    SbMediaVideoCodec codec { kSbMediaVideoCodecNone };
+    int64_t bitrate { 0 };
+  };
+
+  Pressure UpdatePressureLocked();
+  double PressureScaleLocked() const;
+  int GetVideoBudgetLocked(SbMediaVideoCodec codec, int fixed_budget);
+
+  Environment* const environment_;
+  ::starboard::Mutex mutex_;
+  std::map<const void*, Player> players_;
+  Pressure pressure_ { Pressure::kNone };
+  SbTimeMonotonic pressure_checked_at_ { 0 };
+  // Last answer per codec and fixed budget, to log changes only.
+  std::map<std::pair<SbMediaVideoCodec, int>, int> video_budgets_;
+};
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_BUFFER_BUDGET_H_
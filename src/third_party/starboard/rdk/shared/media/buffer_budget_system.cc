@@ -0,0 +1,62 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/media/buffer_budget.h"
+
+#include "starboard/once.h"
+
+#include "third_party/starboard/rdk/shared/meminfo.h"
+#include "third_party/starboard/rdk/shared/tunables.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+namespace {
+
+// Kept out of buffer_budget.cc, so the unit test links without the tunables
+// and the rest of the platform.
+class SystemEnvironment : public BufferBudget::Environment {
+ public:
+  bool IsDynamic() override {
+    return GetTunable(Tunable::kDynamicMediaBudget) != 0;
+  }
+  int64_t GetMemAvailable() override { return shared::GetMemAvailable(); }
+  SbTimeMonotonic GetMonotonicNow() override {
+    return SbTimeGetMonotonicNow();
+  }
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(SystemEnvironment, GetSystemEnvironment);
+
+SB_ONCE_INITIALIZE_FUNCTION(BufferBudget, GetBufferBudget);
+
+}  // namespace
+
+// static
+BufferBudget* BufferBudget::Get() {
+  return GetBufferBudget();
+}
+
+BufferBudget::BufferBudget() : environment_(GetSystemEnvironment()) {}
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,399 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+// Unit tests of media::BufferBudget, and replays of bitrate, network and
+// memory profiles through it, once with the fixed budgets and once with the
+// dynamic ones. A profile is a list of steps, each lasting until the next
+// one starts, the last one only ends it. The video bitrate is that of the
+// media at that time, the network speed and MemAvailable that of the wall
+// clock. Every wall second the app appends what the network allows until
+// the video budget is full, then plays a second of media, or starves when
+// it isn't all there. What was appended is measured over 10 s of media, as
+// PlayerImpl::EstimateBitrate() does. One 1080p VP9 stream with the fixed
+// values of SbMediaGet*().
+
+#include "third_party/starboard/rdk/shared/media/buffer_budget.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "starboard/media.h"
+#include "starboard/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+#include "third_party/starboard/rdk/shared/meminfo.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+namespace {
+
+const int kFixedVideoBudget = 30 * kMegabyte;
+const int kFixedAudioBudget = 5 * kMegabyte;
+const int kFixedMaxCapacity = 50 * kMegabyte;
+const SbTime kFixedGcThreshold = 170 * kSbTimeSecond;
+const double kBitrateWindowSeconds = 10;
+// A profile the network never gets through ends after this many times its
+// length.
+const int64_t kMaxStretch = 10;
+
+struct Step {
+  int64_t start;  // seconds
+  int64_t video_kbps;
+  int64_t network_kbps;
+  int64_t mem_available_mb;
+};
+
+struct Profile {
+  std::string name;
+  std::vector<Step> steps;
+};
+
+struct Result {
+  int64_t peak_video_budget{0};
+  int64_t peak_audio_budget{0};
+  int64_t peak_capacity{0};
+  int64_t peak_buffered{0};
+  // Over the wall seconds.
+  double mean_video_budget{0};
+  double mean_buffered{0};
+  SbTime min_gc_threshold{kSbTimeMax};
+  int64_t starved_seconds{0};
+  int64_t wall_seconds{0};
+  bool finished{false};
+};
+
+class ProfileEnvironment : public BufferBudget::Environment {
+ public:
+  explicit ProfileEnvironment(bool dynamic) : dynamic_(dynamic) {}
+
+  bool IsDynamic() override { return dynamic_; }
+  int64_t GetMemAvailable() override { return mem_available_; }
+  SbTimeMonotonic GetMonotonicNow() override { return now_; }
+
+  void Set(SbTimeMonotonic now, int64_t mem_available) {
+    now_ = now;
+    mem_available_ = mem_available;
+  }
+
+ private:
+  const bool dynamic_;
+  SbTimeMonotonic now_{0};
+  int64_t mem_available_{0};
+};
+
+// Index of the step |second| falls in, the last real one past the end.
+size_t StepIndexAt(const Profile& profile, double second) {
+  size_t index = 0;
+  while (index + 2 < profile.steps.size() &&
+         profile.steps[index + 1].start <= second) {
+    ++index;
+  }
+  return index;
+}
+
+const Step& StepAt(const Profile& profile, double second) {
+  return profile.steps[StepIndexAt(profile, second)];
+}
+
+double BytesPerSecond(int64_t kbps) {
+  return kbps * 1000 / 8.0;
+}
+
+Result Simulate(const Profile& profile, bool dynamic) {
+  const int64_t end = profile.steps.back().start;
+  ProfileEnvironment environment(dynamic);
+  BufferBudget budget(&environment);
+  const int player = 0;
+  budget.AddPlayer(&player, kSbMediaVideoCodecVp9);
+
+  Result result;
+  double buffered = 0;        // bytes
+  double appended_until = 0;  // media seconds
+  int64_t played_until = 0;   // media seconds
+  double window_bytes = 0;
+  double window_seconds = 0;
+
+  for (int64_t wall = 0; played_until < end; ++wall) {
+    if (wall >= end * kMaxStretch)
+      break;
+    const Step& step = StepAt(profile, wall);
+    environment.Set(wall * kSbTimeSecond,
+                    step.mem_available_mb * kMegabyte);
+
+    const int video = budget.GetVideoBudget(kSbMediaVideoCodecVp9,
+                                            kFixedVideoBudget);
+    const int audio = budget.GetAudioBudget(kFixedAudioBudget);
+    const int capacity = budget.GetMaxCapacity(kFixedMaxCapacity, video,
+                                               audio);
+    const SbTime gc_threshold =
+        budget.GetGarbageCollectionDurationThreshold(kFixedGcThreshold);
+    result.peak_video_budget = std::max<int64_t>(result.peak_video_budget,
+                                                 video);
+    result.peak_audio_budget = std::max<int64_t>(result.peak_audio_budget,
+                                                 audio);
+    result.peak_capacity = std::max<int64_t>(result.peak_capacity, capacity);
+    result.min_gc_threshold = std::min(result.min_gc_threshold, gc_threshold);
+
+    // Append in pieces that don't cross a step of the media bitrate.
+    double allowance = BytesPerSecond(step.network_kbps);
+    while (appended_until < end && allowance > 0 && buffered < video) {
+      const size_t index = StepIndexAt(profile, appended_until);
+      const double rate = BytesPerSecond(profile.steps[index].video_kbps);
+      const double next = profile.steps[index + 1].start;
+      double bytes = std::min({allowance, video - buffered,
+                               (next - appended_until) * rate});
+      if (bytes <= 0)
+        break;
+      buffered += bytes;
+      allowance -= bytes;
+      appended_until = std::min(next, appended_until + bytes / rate);
+      window_bytes += bytes;
+      window_seconds += bytes / rate;
+      if (window_seconds >= kBitrateWindowSeconds) {
+        budget.SetVideoBitrate(&player, static_cast<int64_t>(
+                                            window_bytes * 8 / window_seconds));
+        window_bytes = 0;
+        window_seconds = 0;
+      }
+    }
+    result.peak_buffered = std::max<int64_t>(result.peak_buffered, buffered);
+
+    // Rounding may leave a sliver short of the second.
+    if (appended_until + 1e-6 >= played_until + 1) {
+      buffered = std::max(
+          0.0, buffered -
+                   BytesPerSecond(StepAt(profile, played_until).video_kbps));
+      ++played_until;
+    } else {
+      ++result.starved_seconds;
+    }
+    result.mean_video_budget += video;
+    result.mean_buffered += buffered;
+    result.wall_seconds = wall + 1;
+  }
+
+  result.finished = played_until >= end;
+  if (result.wall_seconds > 0) {
+    result.mean_video_budget /= result.wall_seconds;
+    result.mean_buffered /= result.wall_seconds;
+  }
+  budget.Remove(&player);
+  return result;
+}
+
+int64_t InMegabytes(int64_t size) {
+  return size / kMegabyte;
+}
+
+TEST(BufferBudgetTest, FixedUnlessDynamic) {
+  ProfileEnvironment environment(false);
+  environment.Set(0, 50 * kMegabyte);
+  BufferBudget budget(&environment);
+  const int player = 0;
+  budget.AddPlayer(&player, kSbMediaVideoCodecAv1);
+  budget.SetVideoBitrate(&player, 1000000);
+
+  EXPECT_EQ(kFixedVideoBudget,
+            budget.GetVideoBudget(kSbMediaVideoCodecAv1, kFixedVideoBudget));
+  EXPECT_EQ(kFixedAudioBudget, budget.GetAudioBudget(kFixedAudioBudget));
+  EXPECT_EQ(kFixedMaxCapacity,
+            budget.GetMaxCapacity(kFixedMaxCapacity, kFixedVideoBudget,
+                                  kFixedAudioBudget));
+  EXPECT_EQ(kFixedGcThreshold,
+            budget.GetGarbageCollectionDurationThreshold(kFixedGcThreshold));
+}
+
+TEST(BufferBudgetTest, TrimsToCodecAndBitrate) {
+  ProfileEnvironment environment(true);
+  environment.Set(0, 600 * kMegabyte);
+  BufferBudget budget(&environment);
+  const int player = 0;
+  budget.AddPlayer(&player, kSbMediaVideoCodecAv1);
+
+  EXPECT_EQ(23 * kMegabyte,
+            budget.GetVideoBudget(kSbMediaVideoCodecAv1, kFixedVideoBudget));
+  EXPECT_EQ(kFixedVideoBudget,
+            budget.GetVideoBudget(kSbMediaVideoCodecVp9, kFixedVideoBudget));
+
+  // 60 s of 1.5 Mbps with headroom.
+  budget.SetVideoBitrate(&player, 1500000);
+  EXPECT_EQ(13 * kMegabyte,
+            budget.GetVideoBudget(kSbMediaVideoCodecAv1, kFixedVideoBudget));
+
+  // Rises at once, falls over a few windows.
+  budget.SetVideoBitrate(&player, 3000000);
+  EXPECT_EQ(23 * kMegabyte,
+            budget.GetVideoBudget(kSbMediaVideoCodecAv1, kFixedVideoBudget));
+  budget.SetVideoBitrate(&player, 1500000);
+  EXPECT_EQ(23 * kMegabyte,
+            budget.GetVideoBudget(kSbMediaVideoCodecAv1, kFixedVideoBudget));
+
+  // Never below a quarter.
+  budget.SetVideoBitrate(&player, 1);
+  budget.SetVideoBitrate(&player, 1);
+  budget.SetVideoBitrate(&player, 1);
+  budget.SetVideoBitrate(&player, 1);
+  budget.SetVideoBitrate(&player, 1);
+  budget.SetVideoBitrate(&player, 1);
+  budget.SetVideoBitrate(&player, 1);
+  budget.SetVideoBitrate(&player, 1);
+  EXPECT_EQ(8 * kMegabyte,
+            budget.GetVideoBudget(kSbMediaVideoCodecAv1, kFixedVideoBudget));
+  budget.Remove(&player);
+}
+
+TEST(BufferBudgetTest, SharedBetweenPlayers) {
+  ProfileEnvironment environment(true);
+  environment.Set(0, 600 * kMegabyte);
+  BufferBudget budget(&environment);
+  const int first = 0;
+  const int second = 0;
+  budget.AddPlayer(&first, kSbMediaVideoCodecVp9);
+  budget.AddPlayer(&second, kSbMediaVideoCodecVp9);
+
+  const int video =
+      budget.GetVideoBudget(kSbMediaVideoCodecVp9, kFixedVideoBudget);
+  const int audio = budget.GetAudioBudget(kFixedAudioBudget);
+  EXPECT_EQ(15 * kMegabyte, video);
+  EXPECT_EQ(kFixedAudioBudget, audio);
+  EXPECT_EQ(kFixedMaxCapacity,
+            budget.GetMaxCapacity(kFixedMaxCapacity, video, audio));
+  EXPECT_EQ(90 * kSbTimeSecond,
+            budget.GetGarbageCollectionDurationThreshold(kFixedGcThreshold));
+
+  budget.Remove(&second);
+  EXPECT_EQ(kFixedVideoBudget,
+            budget.GetVideoBudget(kSbMediaVideoCodecVp9, kFixedVideoBudget));
+  EXPECT_EQ(kFixedGcThreshold,
+            budget.GetGarbageCollectionDurationThreshold(kFixedGcThreshold));
+  budget.Remove(&first);
+}
+
+TEST(BufferBudgetTest, ShrinksUnderMemoryPressure) {
+  ProfileEnvironment environment(true);
+  BufferBudget budget(&environment);
+  const int player = 0;
+  budget.AddPlayer(&player, kSbMediaVideoCodecVp9);
+
+  environment.Set(kSbTimeSecond, 100 * kMegabyte);
+  EXPECT_EQ(15 * kMegabyte,
+            budget.GetVideoBudget(kSbMediaVideoCodecVp9, kFixedVideoBudget));
+  EXPECT_EQ(kFixedAudioBudget / 2, budget.GetAudioBudget(kFixedAudioBudget));
+  EXPECT_EQ(90 * kSbTimeSecond,
+            budget.GetGarbageCollectionDurationThreshold(kFixedGcThreshold));
+
+  // MemAvailable is read once a second at most.
+  environment.Set(kSbTimeSecond + kSbTimeSecond / 2, 50 * kMegabyte);
+  EXPECT_EQ(15 * kMegabyte,
+            budget.GetVideoBudget(kSbMediaVideoCodecVp9, kFixedVideoBudget));
+
+  environment.Set(2 * kSbTimeSecond, 50 * kMegabyte);
+  const int video =
+      budget.GetVideoBudget(kSbMediaVideoCodecVp9, kFixedVideoBudget);
+  const int audio = budget.GetAudioBudget(kFixedAudioBudget);
+  EXPECT_EQ(8 * kMegabyte, video);
+  EXPECT_EQ(kFixedAudioBudget / 2, audio);
+  // A quarter of the fixed capacity doesn't hold the budgets.
+  EXPECT_EQ(19 * kMegabyte,
+            budget.GetMaxCapacity(kFixedMaxCapacity, video, audio));
+  EXPECT_EQ(45 * kSbTimeSecond,
+            budget.GetGarbageCollectionDurationThreshold(kFixedGcThreshold));
+
+  environment.Set(3 * kSbTimeSecond, 600 * kMegabyte);
+  EXPECT_EQ(kFixedVideoBudget,
+            budget.GetVideoBudget(kSbMediaVideoCodecVp9, kFixedVideoBudget));
+  budget.Remove(&player);
+}
+
+TEST(BufferBudgetTest, SteadyStream) {
+  const Profile profile = {
+      "steady 1.5 Mbps", {{0, 1500, 20000, 600}, {600, 0, 0, 0}}};
+  const Result fixed = Simulate(profile, false);
+  const Result dynamic = Simulate(profile, true);
+
+  EXPECT_TRUE(fixed.finished);
+  EXPECT_TRUE(dynamic.finished);
+  EXPECT_EQ(0, fixed.starved_seconds);
+  EXPECT_EQ(0, dynamic.starved_seconds);
+  EXPECT_EQ(30, InMegabytes(fixed.peak_buffered));
+  // Full only until the first bitrate is measured.
+  EXPECT_EQ(30, InMegabytes(dynamic.peak_video_budget));
+  EXPECT_EQ(13, InMegabytes(dynamic.peak_buffered));
+  EXPECT_LT(dynamic.mean_buffered, fixed.mean_buffered / 2);
+  EXPECT_EQ(kFixedGcThreshold, dynamic.min_gc_threshold);
+}
+
+TEST(BufferBudgetTest, BitrateStep) {
+  const Profile profile = {
+      "bitrate step from 1.5 to 8 Mbps",
+      {{0, 1500, 20000, 600}, {120, 8000, 20000, 600}, {420, 0, 0, 0}}};
+  const Result fixed = Simulate(profile, false);
+  const Result dynamic = Simulate(profile, true);
+
+  EXPECT_EQ(0, fixed.starved_seconds);
+  EXPECT_EQ(0, dynamic.starved_seconds);
+  // Back to the fixed budget once the faster stream is measured.
+  EXPECT_EQ(30, InMegabytes(dynamic.peak_buffered));
+  EXPECT_LT(dynamic.mean_video_budget, fixed.mean_video_budget);
+}
+
+TEST(BufferBudgetTest, NetworkOutage) {
+  const Profile profile = {"45 s network outage under a 2.5 Mbps stream",
+                           {{0, 2500, 20000, 600},
+                            {120, 2500, 0, 600},
+                            {165, 2500, 20000, 600},
+                            {300, 0, 0, 0}}};
+  const Result fixed = Simulate(profile, false);
+  const Result dynamic = Simulate(profile, true);
+
+  // 60 s of media still covers the outage.
+  EXPECT_EQ(0, fixed.starved_seconds);
+  EXPECT_EQ(0, dynamic.starved_seconds);
+  EXPECT_EQ(22, InMegabytes(dynamic.peak_buffered));
+}
+
+TEST(BufferBudgetTest, MemoryPressure) {
+  const Profile profile = {"memory pressure under a 5 Mbps stream",
+                           {{0, 5000, 20000, 600},
+                            {60, 5000, 20000, 100},
+                            {180, 5000, 20000, 50},
+                            {300, 5000, 20000, 600},
+                            {360, 0, 0, 0}}};
+  const Result fixed = Simulate(profile, false);
+  const Result dynamic = Simulate(profile, true);
+
+  EXPECT_EQ(0, fixed.starved_seconds);
+  EXPECT_EQ(0, dynamic.starved_seconds);
+  EXPECT_EQ(kFixedGcThreshold, fixed.min_gc_threshold);
+  EXPECT_EQ(45 * kSbTimeSecond, dynamic.min_gc_threshold);
+  EXPECT_EQ(5, InMegabytes(dynamic.peak_audio_budget));
+  EXPECT_EQ(50, InMegabytes(dynamic.peak_capacity));
+  EXPECT_LT(dynamic.mean_buffered, fixed.mean_buffered);
+}
+
+}  // namespace
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
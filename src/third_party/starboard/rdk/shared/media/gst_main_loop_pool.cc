@@ -0,0 +1,248 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/media/gst_main_loop_pool.h"
+
+#include <stdio.h>
+
+#include "starboard/common/condition_variable.h"
+#include "starboard/common/log.h"
+#include "starboard/once.h"
+#include "starboard/thread.h"
+#include "starboard/time.h"
+
+#include "third_party/starboard/rdk/shared/latency_histogram.h"
+
+#include "third_party/starboard/rdk/shared/log_override.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+namespace {
+
+// Two real-time loops cover a main player and a PIP/preview player without
+// making them wait on each other; bus watches of audio sinks share one.
+const int kMaxRealTimeLoops = 2;
+const int kMaxNormalLoops = 1;
+
+const guint kProbeIntervalMs = 100;
+const SbTime kReportInterval = 60 * kSbTimeSecond;
+// A loop this late held back every player on it for a visible while.
+const SbTime kStallThreshold = 50 * kSbTimeMillisecond;
+
+const SbTime kLatenessBuckets[] = {1 * kSbTimeMillisecond,
+                                   4 * kSbTimeMillisecond,
+                                   16 * kSbTimeMillisecond,
+                                   64 * kSbTimeMillisecond};
+
+SB_ONCE_INITIALIZE_FUNCTION(MainLoopPool, GetMainLoopPool);
+
+}  // namespace
+
+struct MainLoopPool::Loop {
+  MainLoopPool* pool;
+  MainLoopPool::Priority priority;
+  char name[16];
+  GMainContext* context;
+  GMainLoop* loop;
+  SbThread thread;
+  // Guarded by |pool->mutex_|.
+  int users;
+  uint64_t probes;
+  uint64_t stalls;
+  SbTime total_lateness;
+  SbTime max_lateness;
+  LatencyHistogram histogram{kLatenessBuckets};
+  SbTimeMonotonic last_report;
+  // Only touched on the loop thread.
+  SbTimeMonotonic next_probe;
+};
+
+// static
+MainLoopPool* MainLoopPool::Get() {
+  return GetMainLoopPool();
+}
+
+GMainContext* MainLoopPool::Acquire(Priority priority, const char* user) {
+  ::starboard::ScopedLock lock(mutex_);
+  const int max_loops =
+      priority == Priority::kRealTime ? kMaxRealTimeLoops : kMaxNormalLoops;
+  Loop* best = nullptr;
+  int count = 0;
+  for (Loop* loop : loops_) {
+    if (loop->priority != priority)
+      continue;
+    ++count;
+    if (!best || loop->users < best->users)
+      best = loop;
+  }
+  if (count < max_loops && (!best || best->users > 0)) {
+    Loop* loop = CreateLoop(priority, count);
+    if (loop) {
+      loops_.push_back(loop);
+      best = loop;
+    }
+  }
+  if (!best) {
+    SB_LOG(ERROR) << "No main loop available for " << user;
+    return nullptr;
+  }
+  ++best->users;
+  SB_LOG(INFO) << user << " runs on " << best->name << " (" << best->users
+               << " users)";
+  return g_main_context_ref(best->context);
+}
+
+void MainLoopPool::Release(GMainContext* context) {
+  if (!context)
+    return;
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    for (Loop* loop : loops_) {
+      if (loop->context != context)
+        continue;
+      SB_DCHECK(loop->users > 0);
+      if (--loop->users == 0)
+        LogStats(*loop);
+      break;
+    }
+  }
+  g_main_context_unref(context);
+}
+
+// static
+void MainLoopPool::Fence(GMainContext* context) {
+  if (!context || g_main_context_is_owner(context))
+    return;
+
+  struct FenceData {
+    ::starboard::Mutex mutex;
+    ::starboard::ConditionVariable condition{mutex};
+    bool done{false};
+  } data;
+
+  // Same priority as the dispatched tasks, so it runs after all of them.
+  GSource* src = g_idle_source_new();
+  g_source_set_priority(src, G_PRIORITY_DEFAULT);
+  g_source_set_callback(src,
+                        [](gpointer user_data) -> gboolean {
+                          FenceData* data = static_cast<FenceData*>(user_data);
+                          ::starboard::ScopedLock lock(data->mutex);
+                          data->done = true;
+                          data->condition.Signal();
+                          return G_SOURCE_REMOVE;
+                        },
+                        &data, nullptr);
+  g_source_attach(src, context);
+  g_source_unref(src);
+
+  ::starboard::ScopedLock lock(data.mutex);
+  while (!data.done)
+    data.condition.Wait();
+}
+
+MainLoopPool::Loop* MainLoopPool::CreateLoop(Priority priority, int index) {
+  Loop* loop = new Loop();
+  loop->pool = this;
+  loop->priority = priority;
+  snprintf(loop->name, sizeof(loop->name), "%s%d",
+           priority == Priority::kRealTime ? "media_loop_rt" : "media_loop",
+           index);
+  loop->context = g_main_context_new();
+  loop->loop = g_main_loop_new(loop->context, FALSE);
+  loop->last_report = SbTimeGetMonotonicNow();
+  loop->next_probe = loop->last_report + kProbeIntervalMs * kSbTimeMillisecond;
+
+  GSource* probe = g_timeout_source_new(kProbeIntervalMs);
+  g_source_set_callback(probe, &MainLoopPool::ProbeCallback, loop, nullptr);
+  g_source_attach(probe, loop->context);
+  g_source_unref(probe);
+
+  // Loops live as long as the process, so the threads are not joinable.
+  loop->thread = SbThreadCreate(
+      0,
+      priority == Priority::kRealTime ? kSbThreadPriorityRealTime
+                                      : kSbThreadPriorityNormal,
+      kSbThreadNoAffinity, false, loop->name, &MainLoopPool::ThreadEntryPoint,
+      loop);
+  if (!SbThreadIsValid(loop->thread)) {
+    SB_LOG(ERROR) << "Failed to start " << loop->name;
+    g_main_loop_unref(loop->loop);
+    g_main_context_unref(loop->context);
+    delete loop;
+    return nullptr;
+  }
+  return loop;
+}
+
+// static
+void* MainLoopPool::ThreadEntryPoint(void* context) {
+  Loop* loop = static_cast<Loop*>(context);
+  g_main_context_push_thread_default(loop->context);
+  g_main_loop_run(loop->loop);
+  g_main_context_pop_thread_default(loop->context);
+  return nullptr;
+}
+
+// static
+gboolean MainLoopPool::ProbeCallback(gpointer user_data) {
+  Loop* loop = static_cast<Loop*>(user_data);
+  SbTimeMonotonic now = SbTimeGetMonotonicNow();
+  SbTime lateness = now - loop->next_probe;
+  if (lateness < 0)
+    lateness = 0;
+  // GLib rearms a timeout from the time it was dispatched.
+  loop->next_probe = now + kProbeIntervalMs * kSbTimeMillisecond;
+
+  ::starboard::ScopedLock lock(loop->pool->mutex_);
+  if (loop->users == 0)
+    return G_SOURCE_CONTINUE;
+
+  loop->histogram.Add(lateness);
+  ++loop->probes;
+  loop->total_lateness += lateness;
+  if (lateness > loop->max_lateness)
+    loop->max_lateness = lateness;
+  if (lateness >= kStallThreshold) {
+    ++loop->stalls;
+    SB_LOG(WARNING) << loop->name << " dispatched " << lateness
+                    << " us late with " << loop->users << " users";
+  }
+  if (now - loop->last_report >= kReportInterval) {
+    LogStats(*loop);
+    loop->last_report = now;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+// static
+void MainLoopPool::LogStats(const Loop& loop) {
+  if (loop.probes == 0)
+    return;
+  SB_LOG(INFO) << loop.name << ": " << loop.probes << " probes, lateness avg "
+               << loop.total_lateness / static_cast<SbTime>(loop.probes)
+               << " us, max " << loop.max_lateness << " us, " << loop.stalls
+               << " stalls; " << loop.histogram;
+}
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
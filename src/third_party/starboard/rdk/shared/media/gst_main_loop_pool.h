@@ -0,0 +1,77 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_GST_MAIN_LOOP_POOL_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_GST_MAIN_LOOP_POOL_H_
+
+#include <vector>
+
+#include <glib.h>
+
+#include "starboard/common/mutex.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+
+// A few long lived GMainLoop threads shared by all players and audio sinks.
+// Bus watches, dispatched tasks and timers of every user of a loop are
+// multiplexed on its thread, so nothing attached to a pooled context may
+// block for long. Each loop runs a lateness probe and logs how late it
+// dispatches, which is the number to watch when adding users to the pool.
+class MainLoopPool {
+ public:
+  enum class Priority {
+    // Players, their bus and state changes drive playback.
+    kRealTime,
+    // Users that only watch a bus for errors.
+    kNormal,
+  };
+
+  static MainLoopPool* Get();
+
+  // Returns the context of the least loaded loop of |priority|, spawning a
+  // new loop while the class is below its thread limit. The caller holds a
+  // reference on the context until Release().
+  GMainContext* Acquire(Priority priority, const char* user);
+  void Release(GMainContext* context);
+
+  // Blocks until everything attached to |context| before the call has been
+  // dispatched. Returns right away when called on the loop's own thread.
+  static void Fence(GMainContext* context);
+
+ private:
+  struct Loop;
+
+  static void* ThreadEntryPoint(void* context);
+  static gboolean ProbeCallback(gpointer user_data);
+  static void LogStats(const Loop& loop);
+
+  Loop* CreateLoop(Priority priority, int index);
+
+  ::starboard::Mutex mutex_;
+  std::vector<Loop*> loops_;
+};
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_GST_MAIN_LOOP_POOL_H_
@@ -14,8 +14,14 @@
 // limitations under the License.
 //
 // SPDX-License-Identifier: Apache-2.0
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
 #include <memory>
 #include <type_traits>
+#include <utility>
 
 #include <glib.h>
 #include <gst/gst.h>
@@ -24,6 +30,11 @@
 #include "starboard/configuration.h"
 #include "starboard/configuration_constants.h"
 #include "starboard/common/log.h"
+#include "starboard/common/mutex.h"
+#include "starboard/event.h"
+#include "starboard/once.h"
+#include "starboard/system.h"
+#include "starboard/time.h"
 #include "third_party/starboard/rdk/shared/media/gst_media_utils.h"
 #include "third_party/starboard/rdk/shared/log_override.h"
 
@@ -129,16 +140,213 @@ bool GstRegistryHasElementForCodec(C codec) {
   return false;
 }
 
+const char kCodecCacheFileName[] = "gst_codec_support.cache";
+const int kCodecCacheFormat = 1;
+// New answers come in bursts while the app probes what it can play, they
+// are written once things have been quiet for this long.
+const SbTime kCodecCacheStoreDelay = 5 * kSbTimeSecond;
+
+// Remembers GstRegistryHasElementForCodec() answers across launches. The
+// cache file is tied to a fingerprint of the installed plugins, so a plugin
+// update, addition or removal makes the next launch probe the registry again.
+// Listing the plugins is cheap next to filtering the factory lists, which is
+// what a cache hit saves.
+class CodecSupportCache {
+ public:
+  template <typename C>
+  bool HasElementFor(C codec) {
+    const Key key{std::is_same<C, SbMediaVideoCodec>::value ? 'v' : 'a',
+                  static_cast<int>(codec)};
+    ::starboard::ScopedLock lock(mutex_);
+    if (!loaded_)
+      LoadLocked();
+
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      ++hits_;
+      saved_ += it->second.cost;
+      if ((hits_ & (hits_ - 1)) == 0) {
+        SB_LOG(INFO) << hits_ << " codec support answers from cache, "
+                     << saved_ << " us of registry probes saved";
+      }
+      return it->second.supported;
+    }
+
+    SbTimeMonotonic start = SbTimeGetMonotonicNow();
+    Entry entry;
+    entry.supported = GstRegistryHasElementForCodec(codec);
+    entry.cost = SbTimeGetMonotonicNow() - start;
+    entries_[key] = entry;
+    SB_LOG(INFO) << "Probed registry for " << key.first << " codec "
+                 << key.second << " in " << entry.cost << " us: "
+                 << (entry.supported ? "supported" : "unsupported");
+    ScheduleStoreLocked();
+    return entry.supported;
+  }
+
+ private:
+  // ('v' | 'a', codec).
+  using Key = std::pair<char, int>;
+
+  struct Entry {
+    bool supported{false};
+    // Time the registry probe took when the entry was computed.
+    SbTime cost{0};
+  };
+
+  static std::string ComputeFingerprint() {
+    std::vector<std::string> plugins;
+    GList* list = gst_registry_get_plugin_list(gst_registry_get());
+    for (GList* iter = list; iter; iter = iter->next) {
+      GstPlugin* plugin = static_cast<GstPlugin*>(iter->data);
+      const gchar* filename = gst_plugin_get_filename(plugin);
+      std::string line = gst_plugin_get_name(plugin);
+      line += ':';
+      line += gst_plugin_get_version(plugin);
+      struct stat info;
+      if (filename && stat(filename, &info) == 0) {
+        line += ':';
+        line += filename;
+        line += ':' + std::to_string(info.st_size) + ':' +
+                std::to_string(info.st_mtime);
+      }
+      plugins.push_back(line);
+    }
+    gst_plugin_list_free(list);
+    std::sort(plugins.begin(), plugins.end());
+
+    // FNV-1a over the GStreamer version and the sorted plugin list.
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const std::string& text) {
+      for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+      }
+      hash ^= '\n';
+      hash *= 1099511628211ULL;
+    };
+    gchar* version = gst_version_string();
+    mix(version);
+    g_free(version);
+    for (const std::string& plugin : plugins)
+      mix(plugin);
+
+    char fingerprint[17];
+    snprintf(fingerprint, sizeof(fingerprint), "%016llx",
+             static_cast<unsigned long long>(hash));
+    return fingerprint;
+  }
+
+  static bool GetCachePath(std::string* path) {
+    std::vector<char> dir(kSbFileMaxPath);
+    if (!SbSystemGetPath(kSbSystemPathCacheDirectory, dir.data(),
+                         static_cast<int>(dir.size())))
+      return false;
+    *path = std::string(dir.data()) + "/" + kCodecCacheFileName;
+    return true;
+  }
+
+  void LoadLocked() {
+    loaded_ = true;
+    SbTimeMonotonic start = SbTimeGetMonotonicNow();
+    fingerprint_ = ComputeFingerprint();
+    if (!GetCachePath(&path_)) {
+      SB_LOG(WARNING) << "No cache directory, codec support is not persisted";
+      return;
+    }
+
+    FILE* file = fopen(path_.c_str(), "r");
+    if (!file)
+      return;
+    int format = 0;
+    char fingerprint[32] = {0};
+    if (fscanf(file, "%d %31s", &format, fingerprint) != 2 ||
+        format != kCodecCacheFormat || fingerprint_ != fingerprint) {
+      SB_LOG(INFO) << "GStreamer registry changed, dropping " << path_;
+      fclose(file);
+      return;
+    }
+    char type;
+    int codec;
+    int supported;
+    long long cost;
+    SbTime total_cost = 0;
+    while (fscanf(file, " %c %d %d %lld", &type, &codec, &supported, &cost) ==
+           4) {
+      if (type != 'v' && type != 'a')
+        break;
+      Entry& entry = entries_[Key{type, codec}];
+      entry.supported = supported != 0;
+      entry.cost = cost;
+      total_cost += cost;
+    }
+    fclose(file);
+    SB_LOG(INFO) << "Loaded " << entries_.size() << " codec support entries"
+                 << " for registry " << fingerprint_ << " in "
+                 << SbTimeGetMonotonicNow() - start
+                 << " us, probing them took " << total_cost << " us";
+  }
+
+  void ScheduleStoreLocked() {
+    if (path_.empty())
+      return;
+    // Every miss pushes the write back, one write covers the whole burst.
+    if (store_event_ != kSbEventIdInvalid)
+      SbEventCancel(store_event_);
+    store_event_ = SbEventSchedule(
+        [](void* data) {
+          CodecSupportCache* cache = static_cast<CodecSupportCache*>(data);
+          ::starboard::ScopedLock lock(cache->mutex_);
+          cache->store_event_ = kSbEventIdInvalid;
+          cache->StoreLocked();
+        },
+        this, kCodecCacheStoreDelay);
+  }
+
+  void StoreLocked() {
+    // Write aside and rename, a crash must not leave a truncated cache.
+    std::string temp_path = path_ + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "w");
+    if (!file) {
+      SB_LOG(WARNING) << "Failed to write " << temp_path;
+      return;
+    }
+    fprintf(file, "%d %s\n", kCodecCacheFormat, fingerprint_.c_str());
+    for (const auto& item : entries_) {
+      fprintf(file, "%c %d %d %lld\n", item.first.first, item.first.second,
+              item.second.supported ? 1 : 0,
+              static_cast<long long>(item.second.cost));
+    }
+    bool ok = fclose(file) == 0;
+    if (!ok || rename(temp_path.c_str(), path_.c_str()) != 0) {
+      SB_LOG(WARNING) << "Failed to update " << path_;
+      remove(temp_path.c_str());
+    }
+  }
+
+  ::starboard::Mutex mutex_;
+  bool loaded_{false};
+  std::string fingerprint_;
+  std::string path_;
+  std::map<Key, Entry> entries_;
+  // Pending write of |entries_|, the instance is never destroyed.
+  SbEventId store_event_{kSbEventIdInvalid};
+  uint64_t hits_{0};
+  SbTime saved_{0};
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(CodecSupportCache, GetCodecSupportCache);
+
 }  // namespace
 
 bool GstRegistryHasElementForMediaType(SbMediaVideoCodec codec) {
   if (kSbMediaVideoCodecVp9 == codec && !kSbHasMediaWebmVp9Support)
     return false;
-  return GstRegistryHasElementForCodec(codec);
+  return GetCodecSupportCache()->HasElementFor(codec);
 }
 
 bool GstRegistryHasElementForMediaType(SbMediaAudioCodec codec) {
-  return GstRegistryHasElementForCodec(codec);
+  return GetCodecSupportCache()->HasElementFor(codec);
 }
 
 std::vector<std::string> CodecToGstCaps(SbMediaVideoCodec codec) {
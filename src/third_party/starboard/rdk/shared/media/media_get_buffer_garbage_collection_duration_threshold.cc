@@ -32,9 +32,13 @@
 #include "starboard/media.h"
 
 #include "starboard/common/log.h"
+#include "third_party/starboard/rdk/shared/media/buffer_budget.h"
+
+using third_party::starboard::rdk::shared::media::BufferBudget;
 
 #if SB_API_VERSION >= 10
 SbTime SbMediaGetBufferGarbageCollectionDurationThreshold() {
-  return 170 * kSbTimeSecond;
+  return BufferBudget::Get()->GetGarbageCollectionDurationThreshold(
+      170 * kSbTimeSecond);
 }
 #endif  // SB_API_VERSION >= 10
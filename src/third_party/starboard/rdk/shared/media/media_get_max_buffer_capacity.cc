@@ -16,13 +16,16 @@
 #include "starboard/media.h"
 
 #include "starboard/common/log.h"
+#include "third_party/starboard/rdk/shared/media/buffer_budget.h"
+
+using third_party::starboard::rdk::shared::media::BufferBudget;
 
 #if SB_API_VERSION >= 10
-int SbMediaGetMaxBufferCapacity(SbMediaVideoCodec codec,
-                                int resolution_width,
-                                int resolution_height,
-                                int bits_per_pixel) {
-  SB_UNREFERENCED_PARAMETER(codec);
+namespace {
+
+int GetFixedMaxBufferCapacity(int resolution_width,
+                              int resolution_height,
+                              int bits_per_pixel) {
   if ((resolution_width <= 1920 && resolution_height <= 1080) ||
       resolution_width == kSbMediaVideoResolutionDimensionInvalid ||
       resolution_height == kSbMediaVideoResolutionDimensionInvalid) {
@@ -53,4 +56,18 @@ int SbMediaGetMaxBufferCapacity(SbMediaVideoCodec codec,
   // must be larger than sum of 8k video budget and non-video budget.
   return 360 * 1024 * 1024;
 }
+
+}  // namespace
+
+int SbMediaGetMaxBufferCapacity(SbMediaVideoCodec codec,
+                                int resolution_width,
+                                int resolution_height,
+                                int bits_per_pixel) {
+  return BufferBudget::Get()->GetMaxCapacity(
+      GetFixedMaxBufferCapacity(resolution_width, resolution_height,
+                                bits_per_pixel),
+      SbMediaGetVideoBufferBudget(codec, resolution_width, resolution_height,
+                                  bits_per_pixel),
+      SbMediaGetAudioBufferBudget());
+}
 #endif  // SB_API_VERSION >= 10
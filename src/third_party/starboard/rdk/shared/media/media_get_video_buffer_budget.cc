@@ -15,13 +15,17 @@
 #include "starboard/media.h"
 
 #include "starboard/common/log.h"
+#include "third_party/starboard/rdk/shared/media/buffer_budget.h"
+
+using third_party::starboard::rdk::shared::media::BufferBudget;
 
 #if SB_API_VERSION >= 10
-int SbMediaGetVideoBufferBudget(SbMediaVideoCodec codec,
-                                int resolution_width,
-                                int resolution_height,
-                                int bits_per_pixel) {
-  SB_UNREFERENCED_PARAMETER(codec);
+namespace {
+
+// The most a stream gets, BufferBudget trims it to what is played.
+int GetFixedVideoBufferBudget(int resolution_width,
+                              int resolution_height,
+                              int bits_per_pixel) {
   if ((resolution_width <= 1920 && resolution_height <= 1080) ||
       resolution_width == kSbMediaVideoResolutionDimensionInvalid ||
       resolution_height == kSbMediaVideoResolutionDimensionInvalid) {
@@ -50,4 +54,15 @@ int SbMediaGetVideoBufferBudget(SbMediaVideoCodec codec,
   // lower than 8k (7680x4320).
   return 300 * 1024 * 1024;
 }
+
+}  // namespace
+
+int SbMediaGetVideoBufferBudget(SbMediaVideoCodec codec,
+                                int resolution_width,
+                                int resolution_height,
+                                int bits_per_pixel) {
+  return BufferBudget::Get()->GetVideoBudget(
+      codec, GetFixedVideoBufferBudget(resolution_width, resolution_height,
+                                       bits_per_pixel));
+}
 #endif  // SB_API_VERSION >= 10
@@ -36,7 +36,9 @@
 #include "starboard/common/log.h"
 #include "starboard/shared/starboard/media/media_support_internal.h"
 #include "third_party/starboard/rdk/shared/media/gst_media_utils.h"
-#include "aml_device_property.h"
+#include "third_party/starboard/rdk/shared/device_properties.h"
+
+using third_party::starboard::rdk::shared::GetDeviceProperty;
 
 static bool device_is_support_dolby = true; // Whether Cobalt should support AC3 and EAC3
 
@@ -44,8 +46,7 @@ static bool TryGetSupportDobly(void) {
   char out_value[20];
   int value_length = 20;
 
-  if (AmlDeviceGetProperty("ENABLE_DOLBY",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("ENABLE_DOLBY", out_value, value_length)) {
     if ((SbStringCompareNoCaseN(out_value, "FALSE", 5) == 0
           || SbStringCompareNoCaseN(out_value, "false", 5) == 0))
       return false;
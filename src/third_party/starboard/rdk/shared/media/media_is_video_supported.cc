@@ -29,6 +29,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdio.h>
+
 #include "starboard/configuration.h"
 #include "starboard/configuration_constants.h"
 #include "starboard/common/log.h"
@@ -36,12 +38,53 @@
 #include "starboard/shared/starboard/media/media_support_internal.h"
 #include "starboard/shared/starboard/media/media_util.h"
 #include "third_party/starboard/rdk/shared/media/gst_media_utils.h"
+#include "third_party/starboard/rdk/shared/media/media_support_cache.h"
 #include "third_party/starboard/rdk/shared/application_rdk.h"
+#include "third_party/starboard/rdk/shared/tunables.h"
 #include "third_party/starboard/rdk/shared/log_override.h"
-#include "starboard/common/string.h"
 
 using starboard::shared::starboard::media::IsSDRVideo;
 using third_party::starboard::rdk::shared::Application;
+using third_party::starboard::rdk::shared::ResolutionInfo;
+using third_party::starboard::rdk::shared::GetTunable;
+using third_party::starboard::rdk::shared::Tunable;
+using third_party::starboard::rdk::shared::media::GetVideoSupportCache;
+
+namespace {
+
+bool IsVideoSupported(const ResolutionInfo& resolution_info,
+                      SbMediaVideoCodec video_codec,
+                      int bit_depth,
+                      SbMediaPrimaryId primary_id,
+                      SbMediaTransferId transfer_id,
+                      SbMediaMatrixId matrix_id,
+                      int frame_width,
+                      int frame_height,
+                      int64_t bitrate,
+                      int fps) {
+  if (frame_height > resolution_info.Height || frame_width > resolution_info.Width ) {
+    return false;
+  }
+
+  if (transfer_id != kSbMediaTransferIdUnspecified &&
+      transfer_id != kSbMediaTransferIdBt709 &&
+      transfer_id != kSbMediaTransferIdSmpteSt2084 &&
+      transfer_id != kSbMediaTransferIdAribStdB67) {
+    return false;
+  }
+
+  if (!IsSDRVideo(bit_depth, primary_id, transfer_id, matrix_id)) {
+    if (!Application::Get()->DisplayHasHDRSupport())
+      return false;
+  }
+
+  return (video_codec == kSbMediaVideoCodecAv1 ||
+      video_codec == kSbMediaVideoCodecH264 ||
+      (video_codec == kSbMediaVideoCodecVp9)) &&
+    bitrate <= kSbMediaMaxVideoBitrateInBitsPerSecond && fps <= 60;
+}
+
+}  // namespace
 
 SB_EXPORT bool SbMediaIsVideoSupported(SbMediaVideoCodec video_codec,
                                        const char* content_type,
@@ -62,32 +105,30 @@ SB_EXPORT bool SbMediaIsVideoSupported(SbMediaVideoCodec video_codec,
     return false;
   }
 
-  const char* support_AV1 = getenv("COBALT_SUPPORT_AV1");
-
-  if (support_AV1) {
-    if (((SbStringCompareNoCaseN(support_AV1, "n", 1) == 0)||(SbStringCompareNoCaseN(support_AV1, "N", 1) == 0))
-          &&(video_codec == kSbMediaVideoCodecAv1))
-      return false; // not support AV1
-  }
-  auto resolution_info = Application::Get()->GetDisplayResolution();
-  if (frame_height > resolution_info.Height || frame_width > resolution_info.Width ) {
-    return false;
-  }
-
-  if (transfer_id != kSbMediaTransferIdUnspecified &&
-      transfer_id != kSbMediaTransferIdBt709 &&
-      transfer_id != kSbMediaTransferIdSmpteSt2084 &&
-      transfer_id != kSbMediaTransferIdAribStdB67) {
+  // Ahead of the cache, so changing the tunable needs no invalidation.
+  if (video_codec == kSbMediaVideoCodecAv1 &&
+      !GetTunable(Tunable::kSupportAv1))
     return false;
-  }
 
-  if (!IsSDRVideo(bit_depth, primary_id, transfer_id, matrix_id)) {
-    if (!Application::Get()->DisplayHasHDRSupport())
-      return false;
-  }
+  // The answer only depends on the arguments and the display, which
+  // invalidates the cache when it changes. The resolution is part of the
+  // key as well, COBALT_FORCE_SUPPORT_4K can change it without a display
+  // update.
+  const ResolutionInfo resolution_info =
+      Application::Get()->GetDisplayResolution();
+  char key[160];
+  snprintf(key, sizeof(key), "%d/%d/%d/%d/%d/%dx%d/%lld/%d/%dx%d", video_codec,
+           bit_depth, primary_id, transfer_id, matrix_id, frame_width,
+           frame_height, static_cast<long long>(bitrate), fps,
+           resolution_info.Width, resolution_info.Height);
+  bool supported = false;
+  uint32_t generation = 0;
+  if (GetVideoSupportCache()->Lookup(key, &supported, &generation))
+    return supported;
 
-  return (video_codec == kSbMediaVideoCodecAv1 ||
-      video_codec == kSbMediaVideoCodecH264 ||
-      (video_codec == kSbMediaVideoCodecVp9)) &&
-    bitrate <= kSbMediaMaxVideoBitrateInBitsPerSecond && fps <= 60;
+  supported = IsVideoSupported(resolution_info, video_codec, bit_depth,
+                               primary_id, transfer_id, matrix_id, frame_width,
+                               frame_height, bitrate, fps);
+  GetVideoSupportCache()->Store(key, supported, generation);
+  return supported;
 }
@@ -0,0 +1,99 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/media/media_support_cache.h"
+
+#include "starboard/common/log.h"
+
+#include "third_party/starboard/rdk/shared/log_override.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+namespace {
+
+// Cobalt asks about a few dozen distinct combinations, the bound only keeps
+// a misbehaving caller from growing the table forever.
+const size_t kMaxEntries = 512;
+
+}  // namespace
+
+SupportCache::SupportCache(const char* name) : name_(name) {}
+
+bool SupportCache::Lookup(const std::string& key,
+                          bool* supported,
+                          uint32_t* generation) {
+  ::starboard::ScopedLock lock(mutex_);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    ++hits_;
+    *supported = it->second;
+    return true;
+  }
+  ++misses_;
+  *generation = generation_;
+  return false;
+}
+
+void SupportCache::Store(const std::string& key,
+                         bool supported,
+                         uint32_t generation) {
+  ::starboard::ScopedLock lock(mutex_);
+  if (generation != generation_)
+    return;
+  if (entries_.size() >= kMaxEntries) {
+    SB_LOG(WARNING) << name_ << " cache full, starting over";
+    entries_.clear();
+  }
+  entries_[key] = supported;
+}
+
+void SupportCache::Invalidate(const char* reason) {
+  ::starboard::ScopedLock lock(mutex_);
+  ++generation_;
+  SB_LOG(INFO) << "Invalidating " << entries_.size() << ' ' << name_
+               << " answers: " << reason;
+  LogStatsLocked();
+  entries_.clear();
+}
+
+void SupportCache::LogStatsLocked() const {
+  if (hits_ + misses_ == 0)
+    return;
+  SB_LOG(INFO) << name_ << ": " << hits_ << " hits, " << misses_
+               << " misses";
+}
+
+// Never destroyed, like the SB_ONCE singletons, queries may come from any
+// thread until the process exits.
+SupportCache* GetVideoSupportCache() {
+  static SupportCache* cache = new SupportCache("video support");
+  return cache;
+}
+
+SupportCache* GetKeySystemSupportCache() {
+  static SupportCache* cache = new SupportCache("key system support");
+  return cache;
+}
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
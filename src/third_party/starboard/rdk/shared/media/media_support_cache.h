@@ -0,0 +1,69 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_MEDIA_SUPPORT_CACHE_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_MEDIA_SUPPORT_CACHE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "starboard/common/mutex.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace media {
+
+// Memoized answers of a support query, keyed by the query parameters
+// serialized into a string. Whoever owns the inputs of the decision calls
+// Invalidate() when they change. Answers computed while an invalidation was
+// in flight are dropped instead of stored, see Lookup().
+class SupportCache {
+ public:
+  explicit SupportCache(const char* name);
+
+  // Returns true and sets |supported| on a hit. On a miss |generation| is
+  // set and must be passed to the matching Store().
+  bool Lookup(const std::string& key, bool* supported, uint32_t* generation);
+  void Store(const std::string& key, bool supported, uint32_t generation);
+  void Invalidate(const char* reason);
+
+ private:
+  void LogStatsLocked() const;
+
+  const char* const name_;
+  ::starboard::Mutex mutex_;
+  uint32_t generation_{0};
+  std::unordered_map<std::string, bool> entries_;
+  uint64_t hits_{0};
+  uint64_t misses_{0};
+};
+
+// SbMediaIsVideoSupported() answers, they depend on the display.
+SupportCache* GetVideoSupportCache();
+// OpenCDM key system and MIME type answers.
+SupportCache* GetKeySystemSupportCache();
+
+}  // namespace media
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_MEDIA_MEDIA_SUPPORT_CACHE_H_
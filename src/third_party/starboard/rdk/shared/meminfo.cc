@@ -0,0 +1,53 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/meminfo.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+
+int64_t ReadProcValue(const char* path, const char* name) {
+  FILE* file = fopen(path, "r");
+  if (!file)
+    return 0;
+  const size_t name_length = strlen(name);
+  char line[128];
+  int64_t value = 0;
+  while (fgets(line, sizeof(line), file)) {
+    if (strncmp(line, name, name_length) == 0 && line[name_length] == ':') {
+      value = strtoll(line + name_length + 1, nullptr, 10) * 1024;
+      break;
+    }
+  }
+  fclose(file);
+  return value;
+}
+
+int64_t GetMemAvailable() {
+  return ReadProcValue("/proc/meminfo", "MemAvailable");
+}
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,41 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_MEMINFO_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_MEMINFO_H_
+
+#include <stdint.h>
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+
+const int64_t kMegabyte = 1024 * 1024;
+
+// A "Name:   1234 kB" line of a /proc file, such as /proc/meminfo or
+// /proc/self/status, in bytes. 0 when the file or the line is missing.
+int64_t ReadProcValue(const char* path, const char* name);
+
+// MemAvailable of /proc/meminfo in bytes, 0 on kernels without it.
+int64_t GetMemAvailable();
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_MEMINFO_H_
@@ -60,10 +60,6 @@ private:
 
   // Keeps track of the microphone's current state.
   State state_;
-
-  SbTime audio_duration_;
-  SbTime audio_interval_;
-  SbTime pre_audio_read_;
 };
 
 SbMicrophoneImpl::SbMicrophoneImpl() : state_(kClosed) {}
@@ -113,10 +109,6 @@ bool SbMicrophoneImpl::Open() {
 
 bool SbMicrophoneImpl::StartRecording() {
   bool flag = third_party::starboard::rdk::shared::VoiceInput::StartRecord();
-  if (flag) {
-    pre_audio_read_ = SbTimeGetMonotonicNow();
-    audio_interval_ = 0; // Microseconds, depends on sampleRate, buffersize of read data.
-  }
   SB_LOG(WARNING) << "micInternal: start recording:" << flag;
   return flag;
 }
@@ -149,24 +141,9 @@ int SbMicrophoneImpl::Read(void *out_audio_data, int audio_data_size) {
     SB_LOG(ERROR) << "micInternal:: invalid read data size";
     return -1;
   }
-// for 16000, 16_b, mono, 8k means 250ms data.
-// bigger size of buffer means more time for buffering data.
-  if (audio_data_size > 8192)
-    audio_data_size = 8192;
-
-  if (audio_interval_ == 0) {
-    // use samplerate 16000 and channel mono, pcm_16_b,
-    // need to change if mic use other parameters.
-    audio_interval_ = kSbTimeSecond * audio_data_size / (16000 * 2);
-  } else {
-    SbTime cur_time = SbTimeGetMonotonicNow();
-    if (cur_time < (pre_audio_read_ + audio_interval_)) {
-      return 0;
-    } else {
-      pre_audio_read_ += audio_interval_;
-    }
-  }
 
+  // Returns whatever was captured, waiting briefly for the next chunk when
+  // nothing is, so the caller is paced by the capture instead of a timer.
   return third_party::starboard::rdk::shared::VoiceInput::GetData(
       out_audio_data, audio_data_size);
 }
@@ -0,0 +1,370 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#include "third_party/starboard/rdk/shared/player/player_capture.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "starboard/atomic.h"
+
+#include "third_party/starboard/rdk/shared/log_override.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace player {
+
+namespace {
+
+const uint8_t kPadding[8] = {0};
+
+::starboard::atomic_int32_t g_capture_index(0);
+
+bool WriteFully(int fd, struct iovec* iov, int iovcnt) {
+  while (iovcnt > 0) {
+    ssize_t rc = writev(fd, iov, iovcnt);
+    if (rc < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    size_t written = static_cast<size_t>(rc);
+    while (iovcnt > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --iovcnt;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+// static
+std::unique_ptr<PlayerCapture> PlayerCapture::Create(
+    SbMediaVideoCodec video_codec,
+    SbMediaAudioCodec audio_codec,
+    bool has_drm_system,
+    const SbMediaAudioSampleInfo& audio_sample_info,
+    const char* max_video_capabilities) {
+  const char* dir = std::getenv("COBALT_PLAYER_CAPTURE_DIR");
+  if (!dir || !*dir)
+    return nullptr;
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/cobalt-player-%ld-%d.sbcap", dir,
+           static_cast<long>(getpid()), g_capture_index.increment());
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    SB_LOG(ERROR) << "Failed to create player capture '" << path
+                  << "', errno " << errno;
+    return nullptr;
+  }
+
+  std::unique_ptr<PlayerCapture> capture(new PlayerCapture(fd, path));
+  if (!capture->WriteHeader(video_codec, audio_codec, has_drm_system,
+                            audio_sample_info, max_video_capabilities)) {
+    SB_LOG(ERROR) << "Failed to write player capture header to '" << path
+                  << "'";
+    return nullptr;
+  }
+
+  SB_LOG(INFO) << "Capturing player session to '" << path << "'";
+  return capture;
+}
+
+PlayerCapture::PlayerCapture(int fd, std::string path)
+    : fd_(fd),
+      path_(std::move(path)),
+      start_time_(SbTimeGetMonotonicNow()) {}
+
+PlayerCapture::~PlayerCapture() {
+  SB_LOG(INFO) << "Player capture '" << path_ << "' closed, "
+               << bytes_written_ << " bytes" << (failed_ ? " (truncated)" : "");
+  close(fd_);
+}
+
+bool PlayerCapture::WriteHeader(SbMediaVideoCodec video_codec,
+                                SbMediaAudioCodec audio_codec,
+                                bool has_drm_system,
+                                const SbMediaAudioSampleInfo& audio_sample_info,
+                                const char* max_video_capabilities) {
+  CaptureFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kCaptureMagic, sizeof(header.magic));
+  header.version = kCaptureVersion;
+  header.color_metadata_size = sizeof(SbMediaColorMetadata);
+  header.subsample_mapping_size = sizeof(SbDrmSubSampleMapping);
+  header.video_codec = video_codec;
+  header.audio_codec = audio_codec;
+  header.has_drm_system = has_drm_system ? 1 : 0;
+  header.audio_format_tag = audio_sample_info.format_tag;
+  header.audio_number_of_channels = audio_sample_info.number_of_channels;
+  header.audio_samples_per_second = audio_sample_info.samples_per_second;
+  header.audio_average_bytes_per_second =
+      audio_sample_info.average_bytes_per_second;
+  header.audio_block_alignment = audio_sample_info.block_alignment;
+  header.audio_bits_per_sample = audio_sample_info.bits_per_sample;
+  header.audio_specific_config_size =
+      audio_sample_info.audio_specific_config
+          ? audio_sample_info.audio_specific_config_size
+          : 0;
+  header.max_video_capabilities_size =
+      max_video_capabilities ? strlen(max_video_capabilities) + 1 : 0;
+
+  size_t variable_size =
+      header.audio_specific_config_size + header.max_video_capabilities_size;
+  header.header_size = CaptureAlign(sizeof(header) + variable_size);
+
+  struct iovec iov[4] = {
+    {&header, sizeof(header)},
+    {const_cast<void*>(audio_sample_info.audio_specific_config),
+     header.audio_specific_config_size},
+    {const_cast<char*>(max_video_capabilities),
+     header.max_video_capabilities_size},
+    {const_cast<uint8_t*>(kPadding),
+     header.header_size - sizeof(header) - variable_size},
+  };
+  ::starboard::ScopedLock lock(mutex_);
+  if (!WriteFully(fd_, iov, 4)) {
+    failed_ = true;
+    return false;
+  }
+  bytes_written_ += header.header_size;
+  return true;
+}
+
+void PlayerCapture::WriteRecord(CaptureRecordType type,
+                                const void* body,
+                                size_t body_size,
+                                const void* extra,
+                                size_t extra_size,
+                                const void* payload,
+                                size_t payload_size) {
+  size_t unpadded = body_size + extra_size + payload_size;
+  CaptureRecordHeader header;
+  header.type = type;
+  header.size = CaptureAlign(unpadded);
+  header.time = SbTimeGetMonotonicNow() - start_time_;
+
+  struct iovec iov[5] = {
+    {&header, sizeof(header)},
+    {const_cast<void*>(body), body_size},
+    {const_cast<void*>(extra), extra_size},
+    {const_cast<void*>(payload), payload_size},
+    {const_cast<uint8_t*>(kPadding), header.size - unpadded},
+  };
+
+  ::starboard::ScopedLock lock(mutex_);
+  if (failed_)
+    return;
+  if (!WriteFully(fd_, iov, 5)) {
+    SB_LOG(ERROR) << "Player capture '" << path_ << "' write failed, errno "
+                  << errno << ". Capture stopped.";
+    failed_ = true;
+    return;
+  }
+  bytes_written_ += sizeof(header) + header.size;
+}
+
+void PlayerCapture::OnWriteSample(const SbPlayerSampleInfo& sample_info) {
+  CaptureSampleRecord record;
+  memset(&record, 0, sizeof(record));
+  record.media_type = sample_info.type;
+  record.buffer_size = sample_info.buffer_size;
+  record.timestamp = sample_info.timestamp;
+  if (sample_info.type == kSbMediaTypeVideo) {
+    const auto& info = sample_info.video_sample_info;
+    record.is_key_frame = info.is_key_frame ? 1 : 0;
+    record.frame_width = info.frame_width;
+    record.frame_height = info.frame_height;
+    record.color_metadata = info.color_metadata;
+  }
+
+  const void* subsamples = nullptr;
+  size_t subsamples_size = 0;
+  if (const SbDrmSampleInfo* drm_info = sample_info.drm_info) {
+    record.has_drm_info = 1;
+    record.encryption_scheme = drm_info->encryption_scheme;
+    record.crypt_byte_block = drm_info->encryption_pattern.crypt_byte_block;
+    record.skip_byte_block = drm_info->encryption_pattern.skip_byte_block;
+    record.initialization_vector_size =
+        std::min<int32_t>(drm_info->initialization_vector_size,
+                          sizeof(record.initialization_vector));
+    memcpy(record.initialization_vector, drm_info->initialization_vector,
+           record.initialization_vector_size);
+    record.identifier_size = std::min<int32_t>(drm_info->identifier_size,
+                                               sizeof(record.identifier));
+    memcpy(record.identifier, drm_info->identifier, record.identifier_size);
+    record.subsample_count = drm_info->subsample_count;
+    subsamples = drm_info->subsample_mapping;
+    subsamples_size =
+        drm_info->subsample_count * sizeof(SbDrmSubSampleMapping);
+  }
+
+  WriteRecord(kCaptureRecordSample, &record, sizeof(record), subsamples,
+              subsamples_size, sample_info.buffer, sample_info.buffer_size);
+}
+
+void PlayerCapture::OnSeek(SbTime seek_to_timestamp, int ticket) {
+  CaptureSeekRecord record = {seek_to_timestamp, ticket, 0};
+  WriteRecord(kCaptureRecordSeek, &record, sizeof(record));
+}
+
+void PlayerCapture::OnSetRate(double rate) {
+  CaptureSetRateRecord record = {rate};
+  WriteRecord(kCaptureRecordSetRate, &record, sizeof(record));
+}
+
+void PlayerCapture::OnEndOfStream(SbMediaType stream_type) {
+  CaptureEndOfStreamRecord record = {stream_type, 0};
+  WriteRecord(kCaptureRecordEndOfStream, &record, sizeof(record));
+}
+
+void PlayerCapture::OnSetVolume(double volume) {
+  CaptureSetVolumeRecord record = {volume};
+  WriteRecord(kCaptureRecordSetVolume, &record, sizeof(record));
+}
+
+PlayerCaptureReader::~PlayerCaptureReader() {
+  if (data_)
+    munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+bool PlayerCaptureReader::Open(const char* path) {
+  SB_DCHECK(!data_);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    SB_LOG(ERROR) << "Cannot open player capture '" << path << "'";
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(CaptureFileHeader)) {
+    SB_LOG(ERROR) << "Player capture '" << path << "' is too short";
+    close(fd);
+    return false;
+  }
+
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    SB_LOG(ERROR) << "Cannot map player capture '" << path << "'";
+    return false;
+  }
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+  data_ = static_cast<const uint8_t*>(data);
+  size_ = st.st_size;
+  header_ = reinterpret_cast<const CaptureFileHeader*>(data_);
+
+  if (memcmp(header_->magic, kCaptureMagic, sizeof(kCaptureMagic)) != 0 ||
+      header_->version != kCaptureVersion ||
+      header_->color_metadata_size != sizeof(SbMediaColorMetadata) ||
+      header_->subsample_mapping_size != sizeof(SbDrmSubSampleMapping) ||
+      header_->header_size > size_ ||
+      sizeof(CaptureFileHeader) + header_->audio_specific_config_size +
+              header_->max_video_capabilities_size >
+          header_->header_size) {
+    SB_LOG(ERROR) << "Player capture '" << path
+                  << "' has an unsupported format";
+    munmap(data, size_);
+    data_ = nullptr;
+    header_ = nullptr;
+    size_ = 0;
+    return false;
+  }
+  return true;
+}
+
+const uint8_t* PlayerCaptureReader::AudioSpecificConfig() const {
+  if (!header_->audio_specific_config_size)
+    return nullptr;
+  return data_ + sizeof(CaptureFileHeader);
+}
+
+const char* PlayerCaptureReader::MaxVideoCapabilities() const {
+  if (!header_->max_video_capabilities_size)
+    return nullptr;
+  return reinterpret_cast<const char*>(data_ + sizeof(CaptureFileHeader) +
+                                       header_->audio_specific_config_size);
+}
+
+bool PlayerCaptureReader::Next(size_t* offset, Record* out) const {
+  size_t pos = *offset ? *offset : header_->header_size;
+  if (pos + sizeof(CaptureRecordHeader) > size_)
+    return false;
+  auto* header = reinterpret_cast<const CaptureRecordHeader*>(data_ + pos);
+  size_t end = pos + sizeof(CaptureRecordHeader) + header->size;
+  if (end > size_) {
+    SB_LOG(WARNING) << "Truncated player capture record at offset " << pos;
+    return false;
+  }
+  if (header->type == kCaptureRecordSample) {
+    auto* sample = reinterpret_cast<const CaptureSampleRecord*>(header + 1);
+    if (header->size < sizeof(CaptureSampleRecord) ||
+        sample->subsample_count < 0 ||
+        sizeof(CaptureSampleRecord) +
+                sample->subsample_count * sizeof(SbDrmSubSampleMapping) +
+                sample->buffer_size >
+            header->size) {
+      SB_LOG(WARNING) << "Corrupted player capture sample at offset " << pos;
+      return false;
+    }
+  }
+  out->header = header;
+  out->body = header + 1;
+  *offset = end;
+  return true;
+}
+
+// static
+const SbDrmSubSampleMapping* PlayerCaptureReader::SubsampleMapping(
+    const CaptureSampleRecord* sample) {
+  return reinterpret_cast<const SbDrmSubSampleMapping*>(sample + 1);
+}
+
+// static
+const uint8_t* PlayerCaptureReader::Payload(
+    const CaptureSampleRecord* sample) {
+  return reinterpret_cast<const uint8_t*>(SubsampleMapping(sample) +
+                                          sample->subsample_count);
+}
+
+}  // namespace player
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,220 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_PLAYER_CAPTURE_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_PLAYER_CAPTURE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "starboard/common/mutex.h"
+#include "starboard/drm.h"
+#include "starboard/media.h"
+#include "starboard/player.h"
+#include "starboard/time.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace player {
+
+// Elementary stream capture of a single SbPlayer session.
+//
+// The file is a flat sequence of 8 byte aligned POD records so it can be
+// mmap()ed and walked in place by the replay side:
+//
+//   CaptureFileHeader
+//   uint8_t  audio_specific_config[audio_specific_config_size]
+//   char     max_video_capabilities[max_video_capabilities_size]
+//   (padding to 8 bytes)
+//   { CaptureRecordHeader, record body, (padding to 8 bytes) } ...
+//
+// Sample bodies are CaptureSampleRecord followed by |subsample_count|
+// SbDrmSubSampleMapping entries and |buffer_size| payload bytes.
+//
+// Capture is enabled by pointing COBALT_PLAYER_CAPTURE_DIR to a writable
+// directory. Files are named cobalt-player-<pid>-<index>.sbcap.
+
+const char kCaptureMagic[8] = {'S', 'B', 'P', 'L', 'C', 'A', 'P', '\0'};
+const uint32_t kCaptureVersion = 1;
+
+enum CaptureRecordType : uint32_t {
+  kCaptureRecordSample = 1,
+  kCaptureRecordSeek = 2,
+  kCaptureRecordSetRate = 3,
+  kCaptureRecordEndOfStream = 4,
+  kCaptureRecordSetVolume = 5,
+};
+
+struct CaptureFileHeader {
+  char magic[8];
+  uint32_t version;
+  // sizeof() of the Starboard structs stored verbatim, used to reject
+  // captures taken with an incompatible Starboard ABI.
+  uint32_t color_metadata_size;
+  uint32_t subsample_mapping_size;
+  uint32_t header_size;  // Including trailing variable data and padding.
+  int32_t video_codec;
+  int32_t audio_codec;
+  int32_t has_drm_system;
+  int32_t audio_format_tag;
+  int32_t audio_number_of_channels;
+  int32_t audio_samples_per_second;
+  int32_t audio_average_bytes_per_second;
+  int32_t audio_block_alignment;
+  int32_t audio_bits_per_sample;
+  uint32_t audio_specific_config_size;
+  uint32_t max_video_capabilities_size;  // Including the terminating '\0'.
+  uint32_t reserved;
+};
+
+struct CaptureRecordHeader {
+  uint32_t type;
+  uint32_t size;  // Body size in bytes, padding included.
+  SbTime time;    // Monotonic time relative to the start of the capture.
+};
+
+struct CaptureSampleRecord {
+  int32_t media_type;
+  uint32_t buffer_size;
+  SbTime timestamp;
+  int32_t is_key_frame;
+  int32_t frame_width;
+  int32_t frame_height;
+  int32_t has_drm_info;
+  int32_t encryption_scheme;
+  int32_t crypt_byte_block;
+  int32_t skip_byte_block;
+  int32_t initialization_vector_size;
+  int32_t identifier_size;
+  int32_t subsample_count;
+  uint8_t initialization_vector[16];
+  uint8_t identifier[16];
+  SbMediaColorMetadata color_metadata;
+};
+
+struct CaptureSeekRecord {
+  SbTime seek_to_timestamp;
+  int32_t ticket;
+  int32_t reserved;
+};
+
+struct CaptureSetRateRecord {
+  double rate;
+};
+
+struct CaptureEndOfStreamRecord {
+  int32_t media_type;
+  int32_t reserved;
+};
+
+struct CaptureSetVolumeRecord {
+  double volume;
+};
+
+inline size_t CaptureAlign(size_t size) {
+  return (size + 7u) & ~static_cast<size_t>(7u);
+}
+
+class PlayerCapture {
+ public:
+  // Returns nullptr unless capture is enabled or the file can't be created.
+  static std::unique_ptr<PlayerCapture> Create(
+      SbMediaVideoCodec video_codec,
+      SbMediaAudioCodec audio_codec,
+      bool has_drm_system,
+      const SbMediaAudioSampleInfo& audio_sample_info,
+      const char* max_video_capabilities);
+
+  ~PlayerCapture();
+
+  const std::string& Path() const { return path_; }
+
+  void OnWriteSample(const SbPlayerSampleInfo& sample_info);
+  void OnSeek(SbTime seek_to_timestamp, int ticket);
+  void OnSetRate(double rate);
+  void OnEndOfStream(SbMediaType stream_type);
+  void OnSetVolume(double volume);
+
+ private:
+  PlayerCapture(int fd, std::string path);
+
+  bool WriteHeader(SbMediaVideoCodec video_codec,
+                   SbMediaAudioCodec audio_codec,
+                   bool has_drm_system,
+                   const SbMediaAudioSampleInfo& audio_sample_info,
+                   const char* max_video_capabilities);
+  void WriteRecord(CaptureRecordType type,
+                   const void* body,
+                   size_t body_size,
+                   const void* extra = nullptr,
+                   size_t extra_size = 0,
+                   const void* payload = nullptr,
+                   size_t payload_size = 0);
+
+  ::starboard::Mutex mutex_;
+  int fd_;
+  std::string path_;
+  SbTimeMonotonic start_time_;
+  uint64_t bytes_written_{0};
+  bool failed_{false};
+};
+
+// Read-only view over a capture file mapped into memory.
+class PlayerCaptureReader {
+ public:
+  struct Record {
+    const CaptureRecordHeader* header;
+    const void* body;
+  };
+
+  PlayerCaptureReader() = default;
+  ~PlayerCaptureReader();
+
+  bool Open(const char* path);
+
+  const CaptureFileHeader& Header() const { return *header_; }
+  const uint8_t* AudioSpecificConfig() const;
+  const char* MaxVideoCapabilities() const;
+
+  // Advances |offset| (start with 0) and returns false at end of file or
+  // when a truncated record is found.
+  bool Next(size_t* offset, Record* out) const;
+
+  static const SbDrmSubSampleMapping* SubsampleMapping(
+      const CaptureSampleRecord* sample);
+  static const uint8_t* Payload(const CaptureSampleRecord* sample);
+
+ private:
+  PlayerCaptureReader(const PlayerCaptureReader&) = delete;
+  PlayerCaptureReader& operator=(const PlayerCaptureReader&) = delete;
+
+  const uint8_t* data_{nullptr};
+  size_t size_{0};
+  const CaptureFileHeader* header_{nullptr};
+};
+
+}  // namespace player
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_PLAYER_CAPTURE_H_
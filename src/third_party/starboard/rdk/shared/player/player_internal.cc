@@ -29,6 +29,7 @@
 #include <gst/video/video.h>
 #include <gst/allocators/gstsecmemallocator.h>
 
+#include <deque>
 #include <map>
 #include <string>
 
@@ -39,9 +40,15 @@
 #include "starboard/time.h"
 #include "starboard/memory.h"
 #include "third_party/starboard/rdk/shared/drm/drm_system_ocdm.h"
+#include "third_party/starboard/rdk/shared/media/buffer_budget.h"
+#include "third_party/starboard/rdk/shared/media/gst_main_loop_pool.h"
 #include "third_party/starboard/rdk/shared/media/gst_media_utils.h"
 #include "third_party/starboard/rdk/shared/hang_detector.h"
 #include "third_party/starboard/rdk/shared/application_rdk.h"
+#include "third_party/starboard/rdk/shared/player/player_capture.h"
+#include "third_party/starboard/rdk/shared/player/player_startup_trace.h"
+#include "third_party/starboard/rdk/shared/system/frame_pacer.h"
+#include "third_party/starboard/rdk/shared/tunables.h"
 #include "starboard/common/string.h"
 #ifdef USED_SVP_EXT
 #include "gst_svp_meta.h"
@@ -60,7 +67,10 @@ int Player::MaxNumberOfSamplesPerWrite() {
 }
 
 using third_party::starboard::rdk::shared::drm::DrmSystemOcdm;
+using third_party::starboard::rdk::shared::media::BufferBudget;
 using third_party::starboard::rdk::shared::media::CodecToGstCaps;
+using third_party::starboard::rdk::shared::media::MainLoopPool;
+using third_party::starboard::rdk::shared::system::FramePacer;
 
 // **************************** GST/GLIB Helpers **************************** //
 
@@ -136,11 +146,15 @@ GType gst_cobalt_src_get_type(void);
 
 G_END_DECLS
 
+typedef void (*GstCobaltSrcPrerollCallback)(gpointer user_data);
+
 struct _GstCobaltSrcPrivate {
   gchar* uri;
   guint pad_number;
   gboolean async_start;
   gboolean async_done;
+  GstCobaltSrcPrerollCallback preroll_callback;
+  gpointer preroll_callback_data;
 };
 
 enum { PROP_0, PROP_LOCATION };
@@ -167,6 +181,8 @@ static void gst_cobalt_src_init(GstCobaltSrc* src) {
   src->priv->pad_number = 0;
   src->priv->async_start = FALSE;
   src->priv->async_done = FALSE;
+  src->priv->preroll_callback = nullptr;
+  src->priv->preroll_callback_data = nullptr;
   g_object_set(GST_BIN(src), "message-forward", TRUE, NULL);
 }
 
@@ -341,23 +357,20 @@ void gst_cobalt_src_handle_message(GstBin* bin, GstMessage* message) {
 
 void gst_cobalt_src_setup_and_add_app_src(GstElement* element,
                                           GstElement* appsrc,
-                                          const char* caps,
+                                          GstCaps* caps,
                                           GstAppSrcCallbacks* callbacks,
                                           gpointer user_data,
                                           bool is_video) {
-  if (caps) {
-    GstCaps* gst_caps = gst_caps_from_string(caps);
-    gst_app_src_set_caps(GST_APP_SRC(appsrc), gst_caps);
-    gst_caps_unref(gst_caps);
-  }
+  if (caps)
+    gst_app_src_set_caps(GST_APP_SRC(appsrc), caps);
 
   g_object_set(appsrc, "block", FALSE, "format", GST_FORMAT_TIME, "stream-type",
                GST_APP_STREAM_TYPE_SEEKABLE, nullptr);
   gst_app_src_set_callbacks(GST_APP_SRC(appsrc), callbacks, user_data, nullptr);
-  if (is_video)
-    gst_app_src_set_max_bytes(GST_APP_SRC(appsrc), 32 * 1024 * 1024);
-  else
-    gst_app_src_set_max_bytes(GST_APP_SRC(appsrc), 8 * 1024 * 1024);
+  gst_app_src_set_max_bytes(
+      GST_APP_SRC(appsrc),
+      GetTunable(is_video ? Tunable::kVideoAppSrcMaxBytes
+                          : Tunable::kAudioAppSrcMaxBytes));
 
   GstCobaltSrc* src = GST_COBALT_SRC(element);
   gchar* name = g_strdup_printf("src_%u", src->priv->pad_number);
@@ -399,6 +412,17 @@ static void gst_cobalt_src_do_async_done(GstCobaltSrc* src) {
   }
 }
 
+// |callback| runs when the source starts waiting for its app srcs in
+// READY_TO_PAUSED. By then uridecodebin has hooked up its pad-added
+// handlers, so the app srcs can be added right away.
+void gst_cobalt_src_set_preroll_callback(GstElement* element,
+                                         GstCobaltSrcPrerollCallback callback,
+                                         gpointer user_data) {
+  GstCobaltSrc* src = GST_COBALT_SRC(element);
+  src->priv->preroll_callback = callback;
+  src->priv->preroll_callback_data = user_data;
+}
+
 void gst_cobalt_src_all_app_srcs_added(GstElement* element) {
   GstCobaltSrc* src = GST_COBALT_SRC(element);
 
@@ -433,8 +457,11 @@ static GstStateChangeReturn gst_cobalt_src_change_state(
 
   switch (transition) {
     case GST_STATE_CHANGE_READY_TO_PAUSED: {
-      if (!priv->async_done)
+      if (!priv->async_done) {
         ret = GST_STATE_CHANGE_ASYNC;
+        if (priv->preroll_callback)
+          priv->preroll_callback(priv->preroll_callback_data);
+      }
       break;
     }
     case GST_STATE_CHANGE_PAUSED_TO_READY: {
@@ -650,13 +677,110 @@ static int CompareColorMetadata(const SbMediaColorMetadata& lhs, const SbMediaCo
   return memcmp(&lhs, &rhs, sizeof(SbMediaColorMetadata));
 }
 
-static void AddVideoInfoToGstCaps(const SbMediaVideoSampleInfo& info, GstCaps* caps) {
-  AddColorMetadataToGstCaps(caps, info.color_metadata);
-  gst_caps_set_simple (caps,
-    "width", G_TYPE_INT, info.frame_width,
-    "height", G_TYPE_INT, info.frame_height,
-    NULL);
-}
+// App src caps, built once per configuration and shared by all players.
+// Adaptive streams change resolution and HDR metadata mid stream; with the
+// cache a change costs a caps copy and two fields, instead of building a
+// caps string, patching it for secure memory and parsing it back.
+class CapsCache {
+ public:
+  // Both return a reference owned by the caller, or null for no codec.
+  // Video caps carry everything but width and height.
+  GstCaps* GetVideoCaps(SbMediaVideoCodec codec,
+                        bool secure,
+                        const SbMediaColorMetadata& color_metadata) {
+    ::starboard::ScopedLock lock(mutex_);
+    for (const VideoEntry& entry : video_) {
+      if (entry.codec == codec && entry.secure == secure &&
+          CompareColorMetadata(entry.color_metadata, color_metadata) == 0) {
+        ++hits_;
+        return gst_caps_ref(entry.caps);
+      }
+    }
+    auto caps_strings = CodecToGstCaps(codec);
+    if (caps_strings.empty())
+      return nullptr;
+    GstCaps* caps = gst_caps_from_string(caps_strings[0].c_str());
+    if (secure) {
+#ifndef USED_SVP_EXT
+      if (codec == kSbMediaVideoCodecH264 || codec == kSbMediaVideoCodecH265 ||
+          codec == kSbMediaVideoCodecVp9 || codec == kSbMediaVideoCodecAv1) {
+        gst_caps_set_features(caps, 0,
+                              gst_caps_features_new("memory:SecMem", nullptr));
+      } else {
+        GST_ERROR("there is  no correct video caps for SecMem\n");
+      }
+#else
+      gst_svp_ext_transform_caps(&caps, TRUE);
+#endif
+    }
+    AddColorMetadataToGstCaps(caps, color_metadata);
+    ++misses_;
+    GST_DEBUG("Cached video caps %" GST_PTR_FORMAT " (%d hits, %d misses)",
+              caps, hits_, misses_);
+    if (video_.size() >= kMaxEntries) {
+      gst_caps_unref(video_.front().caps);
+      video_.pop_front();
+    }
+    video_.push_back({codec, secure, color_metadata, caps});
+    return gst_caps_ref(caps);
+  }
+
+  GstCaps* GetAudioCaps(SbMediaAudioCodec codec,
+                        const SbMediaAudioSampleInfo& info) {
+    std::string config(
+        static_cast<const char*>(info.audio_specific_config),
+        info.audio_specific_config ? info.audio_specific_config_size : 0);
+    ::starboard::ScopedLock lock(mutex_);
+    for (const AudioEntry& entry : audio_) {
+      if (entry.codec == codec &&
+          entry.channels == info.number_of_channels &&
+          entry.samples_per_second == info.samples_per_second &&
+          entry.config == config) {
+        ++hits_;
+        return gst_caps_ref(entry.caps);
+      }
+    }
+    auto caps_strings = CodecToGstCaps(codec, &info);
+    if (caps_strings.empty())
+      return nullptr;
+    GstCaps* caps = gst_caps_from_string(caps_strings[0].c_str());
+    ++misses_;
+    GST_DEBUG("Cached audio caps %" GST_PTR_FORMAT " (%d hits, %d misses)",
+              caps, hits_, misses_);
+    if (audio_.size() >= kMaxEntries) {
+      gst_caps_unref(audio_.front().caps);
+      audio_.pop_front();
+    }
+    audio_.push_back({codec, info.number_of_channels, info.samples_per_second,
+                      std::move(config), caps});
+    return gst_caps_ref(caps);
+  }
+
+ private:
+  struct VideoEntry {
+    SbMediaVideoCodec codec;
+    bool secure;
+    SbMediaColorMetadata color_metadata;
+    GstCaps* caps;
+  };
+
+  struct AudioEntry {
+    SbMediaAudioCodec codec;
+    int channels;
+    int samples_per_second;
+    std::string config;
+    GstCaps* caps;
+  };
+
+  static constexpr size_t kMaxEntries = 8;
+
+  ::starboard::Mutex mutex_;
+  std::deque<VideoEntry> video_;
+  std::deque<AudioEntry> audio_;
+  int hits_{0};
+  int misses_{0};
+};
+SB_ONCE_INITIALIZE_FUNCTION(CapsCache, GetCapsCache);
 
 static void PrintPositionPerSink(GstElement* element)
 {
@@ -863,27 +987,16 @@ class PlayerDestroyedTask : public PlayerStatusTask {
   PlayerDestroyedTask(SbPlayerStatusFunc func,
                       SbPlayer player,
                       int ticket,
-                      void* ctx,
-                      GMainLoop* loop)
-      : PlayerStatusTask(func, player, ticket, ctx, kSbPlayerStateDestroyed) {
-    this->loop_ = loop;
-  }
+                      void* ctx)
+      : PlayerStatusTask(func, player, ticket, ctx, kSbPlayerStateDestroyed) {}
 
   ~PlayerDestroyedTask() override {}
 
-  void Do() override {
-    PlayerStatusTask::Do();
-    g_main_loop_quit(loop_);
-  }
-
   void PrintInfo() override {
     GST_TRACE("PlayerDestroyedTask: START");
     PlayerStatusTask::PrintInfo();
     GST_TRACE("PlayerDestroyedTask: END");
   }
-
- private:
-  GMainLoop* loop_;
 };
 
 class DecoderStatusTask : public Task {
@@ -988,7 +1101,7 @@ class PlayerImpl : public Player, public DrmSystemOcdm::Observer {
   void OnKeyReady(const uint8_t* key, size_t key_len) override;
 
   GstElement* GetPipeline() const { return pipeline_;  }
-  bool IsValid() const { return SbThreadIsValid(playback_thread_); }
+  bool IsValid() const { return main_loop_context_ != nullptr; }
 
  private:
   enum class State {
@@ -1132,9 +1245,17 @@ class PlayerImpl : public Player, public DrmSystemOcdm::Observer {
                                      GstMessage* message,
                                      gpointer user_data);
   static void NeedVideoResourceCallback(void* context);
-  static void* ThreadEntryPoint(void* context);
   static gboolean WorkerTask(gpointer user_data);
   static gboolean FinishSourceSetup(gpointer user_data);
+  static void SourcePrerollStarted(gpointer user_data);
+  static void FirstVideoFrameCallback(GstElement* sink,
+                                      guint size,
+                                      gpointer context,
+                                      gpointer user_data);
+  static GstPadProbeReturn FirstBufferProbe(GstPad* pad,
+                                            GstPadProbeInfo* info,
+                                            gpointer user_data);
+  void InstallFirstFrameWatch();
   static void AppSrcNeedData(GstAppSrc* src, guint length, gpointer user_data);
   static void AppSrcEnoughData(GstAppSrc* src, gpointer user_data);
   static gboolean AppSrcSeekData(GstAppSrc* src,
@@ -1160,6 +1281,8 @@ class PlayerImpl : public Player, public DrmSystemOcdm::Observer {
                    );
   MediaType GetBothMediaTypeTakingCodecsIntoAccount() const;
   void RecordTimestamp(SbMediaType type, SbTime timestamp);
+  void EstimateFrameDuration(SbTime timestamp);
+  void EstimateBitrate(int size, SbTime timestamp);
   SbTime MinTimestamp(MediaType* origin) const;
   SbTime MaxVideoTimeStamps() const;
   SbTime MaxAudioTimeStamps() const;
@@ -1215,7 +1338,7 @@ class PlayerImpl : public Player, public DrmSystemOcdm::Observer {
   void* context_{nullptr};
   SbPlayerOutputMode output_mode_;
   SbDecodeTargetGraphicsContextProvider* provider_{nullptr};
-  GMainLoop* main_loop_{nullptr};
+  // Shared with other media objects, see media::MainLoopPool.
   GMainContext* main_loop_context_{nullptr};
   GstElement* source_{nullptr};
   GstElement* video_appsrc_{nullptr};
@@ -1223,8 +1346,10 @@ class PlayerImpl : public Player, public DrmSystemOcdm::Observer {
   GstElement* pipeline_{nullptr};
   int source_setup_id_{-1};
   int bus_watch_id_{-1};
-  SbThread playback_thread_;
   ::starboard::Mutex mutex_;
+  mutable ::starboard::Mutex dispatch_mutex_;
+  // Set once the destroyed status is queued, later tasks are dropped.
+  bool dispatch_closed_{false};
   ::starboard::Mutex source_setup_mutex_;
   double rate_{1.0};
   double pre_rate_{1.0};// saved rate != .0
@@ -1233,6 +1358,14 @@ class PlayerImpl : public Player, public DrmSystemOcdm::Observer {
   SbTime max_sample_timestamps_[kMediaNumber]{0};
   SbTime min_sample_timestamp_{kSbTimeMax};
   MediaType min_sample_timestamp_origin_{MediaType::kNone};
+  // Spread of the last few video timestamps, see EstimateFrameDuration().
+  int frame_window_count_{0};
+  SbTime frame_window_min_{0};
+  SbTime frame_window_max_{0};
+  // Video bytes over the media time they cover, see EstimateBitrate().
+  int64_t bitrate_window_bytes_{0};
+  SbTime bitrate_window_min_{0};
+  SbTime bitrate_window_max_{0};
   bool is_seek_pending_{false};
   mutable bool is_seeking_{false};
   double pending_rate_{.0};
@@ -1265,6 +1398,29 @@ class PlayerImpl : public Player, public DrmSystemOcdm::Observer {
   HangMonitor hang_monitor_ { "Player" };
   GstCaps* audio_caps_ { nullptr };
   GstCaps* video_caps_ { nullptr };
+  std::unique_ptr<PlayerCapture> capture_;
+  StartupTrace startup_trace_;
+  // Guarded by |source_setup_mutex_|.
+  GstPad* first_frame_pad_{nullptr};
+  gulong first_frame_probe_id_{0};
+
+#if defined(DRM_PATH_STATS)
+  // Encrypted path timings, logged when the player is destroyed. Only in
+  // the mock OCDM build, where they are what's being measured.
+  struct DrmPathStats {
+    int decrypted_samples{0};
+    SbTime decrypt_time{0};
+    SbTime max_decrypt_time{0};
+    int keys_ready{0};
+    SbTime key_to_push_time{0};
+    SbTime max_key_to_push_time{0};
+    int drained_samples{0};
+    uint64_t drained_bytes{0};
+    SbTime drain_time{0};
+  };
+  DrmPathStats drm_stats_;
+  std::map<std::string, SbTimeMonotonic> key_ready_times_;
+#endif  // defined(DRM_PATH_STATS)
 };
 
 struct PlayerRegistry
@@ -1306,6 +1462,299 @@ struct PlayerRegistry
 };
 SB_ONCE_INITIALIZE_FUNCTION(PlayerRegistry, GetPlayerRegistry);
 
+// Drops the last references to torn down pipelines off the thread calling
+// SbPlayerDestroy. By then the pipeline is in NULL, so the decoders are
+// released and nothing left calls back into the player. Finalizing playbin
+// and the sinks still takes a while and the next player need not wait.
+class DeferredReleaser {
+ public:
+  void Release(GstElement* pipeline) {
+    Entry entry{pipeline, SbTimeGetMonotonicNow()};
+    {
+      ::starboard::ScopedLock lock(mutex_);
+      if (!SbThreadIsValid(thread_)) {
+        thread_ = SbThreadCreate(0, kSbThreadPriorityLow, kSbThreadNoAffinity,
+                                 false, "player_reaper",
+                                 &DeferredReleaser::ThreadEntryPoint, this);
+      }
+      if (SbThreadIsValid(thread_)) {
+        entries_.push_back(entry);
+        condition_.Signal();
+        return;
+      }
+    }
+    SB_LOG(WARNING) << "No reaper thread, releasing pipeline inline";
+    Unref(entry);
+  }
+
+ private:
+  struct Entry {
+    GstElement* pipeline;
+    SbTimeMonotonic queued_at;
+  };
+
+  static void* ThreadEntryPoint(void* context) {
+    static_cast<DeferredReleaser*>(context)->Run();
+    return nullptr;
+  }
+
+  void Run() {
+    for (;;) {
+      Entry entry;
+      {
+        ::starboard::ScopedLock lock(mutex_);
+        while (entries_.empty())
+          condition_.Wait();
+        entry = entries_.front();
+        entries_.pop_front();
+      }
+      SbTimeMonotonic start = SbTimeGetMonotonicNow();
+      Unref(entry);
+      SbTimeMonotonic end = SbTimeGetMonotonicNow();
+      GST_INFO("Released pipeline %p in %" PRId64 " us, %" PRId64
+               " us after teardown",
+               entry.pipeline, end - start, end - entry.queued_at);
+    }
+  }
+
+  static void Unref(const Entry& entry) {
+    g_object_unref(entry.pipeline);
+  }
+
+  ::starboard::Mutex mutex_;
+  ::starboard::ConditionVariable condition_{mutex_};
+  std::deque<Entry> entries_;
+  SbThread thread_{kSbThreadInvalid};
+};
+SB_ONCE_INITIALIZE_FUNCTION(DeferredReleaser, GetDeferredReleaser);
+
+// What changes how playbin and its sinks are put together.
+struct PipelineKey {
+  bool pip;
+  bool has_video;
+
+  bool operator==(const PipelineKey& other) const {
+    return pip == other.pip && has_video == other.has_video;
+  }
+};
+
+// Builds a playbin with the platform sinks, still in NULL and not wired to
+// any player.
+GstElement* CreatePipeline(const PipelineKey& key) {
+  GstElementFactory* src_factory = gst_element_factory_find("cobaltsrc");
+  if (!src_factory) {
+    gst_element_register(0, "cobaltsrc", GST_RANK_PRIMARY + 100,
+                         GST_COBALT_TYPE_SRC);
+  } else {
+    gst_object_unref(src_factory);
+  }
+
+  GstElement* pipeline = gst_element_factory_make("playbin", "media_pipeline");
+
+  unsigned flagAudio = getGstPlayFlag("audio");
+  unsigned flagVideo = getGstPlayFlag("video");
+  unsigned flagNativeVideo = getGstPlayFlag("native-video");
+  unsigned flagNativeAudio = 0;
+#if SB_HAS(NATIVE_AUDIO)
+  flagNativeAudio = getGstPlayFlag("native-audio");
+#endif
+  g_object_set(pipeline, "flags",
+               flagAudio | flagVideo | flagNativeVideo | flagNativeAudio,
+               nullptr);
+  g_object_set(pipeline, "uri", "cobalt://", nullptr);
+
+#if 1
+
+  const char* videosink= getenv("COBALT_SET_VIDEOSINK");
+  GstElement* video_sink = NULL;
+  if(videosink && (strstr(videosink, "amlvideosink") != NULL))
+    video_sink = gst_element_factory_make("amlvideosink", NULL);
+  else
+    video_sink = gst_element_factory_make("westerossink", NULL);
+
+  // Set low-memory mode
+  if (g_object_class_find_property(G_OBJECT_GET_CLASS(video_sink), "low-memory")) {
+    if (GetTunable(Tunable::kSupportLowMem))
+      g_object_set(G_OBJECT(video_sink), "low-memory", TRUE, NULL);
+    else
+      g_object_set(G_OBJECT(video_sink), "low-memory", FALSE, NULL);
+  }
+  if (key.pip) {
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(video_sink), "pip")) {
+      g_object_set(G_OBJECT(video_sink), "pip", TRUE, NULL);
+      /* TODO: Do not start audio for the pip window */
+    }
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(video_sink), "res-usage")) {
+      g_object_set(G_OBJECT(video_sink), "res-usage", 0, NULL);
+    }
+  }
+  g_object_set(pipeline, "video-sink", video_sink, NULL);
+#endif
+
+#if 1
+
+  GstElement* audio_sink = gst_element_factory_make("amlhalasink", NULL);
+  if (key.pip) {
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(audio_sink), "direct-mode"))
+      g_object_set(G_OBJECT(audio_sink), "direct-mode", FALSE, NULL);
+  } else {
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(audio_sink), "wait-video"))
+      g_object_set(G_OBJECT(audio_sink), "wait-video", TRUE, NULL);
+    if (g_object_class_find_property(G_OBJECT_GET_CLASS(audio_sink), "a-wait-timeout"))
+    {
+      if (!key.has_video)
+        g_object_set(G_OBJECT(audio_sink), "a-wait-timeout", 200, NULL);
+      else
+        g_object_set(G_OBJECT(audio_sink), "a-wait-timeout", 4000, NULL);
+    }
+
+  }
+  g_object_set(pipeline, "audio-sink", audio_sink, NULL);
+
+#endif
+
+  GstElement* playsink = (gst_bin_get_by_name(GST_BIN(pipeline), "playsink"));
+  if (playsink) {
+    g_object_set(G_OBJECT(playsink), "send-event-mode", 0, nullptr);
+    g_object_unref(playsink);
+  } else {
+    GST_WARNING("No playsink ?!?!?");
+  }
+  return pipeline;
+}
+
+// Keeps one unused pipeline per recently seen configuration, so the next
+// player with that configuration (autoplay, next episode) does not have to
+// build playbin and the sinks. A spare is built on a low priority thread a
+// moment after a player took the previous one, with a pooled main loop
+// context as the thread default, as the player builds its own. The player
+// taking the spare takes that context with it and brings the pipeline to
+// READY there.
+//
+// Spares stay in NULL. In READY westerossink creates its surface and the
+// HAL sink opens its output, which a spare sitting next to a playing
+// pipeline must not do. Used pipelines are not put back either: the sinks
+// keep per session state (window rectangle, volume, underflow state) that
+// no reset clears reliably, so those still go to the reaper.
+class PipelinePool {
+ public:
+  // Returns null if there is no spare for |key|; the caller builds one.
+  // Otherwise |context| is the pooled context the spare was built under,
+  // which the caller releases to MainLoopPool when done.
+  GstElement* Checkout(const PipelineKey& key, GMainContext** context) {
+    ::starboard::ScopedLock lock(mutex_);
+    GstElement* pipeline = nullptr;
+    for (auto it = spares_.begin(); it != spares_.end(); ++it) {
+      if (it->key == key) {
+        pipeline = it->pipeline;
+        *context = it->context;
+        spares_.erase(it);
+        break;
+      }
+    }
+    ++(pipeline ? warm_checkouts_ : cold_checkouts_);
+    GST_INFO("%s pipeline checkout (%d warm, %d cold)",
+             pipeline ? "Warm" : "Cold", warm_checkouts_, cold_checkouts_);
+    ScheduleRefill(key);
+    return pipeline;
+  }
+
+ private:
+  struct Spare {
+    PipelineKey key;
+    GstElement* pipeline;
+    GMainContext* context;
+  };
+
+  struct Refill {
+    PipelineKey key;
+    SbTimeMonotonic due;
+  };
+
+  // Leaves the new player's own startup alone.
+  static constexpr SbTime kRefillDelay = 2 * kSbTimeSecond;
+  static constexpr size_t kMaxSpares = 2;
+
+  void ScheduleRefill(const PipelineKey& key) {
+    if (!SbThreadIsValid(thread_)) {
+      thread_ = SbThreadCreate(0, kSbThreadPriorityLow, kSbThreadNoAffinity,
+                               false, "player_warmer",
+                               &PipelinePool::ThreadEntryPoint, this);
+      if (!SbThreadIsValid(thread_))
+        return;
+    }
+    for (const Refill& refill : refills_) {
+      if (refill.key == key)
+        return;
+    }
+    refills_.push_back({key, SbTimeGetMonotonicNow() + kRefillDelay});
+    condition_.Signal();
+  }
+
+  bool HasSpare(const PipelineKey& key) const {
+    for (const Spare& spare : spares_) {
+      if (spare.key == key)
+        return true;
+    }
+    return false;
+  }
+
+  static void* ThreadEntryPoint(void* context) {
+    static_cast<PipelinePool*>(context)->Run();
+    return nullptr;
+  }
+
+  void Run() {
+    ::starboard::ScopedLock lock(mutex_);
+    for (;;) {
+      if (refills_.empty()) {
+        condition_.Wait();
+        continue;
+      }
+      SbTimeMonotonic now = SbTimeGetMonotonicNow();
+      if (refills_.front().due > now) {
+        condition_.WaitTimed(refills_.front().due - now);
+        continue;
+      }
+      PipelineKey key = refills_.front().key;
+      refills_.pop_front();
+      if (HasSpare(key))
+        continue;
+
+      Spare evicted{key, nullptr, nullptr};
+      if (spares_.size() >= kMaxSpares) {
+        evicted = spares_.front();
+        spares_.pop_front();
+      }
+      mutex_.Release();
+      if (evicted.pipeline) {
+        g_object_unref(evicted.pipeline);
+        MainLoopPool::Get()->Release(evicted.context);
+      }
+      SbTimeMonotonic start = SbTimeGetMonotonicNow();
+      GMainContext* context = MainLoopPool::Get()->Acquire(
+          MainLoopPool::Priority::kRealTime, "Player");
+      g_main_context_push_thread_default(context);
+      GstElement* pipeline = CreatePipeline(key);
+      g_main_context_pop_thread_default(context);
+      GST_INFO("Warmed %s%s pipeline %p in %" PRId64 " us",
+               key.pip ? "pip " : "", key.has_video ? "a/v" : "audio only",
+               pipeline, SbTimeGetMonotonicNow() - start);
+      mutex_.Acquire();
+      spares_.push_back({key, pipeline, context});
+    }
+  }
+
+  ::starboard::Mutex mutex_;
+  ::starboard::ConditionVariable condition_{mutex_};
+  std::deque<Spare> spares_;
+  std::deque<Refill> refills_;
+  SbThread thread_{kSbThreadInvalid};
+  int warm_checkouts_{0};
+  int cold_checkouts_{0};
+};
+SB_ONCE_INITIALIZE_FUNCTION(PipelinePool, GetPipelinePool);
+
 PlayerImpl::PlayerImpl(SbPlayer player,
                        SbWindow window,
                        SbMediaVideoCodec video_codec,
@@ -1336,31 +1785,53 @@ PlayerImpl::PlayerImpl(SbPlayer player,
       decoder_status_func_(decoder_status_func),
       player_status_func_(player_status_func),
       player_error_func_(player_error_func),
-      context_(context) {
+      context_(context),
+      startup_trace_(video_codec, audio_codec,
+                     drm_system != kSbDrmSystemInvalid) {
 
   if (audio_codec_ == kSbMediaAudioCodecNone)
     has_enough_data_ &= ~static_cast<int>(MediaType::kAudio);
   if (video_codec_ == kSbMediaVideoCodecNone)
     has_enough_data_ &= ~static_cast<int>(MediaType::kVideo);
 
-  if (audio_codec_ != kSbMediaAudioCodecNone) {
-    auto caps = CodecToGstCaps(audio_codec_, &audio_sample_info_);
-    if (!caps.empty() && caps[0].c_str()) {
-      GstCaps* gst_caps = gst_caps_from_string(caps[0].c_str());
-      gst_caps_replace(&audio_caps_, gst_caps);
-      gst_caps_unref(gst_caps);
+  capture_ = PlayerCapture::Create(video_codec_, audio_codec_,
+                                   drm_system_ != nullptr, audio_sample_info_,
+                                   max_video_capabilities_);
+
+  if (audio_codec_ != kSbMediaAudioCodecNone)
+    audio_caps_ = GetCapsCache()->GetAudioCaps(audio_codec_, audio_sample_info_);
+
+  // Ahead of the pipeline checkout, which logs.
+  GST_DEBUG_CATEGORY_INIT(cobalt_gst_player_debug, "gstplayer", 0,
+                          "Cobalt player");
+
+  //width=432; height=240; framerate=15; it's for PIP
+  bool use_pip = false;
+  if (max_video_capabilities_ && strlen(max_video_capabilities_) > 30) {
+    int cap_w = 0, cap_h = 0, cap_fr = 0;
+    sscanf(max_video_capabilities_, "width=%d; height=%d; framerate=%d;",
+        &cap_w, &cap_h, &cap_fr);
+    if (cap_w == 432 && cap_h == 240 && cap_fr == 15) {
+      use_pip = true;
     }
   }
 
-  main_loop_context_ = g_main_context_new ();
+  // A spare comes with the context it was built under, which is then ours.
+  const PipelineKey key{use_pip, video_codec_ != kSbMediaVideoCodecNone};
+  pipeline_ = GetPipelinePool()->Checkout(key, &main_loop_context_);
+  const bool warm = pipeline_ != nullptr;
+  if (!main_loop_context_) {
+    main_loop_context_ = MainLoopPool::Get()->Acquire(
+        MainLoopPool::Priority::kRealTime, "Player");
+  }
   g_main_context_push_thread_default(main_loop_context_);
-  main_loop_ = g_main_loop_new(main_loop_context_, FALSE);
 
   GSource* src = g_timeout_source_new(hang_monitor_.GetResetInterval() / kSbTimeMillisecond);
   g_source_set_callback(src, [] (gpointer data) ->gboolean {
     PlayerImpl& player = *static_cast<PlayerImpl*>(data);
     GstState state, pending;
-    GstStateChangeReturn result = gst_element_get_state(player.pipeline_, &state, &pending, GST_CLOCK_TIME_NONE);
+    // Never wait here, the loop is shared with other players.
+    GstStateChangeReturn result = gst_element_get_state(player.pipeline_, &state, &pending, 0);
     gint64 position = player.GetPosition();
     GST_INFO("Player state: %s (pending: %s, result: %s), position: %" GST_TIME_FORMAT "",
              gst_element_state_get_name(state),
@@ -1394,107 +1865,21 @@ PlayerImpl::PlayerImpl(SbPlayer player,
 #endif
   }
 
-  GST_DEBUG_CATEGORY_INIT(cobalt_gst_player_debug, "gstplayer", 0,
-                          "Cobalt player");
-
   GST_INFO("Creating player with max capabilities: %s",
            max_video_capabilities_);
   GST_WARNING("Player_Status pid = %d, PlayerImpl init start, v=%d,a=%d",
       SbThreadGetId(), video_codec, audio_codec);
-  //width=432; height=240; framerate=15; it's for PIP
-  bool use_pip = false;
-  if (max_video_capabilities_ && strlen(max_video_capabilities_) > 30) {
-    int cap_w = 0, cap_h = 0, cap_fr = 0;
-    sscanf(max_video_capabilities_, "width=%d; height=%d; framerate=%d;",
-        &cap_w, &cap_h, &cap_fr);
-    if (cap_w == 432 && cap_h == 240 && cap_fr == 15) {
-      use_pip = true;
-    }
-  }
-
-
-  GstElementFactory* src_factory = gst_element_factory_find("cobaltsrc");
-  if (!src_factory) {
-    gst_element_register(0, "cobaltsrc", GST_RANK_PRIMARY + 100,
-                         GST_COBALT_TYPE_SRC);
-  } else {
-    gst_object_unref(src_factory);
-  }
-
-  pipeline_ = gst_element_factory_make("playbin", "media_pipeline");
-
-  unsigned flagAudio = getGstPlayFlag("audio");
-  unsigned flagVideo = getGstPlayFlag("video");
-  unsigned flagNativeVideo = getGstPlayFlag("native-video");
-  unsigned flagNativeAudio = 0;
-#if SB_HAS(NATIVE_AUDIO)
-  flagNativeAudio = getGstPlayFlag("native-audio");
-#endif
-  g_object_set(pipeline_, "flags",
-               flagAudio | flagVideo | flagNativeVideo | flagNativeAudio,
-               nullptr);
+  SbTimeMonotonic build_start = SbTimeGetMonotonicNow();
+  if (!pipeline_)
+    pipeline_ = CreatePipeline(key);
+  startup_trace_.SetWarmPipeline(warm);
+  startup_trace_.Mark(StartupMilestone::kPipelineBuilt);
+  GST_INFO("%s pipeline %p ready in %" PRId64 " us", warm ? "Warm" : "New",
+           pipeline_, SbTimeGetMonotonicNow() - build_start);
   g_signal_connect(pipeline_, "source-setup",
                    G_CALLBACK(&PlayerImpl::SetupSource), this);
-  g_object_set(pipeline_, "uri", "cobalt://", nullptr);
-
-#if 1
-
-  const char* videosink= getenv("COBALT_SET_VIDEOSINK");
-  GstElement* video_sink = NULL;
-  if(videosink && (strstr(videosink, "amlvideosink") != NULL))
-    video_sink = gst_element_factory_make("amlvideosink", NULL);
-  else
-    video_sink = gst_element_factory_make("westerossink", NULL);
-
-  // Set low-memory mode
-  if (g_object_class_find_property(G_OBJECT_GET_CLASS(video_sink), "low-memory")) {
-    bool bsupport_lowmem = false;
-    const char* support_lowmem= getenv("COBALT_SUPPORT_LOWMEM");
-    if (support_lowmem) {
-      if ((strncmp(support_lowmem, "y", 1) == 0)||(strncmp(support_lowmem, "Y", 1) == 0))
-      {
-        bsupport_lowmem = true;
-      }
-    }
-    if (bsupport_lowmem)
-      g_object_set(G_OBJECT(video_sink), "low-memory", TRUE, NULL);
-    else
-      g_object_set(G_OBJECT(video_sink), "low-memory", FALSE, NULL);
-  }
-  if (use_pip) {
-    if (g_object_class_find_property(G_OBJECT_GET_CLASS(video_sink), "pip")) {
-      g_object_set(G_OBJECT(video_sink), "pip", TRUE, NULL);
-      /* TODO: Do not start audio for the pip window */
-    }
-    if (g_object_class_find_property(G_OBJECT_GET_CLASS(video_sink), "res-usage")) {
-      g_object_set(G_OBJECT(video_sink), "res-usage", 0, NULL);
-    }
-  }
-  g_object_set(pipeline_, "video-sink", video_sink, NULL);
-#endif
-
-#if 1
-
-  GstElement* audio_sink = gst_element_factory_make("amlhalasink", NULL);
-  if (use_pip) {
-    if (g_object_class_find_property(G_OBJECT_GET_CLASS(audio_sink), "direct-mode"))
-      g_object_set(G_OBJECT(audio_sink), "direct-mode", FALSE, NULL);
-  } else {
-    if (g_object_class_find_property(G_OBJECT_GET_CLASS(audio_sink), "wait-video"))
-      g_object_set(G_OBJECT(audio_sink), "wait-video", TRUE, NULL);
-    if (g_object_class_find_property(G_OBJECT_GET_CLASS(audio_sink), "a-wait-timeout"))
-    {
-      if (video_codec_ == kSbMediaVideoCodecNone)
-        g_object_set(G_OBJECT(audio_sink), "a-wait-timeout", 200, NULL);
-      else
-        g_object_set(G_OBJECT(audio_sink), "a-wait-timeout", 4000, NULL);
-    }
-
-  }
-  g_object_set(pipeline_, "audio-sink", audio_sink, NULL);
-
-#endif
   installUnderflowCallbackFromPlatform(pipeline_, GCallback(videoUnderFlowCallback), GCallback(audioUnderFlowCallback), this);
+  InstallFirstFrameWatch();
 
 
   GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
@@ -1504,32 +1889,43 @@ PlayerImpl::PlayerImpl(SbPlayer player,
   video_appsrc_ = gst_element_factory_make("appsrc", "vidsrc");
   audio_appsrc_ = gst_element_factory_make("appsrc", "audsrc");
 
-  GstElement* playsink = (gst_bin_get_by_name(GST_BIN(pipeline_), "playsink"));
-  if (playsink) {
-    g_object_set(G_OBJECT(playsink), "send-event-mode", 0, nullptr);
-    g_object_unref(playsink);
-  } else {
-    GST_WARNING("No playsink ?!?!?");
-  }
   ChangePipelineState(GST_STATE_READY);
+  startup_trace_.Mark(StartupMilestone::kReady);
   g_main_context_pop_thread_default(main_loop_context_);
 
-  playback_thread_ =
-      SbThreadCreate(0, kSbThreadPriorityRealTime, kSbThreadNoAffinity, true,
-                     "playback_thread", &PlayerImpl::ThreadEntryPoint, this);
-  SB_DCHECK(SbThreadIsValid(playback_thread_));
+  SB_DCHECK(main_loop_context_);
+  state_ = State::kInitial;
+  GST_WARNING("Player_Status:pid %d Update kSbPlayerStateInitialized", SbThreadGetId());
+  DispatchOnWorkerThread(new PlayerStatusTask(
+      player_status_func_, player_, ticket_, context_,
+      kSbPlayerStateInitialized));
   GST_WARNING("Player_Status pid = %d, PlayerImpl init done", SbThreadGetId());
-  if (SbThreadIsValid(playback_thread_)) {
-    while(!g_main_loop_is_running(main_loop_))
-      g_usleep(1);
-  }
   GetPlayerRegistry()->Add(this);
+  if (video_codec_ != kSbMediaVideoCodecNone)
+    BufferBudget::Get()->AddPlayer(this, video_codec_);
 }
 
 PlayerImpl::~PlayerImpl() {
+  SbTimeMonotonic teardown_start = SbTimeGetMonotonicNow();
   GetPlayerRegistry()->Remove(this);
+  FramePacer::Get()->Remove(this);
+  BufferBudget::Get()->Remove(this);
 
   GST_DEBUG_OBJECT(pipeline_, "Destroying player");
+#if defined(DRM_PATH_STATS)
+  if (drm_stats_.decrypted_samples > 0) {
+    const auto& stats = drm_stats_;
+    SB_LOG(INFO) << "DRM path: decrypted " << stats.decrypted_samples
+                 << " samples, avg " << stats.decrypt_time / stats.decrypted_samples
+                 << " us, max " << stats.max_decrypt_time
+                 << " us; key to first push avg "
+                 << (stats.keys_ready ? stats.key_to_push_time / stats.keys_ready : 0)
+                 << " us, max " << stats.max_key_to_push_time
+                 << " us over " << stats.keys_ready << " keys; drained "
+                 << stats.drained_samples << " pending samples ("
+                 << stats.drained_bytes << " bytes) in " << stats.drain_time << " us";
+  }
+#endif  // defined(DRM_PATH_STATS)
   CancelNeedVideoResEvent();
   {
     ::starboard::ScopedLock lock(source_setup_mutex_);
@@ -1537,6 +1933,12 @@ PlayerImpl::~PlayerImpl() {
       GSource* src = g_main_context_find_source_by_id(main_loop_context_, source_setup_id_);
       g_source_destroy(src);
     }
+    if (first_frame_pad_) {
+      if (first_frame_probe_id_)
+        gst_pad_remove_probe(first_frame_pad_, first_frame_probe_id_);
+      gst_object_unref(first_frame_pad_);
+      first_frame_pad_ = nullptr;
+    }
   }
   if (bus_watch_id_ > -1) {
     GSource* src = g_main_context_find_source_by_id(main_loop_context_, bus_watch_id_);
@@ -1546,24 +1948,43 @@ PlayerImpl::~PlayerImpl() {
     GSource* src = g_main_context_find_source_by_id(main_loop_context_, hang_monitor_source_id_);
     g_source_destroy(src);
   }
+  SbTimeMonotonic null_start = SbTimeGetMonotonicNow();
   ChangePipelineState(GST_STATE_NULL);
+  SbTimeMonotonic null_done = SbTimeGetMonotonicNow();
   GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
   gst_bus_set_sync_handler(bus, nullptr, nullptr, nullptr);
   gst_object_unref(bus);
-  if (SbThreadIsValid(playback_thread_)) {
+  if (main_loop_context_) {
     DispatchOnWorkerThread(new PlayerDestroyedTask(
-      player_status_func_, player_, ticket_, context_, main_loop_));
-    SbThreadJoin(playback_thread_, nullptr);
+      player_status_func_, player_, ticket_, context_));
+    {
+      ::starboard::ScopedLock lock(dispatch_mutex_);
+      dispatch_closed_ = true;
+    }
+    MainLoopPool::Fence(main_loop_context_);
   }
+  SbTimeMonotonic fence_done = SbTimeGetMonotonicNow();
   if (audio_caps_) {
     gst_caps_unref(audio_caps_);
   }
   if (video_caps_) {
     gst_caps_unref(video_caps_);
   }
-  g_main_loop_unref(main_loop_);
-  g_main_context_unref(main_loop_context_);
-  g_object_unref(pipeline_);
+  // Nothing may call back into |this| once the pipeline is handed off.
+  g_signal_handlers_disconnect_by_data(pipeline_, this);
+  GstElement* sinks[2] = {nullptr, nullptr};
+  g_object_get(pipeline_, "audio-sink", &sinks[0], "video-sink", &sinks[1],
+               nullptr);
+  for (GstElement* sink : sinks) {
+    if (sink) {
+      g_signal_handlers_disconnect_by_data(sink, this);
+      gst_object_unref(sink);
+    }
+  }
+  GetDeferredReleaser()->Release(pipeline_);
+  pipeline_ = nullptr;
+  MainLoopPool::Get()->Release(main_loop_context_);
+  main_loop_context_ = nullptr;
   if (drm_system_)
     drm_system_->RemoveObserver(this);
 #ifndef USED_SVP_EXT
@@ -1575,6 +1996,10 @@ PlayerImpl::~PlayerImpl() {
     gst_svp_context_ = nullptr;
   }
 #endif
+  SbTimeMonotonic teardown_done = SbTimeGetMonotonicNow();
+  SB_LOG(INFO) << "Player teardown took " << teardown_done - teardown_start
+               << " us (NULL state " << null_done - null_start
+               << " us, loop fence " << fence_done - null_done << " us)";
   GST_WARNING("Player_Status pid = %d, PlayerImpl exit done", SbThreadGetId());
 }
 
@@ -1642,6 +2067,12 @@ gboolean PlayerImpl::BusMessageCallback(GstBus* bus,
         GstState old_state, new_state, pending;
         gst_message_parse_state_changed(message, &old_state, &new_state,
                                         &pending);
+        const SbTimeMonotonic posted_at =
+            GST_MESSAGE_TIMESTAMP(message) / kSbTimeNanosecondsPerMicrosecond;
+        if (new_state == GST_STATE_PAUSED)
+          self->startup_trace_.Mark(StartupMilestone::kPaused, posted_at);
+        else if (new_state == GST_STATE_PLAYING)
+          self->startup_trace_.Mark(StartupMilestone::kPlaying, posted_at);
         GST_WARNING_OBJECT(GST_MESSAGE_SRC(message),
                         "Player_Status ===> State changed (old: %s, new: %s, pending: %s)",
                         gst_element_state_get_name(old_state),
@@ -1708,6 +2139,9 @@ gboolean PlayerImpl::BusMessageCallback(GstBus* bus,
 
     case GST_MESSAGE_ASYNC_DONE: {
       if (GST_MESSAGE_SRC(message) == GST_OBJECT(self->pipeline_)) {
+        self->startup_trace_.Mark(
+            StartupMilestone::kAsyncDone,
+            GST_MESSAGE_TIMESTAMP(message) / kSbTimeNanosecondsPerMicrosecond);
         GST_WARNING("Player_Status: ===> ASYNC-DONE %s %d",
                  gst_element_state_get_name(GST_STATE(self->pipeline_)),
                  static_cast<int>(self->state_));
@@ -1849,26 +2283,14 @@ gboolean PlayerImpl::BusMessageCallback(GstBus* bus,
   return TRUE;
 }
 
-// static
-void* PlayerImpl::ThreadEntryPoint(void* context) {
-  SB_DCHECK(context);
-  GST_TRACE("%d", SbThreadGetId());
-
-  PlayerImpl* self = reinterpret_cast<PlayerImpl*>(context);
-  self->state_ = State::kInitial;
-
-  g_main_context_push_thread_default(self->main_loop_context_);
-  GST_WARNING("Player_Status:pid %d Update kSbPlayerStateInitialized", SbThreadGetId());
-
-  self->DispatchOnWorkerThread(new PlayerStatusTask(
-      self->player_status_func_, self->player_, self->ticket_, self->context_,
-      kSbPlayerStateInitialized));
-  g_main_loop_run(self->main_loop_);
-
-  return nullptr;
-}
-
 void PlayerImpl::DispatchOnWorkerThread(Task* task) const {
+  {
+    ::starboard::ScopedLock lock(dispatch_mutex_);
+    if (dispatch_closed_) {
+      delete task;
+      return;
+    }
+  }
   GSource* src = g_source_new(&SourceFunctions, sizeof(GSource));
   g_source_set_ready_time(src, 0);
   DispatchData* data = new DispatchData(task, src);
@@ -1897,10 +2319,9 @@ gboolean PlayerImpl::FinishSourceSetup(gpointer user_data) {
   GstAppSrcCallbacks callbacks = {&PlayerImpl::AppSrcNeedData,
                                   &PlayerImpl::AppSrcEnoughData,
                                   &PlayerImpl::AppSrcSeekData, nullptr};
-  auto caps = CodecToGstCaps(self->audio_codec_, &self->audio_sample_info_);
   if (self->audio_codec_ != kSbMediaAudioCodecNone) {
     gst_cobalt_src_setup_and_add_app_src(
-        source, self->audio_appsrc_, !caps.empty() ? caps[0].c_str() : nullptr,
+        source, self->audio_appsrc_, self->audio_caps_,
         &callbacks, self, false);
   }
   if (self->video_codec_ != kSbMediaVideoCodecNone) {
@@ -1910,6 +2331,9 @@ gboolean PlayerImpl::FinishSourceSetup(gpointer user_data) {
   }
   gst_cobalt_src_all_app_srcs_added(self->source_);
   self->source_setup_id_ = -1;
+  self->startup_trace_.Mark(StartupMilestone::kAppSrcsAdded);
+  if (self->video_codec_ == kSbMediaVideoCodecNone)
+    self->startup_trace_.Mark(StartupMilestone::kCapsSet);
 
   return FALSE;
 }
@@ -1921,6 +2345,7 @@ void PlayerImpl::AppSrcNeedData(GstAppSrc* src,
   PlayerImpl* self = static_cast<PlayerImpl*>(user_data);
 
   GST_LOG_OBJECT(src, "===> Gimme more data");
+  self->startup_trace_.Mark(StartupMilestone::kFirstNeedData);
 
   ::starboard::ScopedLock lock(self->mutex_);
   int need_data = static_cast<int>(MediaType::kNone);
@@ -1989,14 +2414,75 @@ void PlayerImpl::SetupSource(GstElement* pipeline,
   ::starboard::ScopedLock lock(self->source_setup_mutex_);
   SB_DCHECK(!self->source_);
   self->source_ = source;
-  static constexpr int kAsyncSourceFinishTimeMs = 50;
-  GSource* src = g_timeout_source_new(kAsyncSourceFinishTimeMs);
+  self->startup_trace_.Mark(StartupMilestone::kSourceSetup);
+  // uridecodebin connects to the source's pads only after this signal
+  // returns, the app srcs are added once the source starts prerolling.
+  gst_cobalt_src_set_preroll_callback(
+      source, &PlayerImpl::SourcePrerollStarted, self);
+}
+
+// static
+void PlayerImpl::SourcePrerollStarted(gpointer user_data) {
+  PlayerImpl* self = static_cast<PlayerImpl*>(user_data);
+  ::starboard::ScopedLock lock(self->source_setup_mutex_);
+  if (self->source_setup_id_ > -1 || self->force_stop_)
+    return;
+  GSource* src = g_idle_source_new();
+  g_source_set_priority(src, G_PRIORITY_DEFAULT);
   g_source_set_callback(src, &PlayerImpl::FinishSourceSetup, self, nullptr);
   self->source_setup_id_ = g_source_attach(src, self->main_loop_context_);
   g_source_unref(src);
 }
 
+void PlayerImpl::InstallFirstFrameWatch() {
+  const bool has_video = video_codec_ != kSbMediaVideoCodecNone;
+  GstElement* sink = nullptr;
+  g_object_get(pipeline_, has_video ? "video-sink" : "audio-sink", &sink,
+               nullptr);
+  if (!sink)
+    return;
+  if (has_video &&
+      g_signal_lookup("first-video-frame-callback", G_OBJECT_TYPE(sink))) {
+    g_signal_connect(sink, "first-video-frame-callback",
+                     G_CALLBACK(&PlayerImpl::FirstVideoFrameCallback), this);
+  } else {
+    // Sinks without a rendered frame notification, take the first buffer
+    // they get instead.
+    ::starboard::ScopedLock lock(source_setup_mutex_);
+    first_frame_pad_ = gst_element_get_static_pad(sink, "sink");
+    if (first_frame_pad_) {
+      first_frame_probe_id_ = gst_pad_add_probe(
+          first_frame_pad_, GST_PAD_PROBE_TYPE_BUFFER,
+          &PlayerImpl::FirstBufferProbe, this, nullptr);
+    }
+  }
+  gst_object_unref(sink);
+}
+
+// static
+void PlayerImpl::FirstVideoFrameCallback(GstElement* sink,
+                                         guint size,
+                                         gpointer context,
+                                         gpointer user_data) {
+  PlayerImpl* self = static_cast<PlayerImpl*>(user_data);
+  self->startup_trace_.Mark(StartupMilestone::kFirstFrame);
+}
+
+// static
+GstPadProbeReturn PlayerImpl::FirstBufferProbe(GstPad* pad,
+                                               GstPadProbeInfo* info,
+                                               gpointer user_data) {
+  PlayerImpl* self = static_cast<PlayerImpl*>(user_data);
+  self->startup_trace_.Mark(StartupMilestone::kFirstFrame);
+  ::starboard::ScopedLock lock(self->source_setup_mutex_);
+  self->first_frame_probe_id_ = 0;
+  return GST_PAD_PROBE_REMOVE;
+}
+
 void PlayerImpl::MarkEOS(SbMediaType stream_type) {
+  if (capture_)
+    capture_->OnEndOfStream(stream_type);
+
   GstElement* src = nullptr;
   if (stream_type == kSbMediaTypeVideo) {
     src = video_appsrc_;
@@ -2072,7 +2558,8 @@ bool PlayerImpl::WriteSample(SbMediaType sample_type,
     gst_buffer_add_protection_meta(buffer, drm_info);
     //if (gst_secmem_get_free_buf_num(mem) < 10)
     //  enough_buffer = FALSE;
-    if  (gst_secmem_get_free_buf_size(mem) < (4*1024*1024) || gst_secmem_get_free_buf_num(mem) < 5)
+    if  (gst_secmem_get_free_buf_size(mem) < GetTunable(Tunable::kSecMemMinFreeBytes) ||
+         gst_secmem_get_free_buf_num(mem) < GetTunable(Tunable::kSecMemMinFreeBuffers))
       enough_buffer = FALSE;
   }
 #endif
@@ -2092,8 +2579,20 @@ bool PlayerImpl::WriteSample(SbMediaType sample_type,
     if (sample_type == kSbMediaTypeVideo) {
       drm_system_->SetVideoResolution(session_id, frame_width_, frame_height_);
     }
+#if defined(DRM_PATH_STATS)
+    SbTimeMonotonic decrypt_start = SbTimeGetMonotonicNow();
+#endif
     decrypted = drm_system_->Decrypt(session_id, buffer, subsample,
                                      subsample_count, iv, key, caps, encryption_scheme, encryption_pattern);
+#if defined(DRM_PATH_STATS)
+    SbTime decrypt_time = SbTimeGetMonotonicNow() - decrypt_start;
+    {
+      ::starboard::ScopedLock lock(mutex_);
+      ++drm_stats_.decrypted_samples;
+      drm_stats_.decrypt_time += decrypt_time;
+      drm_stats_.max_decrypt_time = std::max(drm_stats_.max_decrypt_time, decrypt_time);
+    }
+#endif
     if (!decrypted) {
       GST_ERROR_OBJECT(src, "Failed decrypting");
 #ifndef USED_SVP_EXT
@@ -2198,6 +2697,12 @@ void PlayerImpl::WriteSample(SbMediaType sample_type,
                 "Adjust impl. to handle more samples after changing samples"
                 "count");
   SB_DCHECK(number_of_sample_infos == kMaxNumberOfSamplesPerWrite);
+  if (capture_)
+    capture_->OnWriteSample(sample_infos[0]);
+  startup_trace_.Mark(StartupMilestone::kFirstSample);
+  if (sample_type == kSbMediaTypeVideo)
+    EstimateBitrate(sample_infos[0].buffer_size, sample_infos[0].timestamp);
+
   GstBuffer* buffer =
       gst_buffer_new_allocate(nullptr, sample_infos[0].buffer_size, nullptr);
   gst_buffer_fill(buffer, 0, sample_infos[0].buffer,
@@ -2225,7 +2730,6 @@ void PlayerImpl::WriteSample(SbMediaType sample_type,
       frame_width_ = info.frame_width;
       frame_height_ = info.frame_height;
       color_metadata_ = info.color_metadata;
-      auto caps = CodecToGstCaps(video_codec_);
 
       // Check supported max video resolution
       {
@@ -2240,33 +2744,22 @@ void PlayerImpl::WriteSample(SbMediaType sample_type,
         }
       }
 
-      if (!caps.empty()) {
 #ifndef USED_SVP_EXT
-        if (drm_system_ && allocator_) {
-          /* add (memory:SecMem) property */
-          if (caps[0].find("video/x-h264") == 0) {
-            caps[0].replace(0, strlen("video/x-h264"), "video/x-h264(memory:SecMem)");
-          } else if (caps[0].find("video/x-h265") == 0) {
-            caps[0].replace(0, strlen("video/x-h265"), "video/x-h265(memory:SecMem)");
-          } else if (caps[0].find("video/x-vp9") == 0) {
-            caps[0].replace(0, strlen("video/x-vp9"), "video/x-vp9(memory:SecMem)");
-          } else if (caps[0].find("video/x-av1") == 0) {
-            caps[0].replace(0, strlen("video/x-av1"), "video/x-av1(memory:SecMem)");
-          } else {
-            GST_ERROR("there is  no correct video caps for SecMem\n");
-            //return FALSE;
-          }
-        }
-        GstCaps* gst_caps = gst_caps_from_string(caps[0].c_str());
+      const bool secure = drm_system_ && allocator_;
 #else
-        GstCaps* gst_caps = gst_caps_from_string(caps[0].c_str());
-
-        if (drm_system_ && gst_svp_context_)
-          gst_svp_ext_transform_caps(&gst_caps, gst_svp_context_ != nullptr);
-        GST_DEBUG("caps %s", gst_caps_to_string(gst_caps));
+      const bool secure = drm_system_ && gst_svp_context_;
 #endif
-        AddVideoInfoToGstCaps(info, gst_caps);
+      GstCaps* gst_caps = GetCapsCache()->GetVideoCaps(
+          video_codec_, secure, color_metadata_);
+      if (gst_caps) {
+        gst_caps = gst_caps_make_writable(gst_caps);
+        gst_caps_set_simple(gst_caps,
+                            "width", G_TYPE_INT, info.frame_width,
+                            "height", G_TYPE_INT, info.frame_height,
+                            nullptr);
+        GST_DEBUG("caps %" GST_PTR_FORMAT, gst_caps);
         gst_app_src_set_caps(GST_APP_SRC(video_appsrc_), gst_caps);
+        startup_trace_.Mark(StartupMilestone::kCapsSet);
         gst_caps_replace(&video_caps_, gst_caps);
         gst_caps_unref(gst_caps);
       }
@@ -2444,6 +2937,8 @@ void PlayerImpl::WriteSample(SbMediaType sample_type,
 
 void PlayerImpl::SetVolume(double volume) {
   SB_LOG(INFO) << "Change volume to " << volume;
+  if (capture_)
+    capture_->OnSetVolume(volume);
   if (audio_codec_ == kSbMediaAudioCodecNone)
     return;
   ::starboard::ScopedLock lock(mutex_);
@@ -2462,6 +2957,8 @@ void PlayerImpl::SetVolume(double volume) {
 }
 
 void PlayerImpl::Seek(SbTime seek_to_timestamp, int ticket,bool save) {
+  if (save && capture_)
+    capture_->OnSeek(seek_to_timestamp, ticket);
 
   GST_WARNING_OBJECT(pipeline_, "Player_Status: ===> time %" PRId64 " TID: %d state %d  pipeline:%s",
                    seek_to_timestamp, SbThreadGetId(), static_cast<int>(state_),
@@ -2547,6 +3044,10 @@ void PlayerImpl::Seek(SbTime seek_to_timestamp, int ticket,bool save) {
 }
 
 bool PlayerImpl::SetRate(double rate,bool bsave) {
+  if (bsave && capture_)
+    capture_->OnSetRate(rate);
+  if (video_codec_ != kSbMediaVideoCodecNone)
+    FramePacer::Get()->SetVideoPlaying(this, rate == 1.);
   GST_WARNING_OBJECT(pipeline_, "Player_Status ===> rate %lf (rate_ %lf), TID: %d", rate, rate_,
                    SbThreadGetId());
   bool success = true;
@@ -2673,9 +3174,9 @@ bool PlayerImpl::SetRate(double rate,bool bsave) {
 #define CHECK_BUFFER_INTERVAL \
     (100*kSbTimeNanosecondsPerMicrosecond*kSbTimeMillisecond) // 100ms
 #define MIN_VIDEO_BUFFER_TIME \
-    (250*kSbTimeNanosecondsPerMicrosecond*kSbTimeMillisecond) // 250ms
+    (GetTunable(Tunable::kMinVideoBufferTime)*kSbTimeNanosecondsPerMicrosecond*kSbTimeMillisecond)
 #define MIN_AUDIO_BUFFER_TIME \
-    (250*kSbTimeNanosecondsPerMicrosecond*kSbTimeMillisecond) // 250 ms
+    (GetTunable(Tunable::kMinAudioBufferTime)*kSbTimeNanosecondsPerMicrosecond*kSbTimeMillisecond)
 
 #define FIRSTTIME_BUFFER_TIME \
     (500*kSbTimeNanosecondsPerMicrosecond*kSbTimeMillisecond) // 150 ms
@@ -2994,6 +3495,11 @@ void PlayerImpl::OnKeyReady(const uint8_t* key, size_t key_len) {
   {
     ::starboard::ScopedLock lock(mutex_);
     has_oob_write_pending_ = true;
+#if defined(DRM_PATH_STATS)
+    key_ready_times_.emplace(
+        std::string(reinterpret_cast<const char*>(key), key_len),
+        SbTimeGetMonotonicNow());
+#endif
   }
 
   GstBuffer* kid_buf = gst_buffer_new_allocate(nullptr, key_len, nullptr);
@@ -3021,7 +3527,24 @@ void PlayerImpl::WritePendingSamples(const uint8_t* key, size_t key_len) {
     }
   }
 
+#if defined(DRM_PATH_STATS)
+  SbTimeMonotonic key_ready_time = 0;
+  {
+    ::starboard::ScopedLock lock(mutex_);
+    auto ready = key_ready_times_.find(key_str);
+    if (ready != key_ready_times_.end()) {
+      key_ready_time = ready->second;
+      key_ready_times_.erase(ready);
+    }
+  }
+#endif
+
   if (!local_samples.empty()) {
+#if defined(DRM_PATH_STATS)
+    SbTimeMonotonic drain_start = SbTimeGetMonotonicNow();
+    int drained_samples = 0;
+    uint64_t drained_bytes = 0;
+#endif
     std::string session_id;
     if (drm_system_) {
       session_id = drm_system_->SessionIdByKeyId(key, key_len);
@@ -3046,14 +3569,36 @@ void PlayerImpl::WritePendingSamples(const uint8_t* key, size_t key_len) {
         continue;
       }
       prev_ts = GST_BUFFER_TIMESTAMP(sample.Buffer());
+#if defined(DRM_PATH_STATS)
+      size_t sample_size = gst_buffer_get_size(sample.Buffer());
+#endif
       if (WriteSample(sample.Type(), sample.Buffer(), session_id,
                       sample.Subsamples(), sample.SubsamplesCount(),
                       sample.Iv(), sample.Key(), sample.SerialID(), sample.EncryptionScheme(), sample.EncryptionPattern())) {
         GST_INFO("Pending sample was written.");
         sample.Written();
+#if defined(DRM_PATH_STATS)
+        if (drained_samples++ == 0 && key_ready_time) {
+          SbTime key_to_push = SbTimeGetMonotonicNow() - key_ready_time;
+          ::starboard::ScopedLock lock(mutex_);
+          ++drm_stats_.keys_ready;
+          drm_stats_.key_to_push_time += key_to_push;
+          drm_stats_.max_key_to_push_time = std::max(drm_stats_.max_key_to_push_time, key_to_push);
+        }
+        drained_bytes += sample_size;
+#endif
       }
     }
 
+#if defined(DRM_PATH_STATS)
+    {
+      ::starboard::ScopedLock lock(mutex_);
+      drm_stats_.drained_samples += drained_samples;
+      drm_stats_.drained_bytes += drained_bytes;
+      drm_stats_.drain_time += SbTimeGetMonotonicNow() - drain_start;
+    }
+#endif
+
     if (keep_samples) {
       {
         ::starboard::ScopedLock lock(mutex_);
@@ -3089,6 +3634,8 @@ MediaType PlayerImpl::GetBothMediaTypeTakingCodecsIntoAccount() const {
 
 void PlayerImpl::RecordTimestamp(SbMediaType type, SbTime timestamp) {
   if (type == kSbMediaTypeVideo) {
+    if (timestamp != kSbTimeMax)
+      EstimateFrameDuration(timestamp);
     max_sample_timestamps_[kVideoIndex] =
         std::max(max_sample_timestamps_[kVideoIndex], timestamp);
   } else if (type == kSbMediaTypeAudio) {
@@ -3112,6 +3659,59 @@ void PlayerImpl::RecordTimestamp(SbMediaType type, SbTime timestamp) {
   }
 }
 
+// Samples arrive in decode order, but the timestamps of a run of them still
+// span as many frames. Windows across a seek come out of range and are
+// dropped. |timestamp| is in nanoseconds like the rest of the bookkeeping.
+void PlayerImpl::EstimateFrameDuration(SbTime timestamp) {
+  const int kWindow = 32;
+  const SbTime kMinDuration = 8 * kSbTimeMillisecond;
+  const SbTime kMaxDuration = 100 * kSbTimeMillisecond;
+
+  timestamp /= kSbTimeNanosecondsPerMicrosecond;
+  if (frame_window_count_++ == 0) {
+    frame_window_min_ = frame_window_max_ = timestamp;
+    return;
+  }
+  frame_window_min_ = std::min(frame_window_min_, timestamp);
+  frame_window_max_ = std::max(frame_window_max_, timestamp);
+  if (frame_window_count_ < kWindow)
+    return;
+
+  frame_window_count_ = 0;
+  SbTime duration = (frame_window_max_ - frame_window_min_) / (kWindow - 1);
+  if (duration < kMinDuration || duration > kMaxDuration)
+    return;
+  // Millisecond timestamps jitter the estimate, half a millisecond steps
+  // tell 23.976 from 25 fps and keep it stable.
+  duration = (duration + 250) / 500 * 500;
+  FramePacer::Get()->SetVideoFrameDuration(this, duration);
+}
+
+// Averaged over 10 s of media time, in decode order like the frame
+// duration. A timestamp far outside the window is a seek and restarts it.
+void PlayerImpl::EstimateBitrate(int size, SbTime timestamp) {
+  const SbTime kWindow = 10 * kSbTimeSecond;
+  const SbTime kMaxJump = 2 * kSbTimeSecond;
+
+  if (bitrate_window_bytes_ == 0 ||
+      timestamp < bitrate_window_min_ - kMaxJump ||
+      timestamp > bitrate_window_max_ + kMaxJump) {
+    bitrate_window_bytes_ = size;
+    bitrate_window_min_ = bitrate_window_max_ = timestamp;
+    return;
+  }
+  bitrate_window_bytes_ += size;
+  bitrate_window_min_ = std::min(bitrate_window_min_, timestamp);
+  bitrate_window_max_ = std::max(bitrate_window_max_, timestamp);
+  SbTime span = bitrate_window_max_ - bitrate_window_min_;
+  if (span < kWindow)
+    return;
+
+  BufferBudget::Get()->SetVideoBitrate(
+      this, bitrate_window_bytes_ * 8 * kSbTimeSecond / span);
+  bitrate_window_bytes_ = 0;
+}
+
 SbTime PlayerImpl::MinTimestamp(MediaType* origin) const {
   if (origin)
     *origin = min_sample_timestamp_origin_;
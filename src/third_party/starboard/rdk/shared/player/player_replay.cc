@@ -0,0 +1,358 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#include "third_party/starboard/rdk/shared/player/player_replay.h"
+
+#include <string.h>
+
+#include "starboard/common/condition_variable.h"
+#include "starboard/common/mutex.h"
+#include "starboard/player.h"
+#include "third_party/starboard/rdk/shared/player/player_capture.h"
+
+#include "third_party/starboard/rdk/shared/log_override.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace player {
+
+namespace {
+
+const SbTime kNeedsDataTimeout = 10 * kSbTimeSecond;
+const SbTime kEndOfStreamTimeout = 30 * kSbTimeSecond;
+
+class ReplaySession {
+ public:
+  ReplaySession(const PlayerCaptureReader& reader, bool max_speed)
+      : reader_(reader), max_speed_(max_speed) {}
+
+  bool Run(SbDrmSystem drm_system, PlayerReplayStats* stats);
+
+ private:
+  static void DeallocateSample(SbPlayer, void*, const void*) {
+    // Samples point into the mapped capture file.
+  }
+
+  static void DecoderStatus(SbPlayer, void* context, SbMediaType type,
+                            SbPlayerDecoderState state, int ticket) {
+    ReplaySession* self = static_cast<ReplaySession*>(context);
+    ::starboard::ScopedLock lock(self->mutex_);
+    if (ticket != self->ticket_ || state != kSbPlayerDecoderStateNeedsData)
+      return;
+    self->needs_data_[type == kSbMediaTypeVideo ? 1 : 0] = true;
+    self->condition_.Broadcast();
+  }
+
+  static void PlayerStatus(SbPlayer, void* context, SbPlayerState state,
+                           int ticket) {
+    ReplaySession* self = static_cast<ReplaySession*>(context);
+    ::starboard::ScopedLock lock(self->mutex_);
+    if (ticket != self->ticket_)
+      return;
+    if (state == kSbPlayerStatePresenting &&
+        self->first_presenting_ == kSbTimeMax) {
+      self->first_presenting_ = SbTimeGetMonotonicNow();
+    } else if (state == kSbPlayerStateEndOfStream) {
+      self->end_of_stream_ = true;
+    }
+    self->condition_.Broadcast();
+  }
+
+  static void PlayerError(SbPlayer, void* context, SbPlayerError error,
+                          const char* message) {
+    ReplaySession* self = static_cast<ReplaySession*>(context);
+    SB_LOG(ERROR) << "Replay player error " << error << ": "
+                  << (message ? message : "");
+    ::starboard::ScopedLock lock(self->mutex_);
+    self->error_ = true;
+    self->condition_.Broadcast();
+  }
+
+  bool WaitForNeedsData(SbMediaType type, PlayerReplayStats* stats);
+  void WaitUntil(SbTimeMonotonic deadline);
+  void WriteSample(SbPlayer player, const CaptureSampleRecord* sample,
+                   PlayerReplayStats* stats);
+
+  const PlayerCaptureReader& reader_;
+  const bool max_speed_;
+
+  ::starboard::Mutex mutex_;
+  ::starboard::ConditionVariable condition_{mutex_};
+  int ticket_{SB_PLAYER_INITIAL_TICKET};
+  bool needs_data_[2]{false, false};
+  bool end_of_stream_{false};
+  bool error_{false};
+  SbTimeMonotonic first_presenting_{kSbTimeMax};
+};
+
+bool ReplaySession::WaitForNeedsData(SbMediaType type,
+                                     PlayerReplayStats* stats) {
+  const int index = type == kSbMediaTypeVideo ? 1 : 0;
+  SbTimeMonotonic start = SbTimeGetMonotonicNow();
+  SbTimeMonotonic deadline = start + kNeedsDataTimeout;
+  ::starboard::ScopedLock lock(mutex_);
+  while (!needs_data_[index] && !error_) {
+    SbTimeMonotonic now = SbTimeGetMonotonicNow();
+    if (now >= deadline) {
+      SB_LOG(ERROR) << "Replay timed out waiting for "
+                    << (index ? "video" : "audio") << " data request";
+      return false;
+    }
+    condition_.WaitTimed(deadline - now);
+  }
+  needs_data_[index] = false;
+  stats->needs_data_wait_time += SbTimeGetMonotonicNow() - start;
+  return !error_;
+}
+
+void ReplaySession::WaitUntil(SbTimeMonotonic deadline) {
+  ::starboard::ScopedLock lock(mutex_);
+  for (SbTimeMonotonic now = SbTimeGetMonotonicNow();
+       now < deadline && !error_; now = SbTimeGetMonotonicNow()) {
+    condition_.WaitTimed(deadline - now);
+  }
+}
+
+void ReplaySession::WriteSample(SbPlayer player,
+                                const CaptureSampleRecord* sample,
+                                PlayerReplayStats* stats) {
+  const SbMediaType type = static_cast<SbMediaType>(sample->media_type);
+
+  SbDrmSampleInfo drm_info;
+  SbPlayerSampleInfo info;
+  memset(&info, 0, sizeof(info));
+  info.type = type;
+  info.buffer = PlayerCaptureReader::Payload(sample);
+  info.buffer_size = sample->buffer_size;
+  info.timestamp = sample->timestamp;
+  if (type == kSbMediaTypeVideo) {
+    info.video_sample_info.codec =
+        static_cast<SbMediaVideoCodec>(reader_.Header().video_codec);
+    info.video_sample_info.is_key_frame = sample->is_key_frame != 0;
+    info.video_sample_info.frame_width = sample->frame_width;
+    info.video_sample_info.frame_height = sample->frame_height;
+    info.video_sample_info.color_metadata = sample->color_metadata;
+  }
+  if (sample->has_drm_info) {
+    memset(&drm_info, 0, sizeof(drm_info));
+    drm_info.encryption_scheme =
+        static_cast<SbDrmEncryptionScheme>(sample->encryption_scheme);
+    drm_info.encryption_pattern.crypt_byte_block = sample->crypt_byte_block;
+    drm_info.encryption_pattern.skip_byte_block = sample->skip_byte_block;
+    memcpy(drm_info.initialization_vector, sample->initialization_vector,
+           sample->initialization_vector_size);
+    drm_info.initialization_vector_size = sample->initialization_vector_size;
+    memcpy(drm_info.identifier, sample->identifier, sample->identifier_size);
+    drm_info.identifier_size = sample->identifier_size;
+    drm_info.subsample_count = sample->subsample_count;
+    drm_info.subsample_mapping = PlayerCaptureReader::SubsampleMapping(sample);
+    info.drm_info = &drm_info;
+  }
+
+  SbPlayerWriteSample2(player, type, &info, 1);
+
+  if (type == kSbMediaTypeVideo)
+    ++stats->video_samples;
+  else
+    ++stats->audio_samples;
+  stats->bytes += sample->buffer_size;
+}
+
+bool ReplaySession::Run(SbDrmSystem drm_system, PlayerReplayStats* stats) {
+  const CaptureFileHeader& header = reader_.Header();
+
+  SbPlayerCreationParam creation_param;
+  memset(&creation_param, 0, sizeof(creation_param));
+  creation_param.drm_system = drm_system;
+  creation_param.output_mode = kSbPlayerOutputModePunchOut;
+
+  SbMediaAudioSampleInfo& audio = creation_param.audio_sample_info;
+  audio.codec = static_cast<SbMediaAudioCodec>(header.audio_codec);
+  audio.format_tag = header.audio_format_tag;
+  audio.number_of_channels = header.audio_number_of_channels;
+  audio.samples_per_second = header.audio_samples_per_second;
+  audio.average_bytes_per_second = header.audio_average_bytes_per_second;
+  audio.block_alignment = header.audio_block_alignment;
+  audio.bits_per_sample = header.audio_bits_per_sample;
+  audio.audio_specific_config_size = header.audio_specific_config_size;
+  audio.audio_specific_config = reader_.AudioSpecificConfig();
+
+  SbMediaVideoSampleInfo& video = creation_param.video_sample_info;
+  video.codec = static_cast<SbMediaVideoCodec>(header.video_codec);
+  video.max_video_capabilities = reader_.MaxVideoCapabilities();
+#if SB_API_VERSION >= 12
+  audio.mime = "";
+  video.mime = "";
+  if (!video.max_video_capabilities)
+    video.max_video_capabilities = "";
+#endif
+
+  SbPlayer player = SbPlayerCreate(
+      kSbWindowInvalid, &creation_param, &ReplaySession::DeallocateSample,
+      &ReplaySession::DecoderStatus, &ReplaySession::PlayerStatus,
+      &ReplaySession::PlayerError, this, nullptr);
+  if (!SbPlayerIsValid(player)) {
+    SB_LOG(ERROR) << "Replay failed to create player";
+    return false;
+  }
+
+  bool seen_eos[2] = {false, false};
+  bool ok = true;
+  const SbTimeMonotonic start = SbTimeGetMonotonicNow();
+  size_t offset = 0;
+  PlayerCaptureReader::Record record;
+  while (ok && reader_.Next(&offset, &record)) {
+    if (!max_speed_)
+      WaitUntil(start + record.header->time);
+
+    switch (record.header->type) {
+      case kCaptureRecordSample: {
+        auto* sample = static_cast<const CaptureSampleRecord*>(record.body);
+        ok = WaitForNeedsData(static_cast<SbMediaType>(sample->media_type),
+                              stats);
+        if (ok)
+          WriteSample(player, sample, stats);
+        break;
+      }
+      case kCaptureRecordSeek: {
+        auto* seek = static_cast<const CaptureSeekRecord*>(record.body);
+        {
+          ::starboard::ScopedLock lock(mutex_);
+          ticket_ = seek->ticket;
+          needs_data_[0] = needs_data_[1] = false;
+          end_of_stream_ = false;
+          seen_eos[0] = seen_eos[1] = false;
+        }
+        SbPlayerSeek2(player, seek->seek_to_timestamp, seek->ticket);
+        ++stats->seeks;
+        break;
+      }
+      case kCaptureRecordSetRate: {
+        auto* rate = static_cast<const CaptureSetRateRecord*>(record.body);
+        SbPlayerSetPlaybackRate(player, rate->rate);
+        ++stats->rate_changes;
+        break;
+      }
+      case kCaptureRecordSetVolume: {
+        auto* volume = static_cast<const CaptureSetVolumeRecord*>(record.body);
+        SbPlayerSetVolume(player, volume->volume);
+        break;
+      }
+      case kCaptureRecordEndOfStream: {
+        auto* eos = static_cast<const CaptureEndOfStreamRecord*>(record.body);
+        SbMediaType type = static_cast<SbMediaType>(eos->media_type);
+        seen_eos[type == kSbMediaTypeVideo ? 1 : 0] = true;
+        SbPlayerWriteEndOfStream(player, type);
+        break;
+      }
+      default:
+        SB_LOG(WARNING) << "Skipping unknown capture record "
+                        << record.header->type;
+        break;
+    }
+  }
+
+  // Sessions captured mid-playback have no end of stream, finish them here
+  // so the pipeline drains what was written.
+  if (ok) {
+    if (header.audio_codec != kSbMediaAudioCodecNone && !seen_eos[0])
+      SbPlayerWriteEndOfStream(player, kSbMediaTypeAudio);
+    if (header.video_codec != kSbMediaVideoCodecNone && !seen_eos[1])
+      SbPlayerWriteEndOfStream(player, kSbMediaTypeVideo);
+
+    ::starboard::ScopedLock lock(mutex_);
+    SbTimeMonotonic deadline = SbTimeGetMonotonicNow() + kEndOfStreamTimeout;
+    for (SbTimeMonotonic now = SbTimeGetMonotonicNow();
+         !end_of_stream_ && !error_ && now < deadline;
+         now = SbTimeGetMonotonicNow()) {
+      condition_.WaitTimed(deadline - now);
+    }
+  }
+
+  SbPlayerDestroy(player);
+
+  ::starboard::ScopedLock lock(mutex_);
+  stats->wall_time = SbTimeGetMonotonicNow() - start;
+  if (first_presenting_ != kSbTimeMax)
+    stats->time_to_first_presenting = first_presenting_ - start;
+  stats->reached_end_of_stream = end_of_stream_;
+  stats->had_error = error_;
+  return ok && !error_;
+}
+
+// The header says whether the player had a DRM system, a sample carrying
+// DRM info needs one as well.
+bool NeedsDrmSystem(const PlayerCaptureReader& reader) {
+  if (reader.Header().has_drm_system)
+    return true;
+  size_t offset = 0;
+  PlayerCaptureReader::Record record;
+  while (reader.Next(&offset, &record)) {
+    if (record.header->type == kCaptureRecordSample &&
+        static_cast<const CaptureSampleRecord*>(record.body)->has_drm_info)
+      return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool IsEncryptedCapture(const char* path) {
+  PlayerCaptureReader reader;
+  return path && reader.Open(path) && NeedsDrmSystem(reader);
+}
+
+bool ReplayPlayerCapture(const char* path,
+                         bool max_speed,
+                         SbDrmSystem drm_system,
+                         PlayerReplayStats* out_stats) {
+  PlayerCaptureReader reader;
+  if (!path || !reader.Open(path))
+    return false;
+
+  if (!SbDrmSystemIsValid(drm_system) && NeedsDrmSystem(reader)) {
+    SB_LOG(ERROR) << "Capture '" << path
+                  << "' holds encrypted samples, replay needs a DRM system";
+    return false;
+  }
+
+  PlayerReplayStats stats;
+  ReplaySession session(reader, max_speed);
+  bool result = session.Run(drm_system, &stats);
+
+  SB_LOG(INFO) << "Replay of '" << path << "' "
+               << (result ? "finished" : "failed")
+               << (max_speed ? " (max speed)" : " (original speed)")
+               << ": video samples " << stats.video_samples
+               << ", audio samples " << stats.audio_samples
+               << ", bytes " << stats.bytes
+               << ", seeks " << stats.seeks
+               << ", time to presenting " << stats.time_to_first_presenting
+               << " us, needs data wait " << stats.needs_data_wait_time
+               << " us, wall time " << stats.wall_time << " us";
+
+  if (out_stats)
+    *out_stats = stats;
+  return result;
+}
+
+}  // namespace player
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,66 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_PLAYER_REPLAY_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_PLAYER_REPLAY_H_
+
+#include <stdint.h>
+
+#include "starboard/drm.h"
+#include "starboard/time.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace player {
+
+struct PlayerReplayStats {
+  int video_samples{0};
+  int audio_samples{0};
+  uint64_t bytes{0};
+  int seeks{0};
+  int rate_changes{0};
+  // Time spent blocked until the player asked for more data.
+  SbTime needs_data_wait_time{0};
+  SbTime time_to_first_presenting{-1};
+  SbTime wall_time{0};
+  bool reached_end_of_stream{false};
+  bool had_error{false};
+};
+
+// Whether replaying |path| needs a DRM system. Captures keep neither the key
+// system nor the licenses, so the caller has to bring one that already
+// holds the keys.
+bool IsEncryptedCapture(const char* path);
+
+// Feeds a file written by PlayerCapture back through the SbPlayer API.
+// With |max_speed| samples are written as soon as the player asks for
+// data, otherwise the original call timeline is reproduced. Encrypted
+// captures need a |drm_system| holding the keys used during capture.
+// Blocks the calling thread until the replay finishes.
+bool ReplayPlayerCapture(const char* path,
+                         bool max_speed,
+                         SbDrmSystem drm_system,
+                         PlayerReplayStats* out_stats);
+
+}  // namespace player
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_PLAYER_REPLAY_H_
@@ -0,0 +1,143 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/player/player_startup_trace.h"
+
+#include <deque>
+#include <sstream>
+
+#include "starboard/common/log.h"
+#include "starboard/once.h"
+
+#include "third_party/starboard/rdk/shared/log_override.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace player {
+namespace {
+
+const size_t kMaxSessions = 16;
+const int kMilestoneCount = static_cast<int>(StartupMilestone::kCount);
+
+const char* const kMilestoneNames[kMilestoneCount] = {
+    "create",        "pipeline_built",  "ready",        "source_setup",
+    "appsrcs_added", "first_need_data", "first_sample", "caps_set",
+    "paused",        "async_done",      "playing",      "first_frame",
+};
+
+struct StartupHistory {
+  ::starboard::Mutex mutex;
+  int next_session{0};
+  std::deque<std::string> sessions;
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(StartupHistory, GetStartupHistory);
+
+}  // namespace
+
+StartupTrace::StartupTrace(SbMediaVideoCodec video_codec,
+                           SbMediaAudioCodec audio_codec,
+                           bool has_drm_system)
+    : session_([] {
+        StartupHistory* history = GetStartupHistory();
+        ::starboard::ScopedLock lock(history->mutex);
+        return history->next_session++;
+      }()),
+      video_codec_(video_codec),
+      audio_codec_(audio_codec),
+      has_drm_system_(has_drm_system) {
+  times_[static_cast<int>(StartupMilestone::kCreate)] =
+      SbTimeGetMonotonicNow();
+}
+
+StartupTrace::~StartupTrace() {
+  ::starboard::ScopedLock lock(mutex_);
+  if (!published_)
+    PublishLocked();
+}
+
+void StartupTrace::Mark(StartupMilestone milestone, SbTimeMonotonic time) {
+  ::starboard::ScopedLock lock(mutex_);
+  SbTimeMonotonic& slot = times_[static_cast<int>(milestone)];
+  if (slot || published_)
+    return;
+  slot = time;
+  if (milestone == StartupMilestone::kFirstFrame)
+    PublishLocked();
+}
+
+void StartupTrace::SetWarmPipeline(bool warm) {
+  ::starboard::ScopedLock lock(mutex_);
+  warm_pipeline_ = warm;
+}
+
+void StartupTrace::PublishLocked() {
+  published_ = true;
+  const SbTimeMonotonic start =
+      times_[static_cast<int>(StartupMilestone::kCreate)];
+  const bool complete =
+      times_[static_cast<int>(StartupMilestone::kFirstFrame)] != 0;
+
+  std::ostringstream json;
+  std::ostringstream summary;
+  json << "{\"session\":" << session_ << ",\"video_codec\":" << video_codec_
+       << ",\"audio_codec\":" << audio_codec_ << ",\"drm\":"
+       << (has_drm_system_ ? "true" : "false") << ",\"warm\":"
+       << (warm_pipeline_ ? "true" : "false") << ",\"complete\":"
+       << (complete ? "true" : "false") << ",\"milestones\":{";
+  bool first = true;
+  for (int i = 1; i < kMilestoneCount; ++i) {
+    if (!times_[i])
+      continue;
+    json << (first ? "" : ",") << '"' << kMilestoneNames[i]
+         << "\":" << times_[i] - start;
+    summary << ' ' << kMilestoneNames[i] << '=' << times_[i] - start;
+    first = false;
+  }
+  json << "}}";
+
+  SB_LOG(INFO) << "Player startup " << session_
+               << (complete ? "" : " (no first frame)") << ":"
+               << summary.str();
+
+  StartupHistory* history = GetStartupHistory();
+  ::starboard::ScopedLock lock(history->mutex);
+  history->sessions.push_back(json.str());
+  while (history->sessions.size() > kMaxSessions)
+    history->sessions.pop_front();
+}
+
+std::string GetStartupTraces() {
+  StartupHistory* history = GetStartupHistory();
+  ::starboard::ScopedLock lock(history->mutex);
+  std::string result = "[";
+  for (size_t i = 0; i < history->sessions.size(); ++i) {
+    if (i)
+      result += ",";
+    result += history->sessions[i];
+  }
+  result += "]";
+  return result;
+}
+
+}  // namespace player
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
@@ -0,0 +1,91 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_PLAYER_STARTUP_TRACE_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_PLAYER_STARTUP_TRACE_H_
+
+#include <string>
+
+#include "starboard/common/mutex.h"
+#include "starboard/media.h"
+#include "starboard/time.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace player {
+
+// Milestones of a player start, in the order they are expected to happen.
+enum class StartupMilestone {
+  kCreate,
+  kPipelineBuilt,
+  kReady,
+  kSourceSetup,
+  kAppSrcsAdded,
+  kFirstNeedData,
+  kFirstSample,
+  kCapsSet,
+  kPaused,
+  kAsyncDone,
+  kPlaying,
+  kFirstFrame,
+  kCount,
+};
+
+// Timestamps the start of one SbPlayer session, from SbPlayerCreate to the
+// first frame reaching the video sink (audio sink for audio only players).
+// Only the first occurrence of a milestone is kept. The trace is published
+// to a short history when the first frame is seen or, incomplete, when the
+// player goes away; GetStartupTraces() returns that history as JSON.
+class StartupTrace {
+ public:
+  StartupTrace(SbMediaVideoCodec video_codec,
+               SbMediaAudioCodec audio_codec,
+               bool has_drm_system);
+  ~StartupTrace();
+
+  // |time| is for events that carry their own timestamp, bus messages.
+  void Mark(StartupMilestone milestone,
+            SbTimeMonotonic time = SbTimeGetMonotonicNow());
+  void SetWarmPipeline(bool warm);
+
+ private:
+  void PublishLocked();
+
+  ::starboard::Mutex mutex_;
+  const int session_;
+  const SbMediaVideoCodec video_codec_;
+  const SbMediaAudioCodec audio_codec_;
+  const bool has_drm_system_;
+  bool warm_pipeline_{false};
+  bool published_{false};
+  SbTimeMonotonic times_[static_cast<int>(StartupMilestone::kCount)]{};
+};
+
+// The most recent sessions, oldest first, times in microseconds since
+// kCreate:
+//   [{"session":3,"video_codec":2,"audio_codec":1,"drm":true,"warm":true,
+//     "complete":true,"milestones":{"pipeline_built":812,...}}, ...]
+std::string GetStartupTraces();
+
+}  // namespace player
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_PLAYER_PLAYER_STARTUP_TRACE_H_
@@ -17,8 +17,17 @@
 
 #include "third_party/starboard/rdk/shared/rdkservices.h"
 
+#include <string.h>
+
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include <websocket/JSONRPCLink.h>
 
@@ -35,13 +44,17 @@
 #include "starboard/common/mutex.h"
 #include "starboard/common/string.h"
 #include "starboard/event.h"
+#include "starboard/media.h"
 #include "starboard/once.h"
+#include "starboard/thread.h"
+#include "starboard/time.h"
 
 #include "third_party/starboard/rdk/shared/application_rdk.h"
+#include "third_party/starboard/rdk/shared/device_properties.h"
+#include "third_party/starboard/rdk/shared/latency_histogram.h"
+#include "third_party/starboard/rdk/shared/media/media_support_cache.h"
 #include "third_party/starboard/rdk/shared/log_override.h"
 
-#include "aml_device_property.h"
-
 using namespace WPEFramework;
 
 namespace third_party {
@@ -60,12 +73,288 @@ const char kTTSCallsign[] = "org.rdk.TextToSpeech.1";
 const char kHdcpProfileCallsign[] = "org.rdk.HdcpProfile.1";
 const char kRDKShellCallsign[] = "org.rdk.RDKShell.1";
 const char kVoiceInputCallsign[] = "org.rdk.VoiceInput.1";
+// Control interface of tools/thunder_mock.py, absent on real devices.
+const char kThunderMockCallsign[] = "ThunderMock.1";
 
 const uint32_t kPriviligedRequestErrorCode = -32604U;
 
+const SbTime kLatencyBuckets[] = {1 * kSbTimeMillisecond,
+                                  5 * kSbTimeMillisecond,
+                                  20 * kSbTimeMillisecond,
+                                  100 * kSbTimeMillisecond};
+
+// Method name link setup is accounted under, a pooled callsign should show
+// one per (re)connection no matter how many requests went out.
+const char kLinkSetupMethod[] = "<link>";
+
+// A pooled link that failed is not recreated sooner than this.
+const SbTime kReconnectDelay = 500 * kSbTimeMillisecond;
+
+// Round trip accounting for every request that goes out over a ServiceLink,
+// keyed by "callsign.method".
+class ServiceCallStats {
+public:
+  struct Entry {
+    uint32_t count{0};
+    uint32_t failures{0};
+    uint32_t timeouts{0};
+    SbTime total{0};
+    SbTime max{0};
+    LatencyHistogram histogram{kLatencyBuckets};
+  };
+
+  void Record(const std::string &callsign, const std::string &method,
+              SbTime elapsed, uint32_t rc) {
+    ::starboard::ScopedLock lock(mutex_);
+    Entry &entry = entries_[callsign + "." + method];
+    ++entry.count;
+    if (rc == Core::ERROR_TIMEDOUT)
+      ++entry.timeouts;
+    else if (rc != Core::ERROR_NONE)
+      ++entry.failures;
+    entry.total += elapsed;
+    entry.max = std::max(entry.max, elapsed);
+    entry.histogram.Add(elapsed);
+  }
+
+  std::map<std::string, Entry> Snapshot() {
+    ::starboard::ScopedLock lock(mutex_);
+    return entries_;
+  }
+
+  void Reset() {
+    ::starboard::ScopedLock lock(mutex_);
+    entries_.clear();
+  }
+
+private:
+  ::starboard::Mutex mutex_;
+  std::map<std::string, Entry> entries_;
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(ServiceCallStats, GetServiceCallStats);
+
+using LinkType = JSONRPC::LinkType<Core::JSON::IElement>;
+
+// One persistent link per callsign for plain requests, so they don't pay a
+// WebSocket connect each. A link that reports a lost connection is dropped
+// and the next request opens a new one. Links that subscribe to events stay
+// private to their ServiceLink, handlers are registered per link.
+class ServiceLinkPool {
+public:
+  // Opening a link is a round trip to Thunder, so it happens outside the
+  // lock. Callers wanting the same callsign meanwhile wait for the result,
+  // other callsigns aren't held up.
+  std::shared_ptr<LinkType> Acquire(const std::string &callsign,
+                                    const std::string &query) {
+    {
+      ::starboard::ScopedLock lock(mutex_);
+      // Slots are never erased, the reference survives the waits.
+      Slot &slot = slots_[callsign];
+      while (slot.connecting)
+        connected_.Wait();
+      if (slot.link)
+        return slot.link;
+      SbTimeMonotonic now = SbTimeGetMonotonicNow();
+      if (slot.dropped_at && now - slot.dropped_at < kReconnectDelay)
+        return nullptr;
+      slot.connecting = true;
+    }
+
+    SbTimeMonotonic start = SbTimeGetMonotonicNow();
+    std::shared_ptr<LinkType> link(
+        new LinkType(callsign, nullptr, false, query));
+    SbTime elapsed = SbTimeGetMonotonicNow() - start;
+    GetServiceCallStats()->Record(callsign, kLinkSetupMethod, elapsed,
+                                  Core::ERROR_NONE);
+
+    ::starboard::ScopedLock lock(mutex_);
+    Slot &slot = slots_[callsign];
+    slot.link = link;
+    slot.connecting = false;
+    connected_.Broadcast();
+    SB_LOG(INFO) << "Opened pooled link to '" << callsign << "' in "
+                 << elapsed << " us (" << ++slot.opened << " opened)";
+    return link;
+  }
+
+  void Drop(const std::string &callsign,
+            const std::shared_ptr<LinkType> &link) {
+    ::starboard::ScopedLock lock(mutex_);
+    Slot &slot = slots_[callsign];
+    if (slot.link != link)
+      return;
+    SB_LOG(WARNING) << "Dropping pooled link to '" << callsign << "'";
+    // Requests in flight keep their reference, the link goes with the last.
+    slot.link.reset();
+    slot.dropped_at = SbTimeGetMonotonicNow();
+  }
+
+private:
+  struct Slot {
+    std::shared_ptr<LinkType> link;
+    // A caller is opening the link, with |mutex_| released.
+    bool connecting{false};
+    SbTimeMonotonic dropped_at{0};
+    uint32_t opened{0};
+  };
+
+  ::starboard::Mutex mutex_;
+  ::starboard::ConditionVariable connected_{mutex_};
+  std::map<std::string, Slot> slots_;
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(ServiceLinkPool, GetServiceLinkPool);
+
+// Runs requests issued with ServiceLink::InvokeAsync() one after another on
+// a thread of its own, so the caller doesn't wait for the reply. Tasks are
+// tagged with an owner that can cancel them before it goes away.
+class ServiceDispatcher {
+public:
+  ServiceDispatcher() {
+    // Lives as long as the process, like the other Thunder clients.
+    thread_ = SbThreadCreate(0, kSbThreadPriorityNormal, kSbThreadNoAffinity,
+                             false, "rdk_rpc", &ThreadEntryPoint, this);
+  }
+
+  bool Post(const void *owner, std::function<void()> task) {
+    if (!SbThreadIsValid(thread_))
+      return false;
+    ::starboard::ScopedLock lock(mutex_);
+    tasks_.push_back({owner, std::move(task)});
+    condition_.Signal();
+    return true;
+  }
+
+  // Drops the queued tasks of |owner| and waits for its running one.
+  void Cancel(const void *owner) {
+    ::starboard::ScopedLock lock(mutex_);
+    tasks_.erase(std::remove_if(tasks_.begin(), tasks_.end(),
+                                [owner](const Task &task) {
+                                  return task.owner == owner;
+                                }),
+                 tasks_.end());
+    while (running_owner_ == owner)
+      condition_.Wait();
+  }
+
+private:
+  struct Task {
+    const void *owner;
+    std::function<void()> run;
+  };
+
+  static void *ThreadEntryPoint(void *context) {
+    static_cast<ServiceDispatcher *>(context)->Run();
+    return nullptr;
+  }
+
+  void Run() {
+    ::starboard::ScopedLock lock(mutex_);
+    for (;;) {
+      while (tasks_.empty())
+        condition_.Wait();
+      Task task = std::move(tasks_.front());
+      tasks_.pop_front();
+      running_owner_ = task.owner;
+      mutex_.Release();
+      task.run();
+      mutex_.Acquire();
+      running_owner_ = nullptr;
+      // Wakes Cancel() as well as nothing else waits while tasks are queued.
+      condition_.Broadcast();
+    }
+  }
+
+  ::starboard::Mutex mutex_;
+  ::starboard::ConditionVariable condition_{mutex_};
+  std::deque<Task> tasks_;
+  const void *running_owner_{nullptr};
+  SbThread thread_{kSbThreadInvalid};
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(ServiceDispatcher, GetServiceDispatcher);
+
+enum class NetworkInterface { kUnknown, kWifi, kEthernet };
+
+// What the Thunder services last told us. Trivially copyable, so readers can
+// take a copy under the sequence counter below.
+struct ServiceSnapshot {
+  // Bumped by every update.
+  uint32_t version;
+
+  // DisplayInfo and PlayerInfo, valid once |display_known|.
+  bool display_known;
+  uint32_t resolution_width;
+  uint32_t resolution_height;
+  bool has_hdr;
+  float diagonal_size_in_inches;
+
+  // org.rdk.Network.
+  bool wifi_connected;
+  bool eth_connected;
+  NetworkInterface default_interface;
+
+  // org.rdk.RDKShell.
+  bool focused;
+  char focused_app[64];
+
+  // org.rdk.HdcpProfile.
+  bool hdmi_connected;
+};
+
+// Single copy of the service state, written from Thunder event handlers and
+// the dispatcher thread, read by Starboard calls without taking a lock or
+// waiting on IPC. Writers are serialized by a mutex and publish through a
+// sequence counter; a reader retries the copy if a write overlapped it.
+class ServiceStateMirror {
+public:
+  ServiceStateMirror() {
+    memset(&snapshot_, 0, sizeof(snapshot_));
+    snapshot_.hdmi_connected = true;
+  }
+
+  ServiceSnapshot Read() const {
+    ServiceSnapshot copy;
+    for (;;) {
+      uint32_t before = sequence_.load(std::memory_order_acquire);
+      if (before & 1) {
+        SbThreadYield();
+        continue;
+      }
+      memcpy(&copy, &snapshot_, sizeof(copy));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == before)
+        return copy;
+    }
+  }
+
+  // Runs |mutate| on a copy of the current state and publishes the result.
+  template <typename MUTATE>
+  void Update(MUTATE mutate) {
+    ::starboard::ScopedLock lock(write_mutex_);
+    ServiceSnapshot next = snapshot_;
+    mutate(next);
+    ++next.version;
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&snapshot_, &next, sizeof(next));
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+private:
+  ::starboard::Mutex write_mutex_;
+  std::atomic<uint32_t> sequence_{0};
+  ServiceSnapshot snapshot_;
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(ServiceStateMirror, GetServiceStateMirror);
+
 class ServiceLink {
-  ::starboard::scoped_ptr<JSONRPC::LinkType<Core::JSON::IElement>> link_;
+  std::shared_ptr<LinkType> link_;
   std::string callsign_;
+  bool pooled_{false};
 
 #ifdef HAS_SECURITY_AGENT
   static Core::OptionalType<std::string> getToken() {
@@ -129,11 +418,55 @@ class ServiceLink {
     return enable_env_overrides;
   }
 
+  ServiceLink(const std::string &callsign, std::shared_ptr<LinkType> link)
+      : link_(std::move(link)), callsign_(callsign), pooled_(true) {}
+
+  void OnRequestDone(const std::string &method, SbTimeMonotonic start,
+                     uint32_t rc) {
+    GetServiceCallStats()->Record(callsign_, method,
+                                  SbTimeGetMonotonicNow() - start, rc);
+    if (pooled_ && rc == Core::ERROR_CONNECTION_CLOSED)
+      GetServiceLinkPool()->Drop(callsign_, link_);
+  }
+
 public:
+  // A link of its own, for users that subscribe to events.
   ServiceLink(const std::string callsign) : callsign_(callsign) {
     if (getenv("THUNDER_ACCESS") != nullptr)
-      link_.reset(new JSONRPC::LinkType<Core::JSON::IElement>(
-          callsign, nullptr, false, buildQuery()));
+      link_.reset(new LinkType(callsign, nullptr, false, buildQuery()));
+  }
+
+  // The pooled link of |callsign|, for plain requests.
+  static ServiceLink Shared(const std::string &callsign) {
+    std::shared_ptr<LinkType> link;
+    if (getenv("THUNDER_ACCESS") != nullptr)
+      link = GetServiceLinkPool()->Acquire(callsign, buildQuery());
+    return ServiceLink(callsign, std::move(link));
+  }
+
+  using AsyncCallback =
+      std::function<void(uint32_t rc, const JsonObject &response)>;
+
+  // Invoke() on the pooled link of |callsign| from the dispatcher thread,
+  // |callback| runs there with the outcome. CancelAsync(owner) must be called
+  // before anything |callback| touches goes away.
+  static void InvokeAsync(const void *owner, const std::string &callsign,
+                          const uint32_t waitTime, const string &method,
+                          const JsonObject &parameters,
+                          AsyncCallback callback) {
+    bool posted = GetServiceDispatcher()->Post(
+        owner, [callsign, waitTime, method, parameters, callback]() {
+          JsonObject response;
+          uint32_t rc = Shared(callsign).Invoke(waitTime, method, parameters,
+                                                response);
+          callback(rc, response);
+        });
+    if (!posted)
+      callback(Core::ERROR_UNAVAILABLE, JsonObject());
+  }
+
+  static void CancelAsync(const void *owner) {
+    GetServiceDispatcher()->Cancel(owner);
   }
 
   template <typename PARAMETERS>
@@ -152,7 +485,22 @@ public:
     }
     if (!link_)
       return Core::ERROR_UNAVAILABLE;
-    return link_->template Get<PARAMETERS>(waitTime, method, sendObject);
+    SbTimeMonotonic start = SbTimeGetMonotonicNow();
+    uint32_t rc = link_->template Get<PARAMETERS>(waitTime, method, sendObject);
+    OnRequestDone(method, start, rc);
+    return rc;
+  }
+
+  template <typename PARAMETERS, typename RESPONSE>
+  uint32_t Invoke(const uint32_t waitTime, const string &method,
+                  const PARAMETERS &parameters, RESPONSE &response) {
+    if (!link_)
+      return Core::ERROR_UNAVAILABLE;
+    SbTimeMonotonic start = SbTimeGetMonotonicNow();
+    uint32_t rc = link_->template Invoke<PARAMETERS, RESPONSE>(
+        waitTime, method, parameters, response);
+    OnRequestDone(method, start, rc);
+    return rc;
   }
 
   template <typename PARAMETERS, typename HANDLER, typename REALOBJECT>
@@ -193,7 +541,7 @@ public:
 struct DeviceIdImpl {
   DeviceIdImpl() {
     JsonData::DeviceIdentification::DeviceidentificationData data;
-    uint32_t rc = ServiceLink(kDeviceIdentificationCallsign)
+    uint32_t rc = ServiceLink::Shared(kDeviceIdentificationCallsign)
                       .Get(2000, "deviceidentification", data);
     if (Core::ERROR_NONE == rc) {
       chipset = data.Chipset.Value();
@@ -343,142 +691,52 @@ public:
 
 SB_ONCE_INITIALIZE_FUNCTION(TextToSpeechImpl, GetTextToSpeech);
 
-} // namespace
-
-struct DisplayInfo::Impl {
-  Impl();
-  ~Impl();
-  ResolutionInfo GetResolution() {
-    Refresh();
-    char out_value[20];
-    int value_length = 20;
-    if (AmlDeviceGetProperty("COBALT_FORCE_SUPPORT_4K", out_value, value_length) ==
-          AMLDEVICE_SUCCESS) {
-      if ((SbStringCompareNoCaseN(out_value, "y", 1) == 0) ||
-          (SbStringCompareNoCaseN(out_value, "Y", 1) == 0)) {
-        // force to 4k
-        resolution_info_.Width = 3840;
-        resolution_info_.Height = 2160;
-      } else if ((SbStringCompareNoCaseN(out_value, "n", 1) == 0) ||
-                 (SbStringCompareNoCaseN(out_value, "N", 1) == 0)) {
-        // force to FUD
-        resolution_info_.Width = 1920;
-        resolution_info_.Height = 1080;
-      }
-    }
-    return resolution_info_;
-  }
-  bool HasHDRSupport() {
-    Refresh();
-    const char *force_support_HDR = getenv("COBALT_FORCE_SUPPORT_HDR");
-    if (force_support_HDR) {
-      if ((SbStringCompareNoCaseN(force_support_HDR, "y", 1) == 0) ||
-          (SbStringCompareNoCaseN(force_support_HDR, "Y", 1) == 0)) {
-        has_hdr_support_ = true;
-      }
-    }
-    return has_hdr_support_;
-  }
-  float GetDiagonalSizeInInches() {
-    Refresh();
-    if (diagonal_size_in_inches_ == 0.f) {
-      // For TV project
-      // check the device properties TV_PANEL_SIZE
-      char out_value[20];
-      int value_length = 20;
-      if (AmlDeviceGetProperty("TV_PANEL_SIZE", out_value, value_length) ==
-          AMLDEVICE_SUCCESS) {
-        diagonal_size_in_inches_ = atof(out_value);
-      }
-    }
-    return diagonal_size_in_inches_;
-  }
-
-private:
-  void Refresh();
-  void OnUpdated(const Core::JSON::String &);
-
-  ServiceLink display_info_;
-  ResolutionInfo resolution_info_{};
-  bool has_hdr_support_{false};
-  float diagonal_size_in_inches_{0.f};
-  ::starboard::atomic_bool needs_refresh_{true};
-  ::starboard::atomic_bool did_subscribe_{false};
+// What DisplayInfo mirrors, as queried from the services.
+struct DisplayState {
+  ResolutionInfo resolution;
+  float diagonal_size_in_inches{0.f};
+  bool has_hdr{false};
 };
 
-DisplayInfo::Impl::Impl() : display_info_(kDisplayInfoCallsign) { Refresh(); }
-
-DisplayInfo::Impl::~Impl() {
-  display_info_.Unsubscribe(kDefaultTimeoutMs, "updated");
-}
-
-void DisplayInfo::Impl::Refresh() {
-  if (!needs_refresh_.load())
-    return;
-
+DisplayState QueryDisplayState(ServiceLink &display_info) {
+  DisplayState state;
   uint32_t rc;
-
-  if (!did_subscribe_.load()) {
-    bool old_val = did_subscribe_.exchange(true);
-    if (old_val == false) {
-      rc = display_info_.Subscribe<Core::JSON::String>(
-          kDefaultTimeoutMs, "updated", &DisplayInfo::Impl::OnUpdated, this);
-      if (Core::ERROR_UNAVAILABLE == rc || kPriviligedRequestErrorCode == rc) {
-        needs_refresh_.store(false);
-        SB_LOG(ERROR) << "Failed to subscribe to '" << kDisplayInfoCallsign
-                      << ".updated' event, rc=" << rc << " ( "
-                      << Core::ErrorToString(rc) << " )";
-        return;
-      }
-      if (Core::ERROR_NONE != rc) {
-        did_subscribe_.store(false);
-        SB_LOG(ERROR) << "Failed to subscribe to '" << kDisplayInfoCallsign
-                      << ".updated' event, rc=" << rc << " ( "
-                      << Core::ErrorToString(rc) << " )."
-                      << " Going to try again next time.";
-        display_info_.Unsubscribe(kDefaultTimeoutMs, "updated");
-      }
-    }
-  }
-
-  needs_refresh_.store(false);
-
   Core::JSON::EnumType<Exchange::IPlayerProperties::PlaybackResolution>
       resolution;
-  rc = ServiceLink(kPlayerInfoCallsign)
+  rc = ServiceLink::Shared(kPlayerInfoCallsign)
            .Get(kDefaultTimeoutMs, "resolution", resolution);
   if (Core::ERROR_NONE == rc) {
     switch (resolution) {
     case Exchange::IPlayerProperties::RESOLUTION_2160P30:
     case Exchange::IPlayerProperties::RESOLUTION_2160P60:
-      resolution_info_ = ResolutionInfo{3840, 2160};
+      state.resolution = ResolutionInfo{3840, 2160};
       break;
     case Exchange::IPlayerProperties::RESOLUTION_1080I:
     case Exchange::IPlayerProperties::RESOLUTION_1080P:
     case Exchange::IPlayerProperties::RESOLUTION_UNKNOWN:
-      resolution_info_ = ResolutionInfo{1920, 1080};
+      state.resolution = ResolutionInfo{1920, 1080};
       break;
     default:
-      resolution_info_ = ResolutionInfo{1280, 720};
+      state.resolution = ResolutionInfo{1280, 720};
       break;
     }
   } else {
-    resolution_info_ = ResolutionInfo{1920, 1080};
+    state.resolution = ResolutionInfo{1920, 1080};
     SB_LOG(ERROR) << "Failed to get 'resolution', rc=" << rc << " ( "
                   << Core::ErrorToString(rc) << " )";
   }
 
   Core::JSON::DecUInt16 widthincentimeters, heightincentimeters;
-  rc = display_info_.Get(kDefaultTimeoutMs, "widthincentimeters",
-                         widthincentimeters);
+  rc = display_info.Get(kDefaultTimeoutMs, "widthincentimeters",
+                        widthincentimeters);
   if (Core::ERROR_NONE != rc) {
     widthincentimeters.Clear();
     SB_LOG(ERROR) << "Failed to get 'DisplayInfo.widthincentimeters', rc=" << rc
                   << " ( " << Core::ErrorToString(rc) << " )";
   }
 
-  rc = display_info_.Get(kDefaultTimeoutMs, "heightincentimeters",
-                         heightincentimeters);
+  rc = display_info.Get(kDefaultTimeoutMs, "heightincentimeters",
+                        heightincentimeters);
   if (Core::ERROR_NONE != rc) {
     heightincentimeters.Clear();
     SB_LOG(ERROR) << "Failed to get 'DisplayInfo.heightincentimeters', rc="
@@ -486,11 +744,9 @@ void DisplayInfo::Impl::Refresh() {
   }
 
   if (widthincentimeters && heightincentimeters) {
-    diagonal_size_in_inches_ =
+    state.diagonal_size_in_inches =
         sqrtf(powf(widthincentimeters, 2) + powf(heightincentimeters, 2)) /
         2.54f;
-  } else {
-    diagonal_size_in_inches_ = 0.f;
   }
 
   auto detectHdr10Support = [&]() {
@@ -498,7 +754,7 @@ void DisplayInfo::Impl::Refresh() {
         Core::JSON::EnumType<Exchange::IHDRProperties::HDRType>>;
 
     Caps tvcapabilities;
-    rc = display_info_.Get(kDefaultTimeoutMs, "tvcapabilities", tvcapabilities);
+    rc = display_info.Get(kDefaultTimeoutMs, "tvcapabilities", tvcapabilities);
     if (Core::ERROR_NONE != rc) {
       SB_LOG(ERROR) << "Failed to get 'tvcapabilities', rc=" << rc << " ( "
                     << Core::ErrorToString(rc) << " )";
@@ -517,8 +773,8 @@ void DisplayInfo::Impl::Refresh() {
     }
 
     Caps stbcapabilities;
-    rc = display_info_.Get(kDefaultTimeoutMs, "stbcapabilities",
-                           stbcapabilities);
+    rc = display_info.Get(kDefaultTimeoutMs, "stbcapabilities",
+                          stbcapabilities);
     if (Core::ERROR_NONE != rc) {
       SB_LOG(ERROR) << "Failed to get 'stbcapabilities', rc=" << rc << " ( "
                     << Core::ErrorToString(rc) << " )";
@@ -539,21 +795,165 @@ void DisplayInfo::Impl::Refresh() {
     return stbHasHDR10;
   };
 
-  has_hdr_support_ = detectHdr10Support();
+  state.has_hdr = detectHdr10Support();
+  return state;
+}
+
+} // namespace
+
+struct DisplayInfo::Impl {
+  Impl();
+  ~Impl();
+  ResolutionInfo GetResolution() {
+    ServiceSnapshot state = GetServiceStateMirror()->Read();
+    ResolutionInfo resolution_info;
+    if (state.display_known) {
+      resolution_info = ResolutionInfo{state.resolution_width,
+                                       state.resolution_height};
+    }
+    char out_value[20];
+    int value_length = 20;
+    if (GetDeviceProperty("COBALT_FORCE_SUPPORT_4K", out_value, value_length)) {
+      if ((SbStringCompareNoCaseN(out_value, "y", 1) == 0) ||
+          (SbStringCompareNoCaseN(out_value, "Y", 1) == 0)) {
+        // force to 4k
+        resolution_info.Width = 3840;
+        resolution_info.Height = 2160;
+      } else if ((SbStringCompareNoCaseN(out_value, "n", 1) == 0) ||
+                 (SbStringCompareNoCaseN(out_value, "N", 1) == 0)) {
+        // force to FUD
+        resolution_info.Width = 1920;
+        resolution_info.Height = 1080;
+      }
+    }
+    return resolution_info;
+  }
+  bool HasHDRSupport() {
+    static const bool force_support_HDR = []() {
+      const char *value = getenv("COBALT_FORCE_SUPPORT_HDR");
+      return value && SbStringCompareNoCaseN(value, "y", 1) == 0;
+    }();
+    return force_support_HDR || GetServiceStateMirror()->Read().has_hdr;
+  }
+  float GetDiagonalSizeInInches() {
+    float diagonal_size_in_inches =
+        GetServiceStateMirror()->Read().diagonal_size_in_inches;
+    if (diagonal_size_in_inches == 0.f) {
+      // For TV project
+      // check the device properties TV_PANEL_SIZE
+      char out_value[20];
+      int value_length = 20;
+      if (GetDeviceProperty("TV_PANEL_SIZE", out_value, value_length)) {
+        diagonal_size_in_inches = atof(out_value);
+      }
+    }
+    return diagonal_size_in_inches;
+  }
+
+private:
+  // Subscribes if not done yet and queries the display state, on the
+  // constructing thread first and on the dispatcher thread after that.
+  void Refresh();
+  void OnUpdated(const Core::JSON::String &);
+  void PostRefresh();
+  void ScheduleRetry();
+
+  ServiceLink display_info_;
+  ::starboard::atomic_bool refresh_pending_{false};
+  ::starboard::atomic_bool did_subscribe_{false};
+  ::starboard::Mutex retry_mutex_;
+  SbEventId retry_event_{kSbEventIdInvalid};
+};
+
+DisplayInfo::Impl::Impl() : display_info_(kDisplayInfoCallsign) { Refresh(); }
+
+DisplayInfo::Impl::~Impl() {
+  display_info_.Unsubscribe(kDefaultTimeoutMs, "updated");
+  {
+    ::starboard::ScopedLock lock(retry_mutex_);
+    if (retry_event_ != kSbEventIdInvalid)
+      SbEventCancel(retry_event_);
+    retry_event_ = kSbEventIdInvalid;
+  }
+  ServiceLink::CancelAsync(this);
+}
 
-  SB_LOG(INFO) << "Display info updated, resolution: " << resolution_info_.Width
-               << 'x' << resolution_info_.Height
-               << ", has hdr: " << (has_hdr_support_ ? "yes" : "no")
-               << ", diagonal size in inches: " << diagonal_size_in_inches_;
+void DisplayInfo::Impl::ScheduleRetry() {
+  ::starboard::ScopedLock lock(retry_mutex_);
+  if (retry_event_ != kSbEventIdInvalid)
+    return;
+  retry_event_ = SbEventSchedule(
+      [](void *data) {
+        Impl *impl = static_cast<Impl *>(data);
+        {
+          ::starboard::ScopedLock lock(impl->retry_mutex_);
+          impl->retry_event_ = kSbEventIdInvalid;
+        }
+        impl->PostRefresh();
+      },
+      this, kSbTimeSecond);
+}
+
+void DisplayInfo::Impl::Refresh() {
+  refresh_pending_.store(false);
+
+  uint32_t rc;
+
+  if (!did_subscribe_.load()) {
+    bool old_val = did_subscribe_.exchange(true);
+    if (old_val == false) {
+      rc = display_info_.Subscribe<Core::JSON::String>(
+          kDefaultTimeoutMs, "updated", &DisplayInfo::Impl::OnUpdated, this);
+      if (Core::ERROR_UNAVAILABLE == rc || kPriviligedRequestErrorCode == rc) {
+        SB_LOG(ERROR) << "Failed to subscribe to '" << kDisplayInfoCallsign
+                      << ".updated' event, rc=" << rc << " ( "
+                      << Core::ErrorToString(rc) << " )";
+      } else if (Core::ERROR_NONE != rc) {
+        did_subscribe_.store(false);
+        SB_LOG(ERROR) << "Failed to subscribe to '" << kDisplayInfoCallsign
+                      << ".updated' event, rc=" << rc << " ( "
+                      << Core::ErrorToString(rc) << " )."
+                      << " Going to try again in a second.";
+        display_info_.Unsubscribe(kDefaultTimeoutMs, "updated");
+        ScheduleRetry();
+      }
+    }
+  }
+
+  DisplayState display = QueryDisplayState(display_info_);
+
+  GetServiceStateMirror()->Update([&](ServiceSnapshot &state) {
+    state.display_known = true;
+    state.resolution_width = display.resolution.Width;
+    state.resolution_height = display.resolution.Height;
+    state.has_hdr = display.has_hdr;
+    state.diagonal_size_in_inches = display.diagonal_size_in_inches;
+  });
+
+  SB_LOG(INFO) << "Display info updated, resolution: "
+               << display.resolution.Width << 'x' << display.resolution.Height
+               << ", has hdr: " << (display.has_hdr ? "yes" : "no")
+               << ", diagonal size in inches: "
+               << display.diagonal_size_in_inches;
 }
 
 void DisplayInfo::Impl::OnUpdated(const Core::JSON::String &) {
-  if (needs_refresh_.load() == false) {
-    needs_refresh_.store(true);
+  PostRefresh();
+}
+
+void DisplayInfo::Impl::PostRefresh() {
+  if (refresh_pending_.exchange(true))
+    return;
+  // Query on the dispatcher, readers keep the previous snapshot until the
+  // new one is published. Only then are answers derived from the display
+  // dropped and the application told.
+  GetServiceDispatcher()->Post(this, [this]() {
+    Refresh();
+    media::GetVideoSupportCache()->Invalidate("display info updated");
     SbEventSchedule(
         [](void *data) { Application::Get()->DisplayInfoChanged(); }, nullptr,
         0);
-  }
+  });
 }
 
 DisplayInfo::DisplayInfo() : impl_(new Impl) {}
@@ -580,17 +980,17 @@ std::string DeviceIdentification::GetFirmwareVersion() {
 
 struct HdcpProfile::HdcpProfileImpl {
 private:
-  bool has_hdmi_connect_{true};
   bool hdmi_hotplug_{true};
   ServiceLink hdpc_link_{kHdcpProfileCallsign};
-  RDKShellInfo rdkShellInfo;
   void StatusUpdated(const Core::JSON::String &data) {
 
     if (!hdmi_hotplug_)
       return;
 
-    // focusAppName init failed in rdkshellInfo
-    if (rdkShellInfo.ImpGetFocusAppName().empty()) {
+    // Focus comes from the application's RDKShellInfo, created first.
+    ServiceSnapshot state = GetServiceStateMirror()->Read();
+    const std::string focus_app_name = state.focused_app;
+    if (focus_app_name.empty()) {
       SB_LOG(ERROR) << "focusAppName is empty!";
       return;
     }
@@ -605,18 +1005,21 @@ private:
     else
       hdcpstatus = false;
 
-    if (hdcpstatus != has_hdmi_connect_) {
-      has_hdmi_connect_ = hdcpstatus;
+    if (hdcpstatus != state.hdmi_connected) {
+      GetServiceStateMirror()->Update(
+          [hdcpstatus](ServiceSnapshot &next) {
+            next.hdmi_connected = hdcpstatus;
+          });
       if (hdcpstatus) {
         // When cobalt is not in the focus state or focus app is launcher,
         // there is no need to respond to the callback,
         // otherwise it will cause confusion.
-        if ((!rdkShellInfo.ImpGetFocusStatus()) && (rdkShellInfo.ImpGetFocusAppName() !=  "launcher")) {
-          SB_LOG(INFO) << "Skip hdcpstatus handle, focusAppName is " << rdkShellInfo.ImpGetFocusAppName();
+        if ((!state.focused) && (focus_app_name !=  "launcher")) {
+          SB_LOG(INFO) << "Skip hdcpstatus handle, focusAppName is " << focus_app_name;
           return;
         }
 
-        bool focusstatus = Application::Get()->GetFocusStatus();
+        bool focusstatus = state.focused;
 
         SbEventSchedule(
             [](void *data) {
@@ -675,34 +1078,48 @@ HdcpProfile::~HdcpProfile() {}
 struct NetworkInfo::NetworkInfoImpl {
 private:
   ServiceLink networkinfo_link_{kNetworkCallsign};
-  bool wifi_connected_{false};
-  bool eth_connected_{false};
-  bool connect_status_{false};
+  // An event is newer than the reply to the initial query.
+  ::starboard::atomic_bool got_status_event_{false};
+
+  static NetworkInterface ToInterface(const std::string &name) {
+    if (name == "WIFI")
+      return NetworkInterface::kWifi;
+    if (name == "ETHERNET")
+      return NetworkInterface::kEthernet;
+    return NetworkInterface::kUnknown;
+  }
 
   void StatusUpdated(const JsonObject &data) {
-    if (0 == data.Get("interface").Value().compare("WIFI")) {
-      if (0 == data.Get("status").Value().compare("CONNECTED")) {
-        wifi_connected_ = true;
-      } else if (0 == data.Get("status").Value().compare("DISCONNECTED")) {
-        wifi_connected_ = false;
-      }
-    } else if (0 == data.Get("interface").Value().compare("ETHERNET")) {
-      if (0 == data.Get("status").Value().compare("CONNECTED")) {
-        eth_connected_ = true;
-      } else if (0 == data.Get("status").Value().compare("DISCONNECTED")) {
-        eth_connected_ = false;
-      }
-    }
-    if (wifi_connected_ || eth_connected_) {
-      if (!connect_status_)
-        Application::Get()->SendNetworkConnectEvent();
-      connect_status_ = true;
-    }
-    if ((!wifi_connected_) && (!eth_connected_)) {
-      if (connect_status_)
-        Application::Get()->SendNetworkDisconnectEvent();
-      connect_status_ = false;
-    }
+    got_status_event_.store(true);
+    const std::string interface = data.Get("interface").Value();
+    const std::string status = data.Get("status").Value();
+    bool was_connected = false;
+    bool connected = false;
+    GetServiceStateMirror()->Update([&](ServiceSnapshot &state) {
+      was_connected = state.wifi_connected || state.eth_connected;
+      bool *flag = nullptr;
+      if (0 == interface.compare("WIFI"))
+        flag = &state.wifi_connected;
+      else if (0 == interface.compare("ETHERNET"))
+        flag = &state.eth_connected;
+      if (flag && 0 == status.compare("CONNECTED"))
+        *flag = true;
+      else if (flag && 0 == status.compare("DISCONNECTED"))
+        *flag = false;
+      connected = state.wifi_connected || state.eth_connected;
+    });
+    if (connected && !was_connected)
+      Application::Get()->SendNetworkConnectEvent();
+    if (!connected && was_connected)
+      Application::Get()->SendNetworkDisconnectEvent();
+  }
+
+  void DefaultInterfaceChanged(const JsonObject &data) {
+    NetworkInterface interface =
+        ToInterface(data.Get("newInterfaceName").Value());
+    GetServiceStateMirror()->Update([interface](ServiceSnapshot &state) {
+      state.default_interface = interface;
+    });
   }
 
 public:
@@ -716,24 +1133,42 @@ public:
                     << ".onConnectionStatusChanged' event, rc=" << rc << " ( "
                     << Core::ErrorToString(rc) << " )";
     }
-    JsonObject data;
-    rc = ServiceLink(kNetworkCallsign)
-             .Get(kDefaultTimeoutMs, "getDefaultInterface", data);
-    if (Core::ERROR_NONE == rc) {
-      if (0 == data.Get("interface").Value().compare("WIFI")) {
-        wifi_connected_ = true;
-        connect_status_ = true;
-      }
-      if (0 == data.Get("interface").Value().compare("ETHERNET")) {
-        eth_connected_ = true;
-        connect_status_ = true;
-      }
+    rc = networkinfo_link_.Subscribe<JsonObject>(
+        kDefaultTimeoutMs, "onDefaultInterfaceChanged",
+        &NetworkInfoImpl::DefaultInterfaceChanged, this);
+    if (Core::ERROR_NONE != rc) {
+      SB_LOG(ERROR) << "Failed to subscribe to '" << kNetworkCallsign
+                    << ".onDefaultInterfaceChanged' event, rc=" << rc << " ( "
+                    << Core::ErrorToString(rc) << " )";
     }
+    // Created with the application, don't hold up startup for the reply.
+    ServiceLink::InvokeAsync(
+        this, kNetworkCallsign, kDefaultTimeoutMs, "getDefaultInterface",
+        JsonObject(), [this](uint32_t rc, const JsonObject &data) {
+          if (Core::ERROR_NONE != rc)
+            return;
+          NetworkInterface interface =
+              ToInterface(data.Get("interface").Value());
+          bool stale = got_status_event_.load();
+          GetServiceStateMirror()->Update([&](ServiceSnapshot &state) {
+            if (state.default_interface == NetworkInterface::kUnknown)
+              state.default_interface = interface;
+            if (stale)
+              return;
+            if (interface == NetworkInterface::kWifi)
+              state.wifi_connected = true;
+            if (interface == NetworkInterface::kEthernet)
+              state.eth_connected = true;
+          });
+        });
   }
 
   ~NetworkInfoImpl() {
+    ServiceLink::CancelAsync(this);
     networkinfo_link_.Unsubscribe(kDefaultTimeoutMs,
                                   "onConnectionStatusChanged");
+    networkinfo_link_.Unsubscribe(kDefaultTimeoutMs,
+                                  "onDefaultInterfaceChanged");
   }
 };
 
@@ -741,12 +1176,11 @@ NetworkInfo::NetworkInfo() : impl_(new NetworkInfoImpl) {}
 
 NetworkInfo::~NetworkInfo() {}
 bool NetworkInfo::IsConnectionTypeWireless() {
-  JsonObject data;
-  uint32_t rc = ServiceLink(kNetworkCallsign)
-                    .Get(kDefaultTimeoutMs, "getDefaultInterface", data);
-  if (Core::ERROR_NONE == rc)
-    return (0 == data.Get("interface").Value().compare("WIFI"));
-  return false;
+  ServiceSnapshot state = GetServiceStateMirror()->Read();
+  if (state.default_interface != NetworkInterface::kUnknown)
+    return state.default_interface == NetworkInterface::kWifi;
+  // No answer from the service yet, go by what is connected.
+  return state.wifi_connected && !state.eth_connected;
 }
 
 void TextToSpeech::Speak(const std::string &text) {
@@ -760,32 +1194,35 @@ void TextToSpeech::Cancel() { GetTextToSpeech()->Cancel(); }
 struct RDKShellInfo::RDKShellInfoImpl {
 private:
   ServiceLink rdkshellinfo_link_ { kRDKShellCallsign };
-  bool   focus_status_ {false};
   string appName_ {""};
-  string focusAppName_ {""};
-  //::starboard::Mutex mutex_;
+
+// Publishes the focused client, returns whether we had the focus before.
+static bool SetFocus(const std::string& client, bool focused) {
+  bool was_focused = false;
+  GetServiceStateMirror()->Update([&](ServiceSnapshot& state) {
+    was_focused = state.focused;
+    state.focused = focused;
+    ::starboard::strlcpy(state.focused_app, client.c_str(),
+                         sizeof(state.focused_app));
+  });
+  return was_focused;
+}
 
 void  onFocusStatus(const JsonObject& data) {
-  // ::starboard::ScopedLock lock(mutex_);
   std::string client = data.Get("client").Value();
   if (!client.empty()) {
-    focusAppName_ = client;
-    if ( appName_ == client) {
+    bool focused = appName_ == client;
+    bool was_focused = SetFocus(client, focused);
+    if (focused && !was_focused) {
       // get focus
-      if (!focus_status_) {
-        focus_status_ = true;
-        SbEventSchedule([](void* data) {
-          Application::Get()->SendFocusEvent();
-        }, nullptr, 0);
-      }
-    } else {
+      SbEventSchedule([](void* data) {
+        Application::Get()->SendFocusEvent();
+      }, nullptr, 0);
+    } else if (!focused && was_focused) {
       // lost focus
-      if (focus_status_) {
-        focus_status_ = false;
-        SbEventSchedule([](void* data) {
-          Application::Get()->SendBlurEvent();
-        }, nullptr, 0);
-      }
+      SbEventSchedule([](void* data) {
+        Application::Get()->SendBlurEvent();
+      }, nullptr, 0);
     }
   }
 }
@@ -793,12 +1230,12 @@ void  onFocusStatus(const JsonObject& data) {
 public:
 bool getfocusstatus(void)
 {
-  return focus_status_;
+  return GetServiceStateMirror()->Read().focused;
 }
 
 std::string getfocusAppName(void)
 {
-  return focusAppName_;
+  return GetServiceStateMirror()->Read().focused_app;
 }
 
 RDKShellInfoImpl() {
@@ -817,12 +1254,13 @@ RDKShellInfoImpl() {
 
   // Get focus for default focus status
   JsonObject data;
-  rc = ServiceLink(kRDKShellCallsign).Get(kDefaultTimeoutMs, "getFocused", data);
+  rc = ServiceLink::Shared(kRDKShellCallsign).Get(kDefaultTimeoutMs, "getFocused", data);
   if (Core::ERROR_NONE == rc)
   {
-    focusAppName_ = data.Get("client").Value();
-    if (appName_  == focusAppName_) {
-      focus_status_ = true;
+    std::string focusAppName = data.Get("client").Value();
+    bool focused = appName_ == focusAppName;
+    SetFocus(focusAppName, focused);
+    if (focused) {
       SbEventSchedule([](void* data) {
         Application::Get()->SendFocusEvent();
       }, nullptr, 0);
@@ -850,30 +1288,204 @@ RDKShellInfo::~RDKShellInfo() {}
 bool RDKShellInfo::ImpGetFocusStatus() { return impl_->getfocusstatus(); }
 std::string RDKShellInfo::ImpGetFocusAppName() { return impl_->getfocusAppName(); }
 
+namespace {
+
+// Capture ring of the voice input, the Thunder event thread produces and
+// the microphone reader consumes. Positions are free running byte counts,
+// each written by one side only, so neither side takes a lock; the mutex
+// and condition only park an idle reader.
+class VoiceRing {
+public:
+  // Power of two, about 4 s of 16 kHz mono S16.
+  static const size_t kCapacity = 128 * 1024;
+
+  VoiceRing() : buffer_(new uint8_t[kCapacity]) {}
+
+  // Producer. Base64 decodes |encoded| straight into the ring; whatever
+  // doesn't fit is dropped and counted as an overrun.
+  void WriteBase64(const std::string &encoded, SbTimeMonotonic captured) {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    const uint64_t tail = tail_.load(std::memory_order_acquire);
+    const size_t space = kCapacity - static_cast<size_t>(head - tail);
+
+    size_t written = 0;
+    size_t decoded = 0;
+    uint32_t bits = 0;
+    int bit_count = 0;
+    for (char c : encoded) {
+      int value = DecodeBase64Char(c);
+      if (value < 0)
+        continue;  // padding, line breaks
+      bits = (bits << 6) | static_cast<uint32_t>(value);
+      bit_count += 6;
+      if (bit_count >= 8) {
+        bit_count -= 8;
+        ++decoded;
+        if (written < space) {
+          buffer_[(head + written) & (kCapacity - 1)] =
+              static_cast<uint8_t>(bits >> bit_count);
+          ++written;
+        }
+      }
+    }
+    if (written < decoded) {
+      ++overrun_chunks_;
+      overrun_bytes_ += decoded - written;
+    }
+    if (!written)
+      return;
+
+    uint64_t end = head + written;
+    size_t mark_head = mark_head_.load(std::memory_order_relaxed);
+    if (mark_head - mark_tail_.load(std::memory_order_acquire) < kMaxMarks) {
+      marks_[mark_head % kMaxMarks] = Mark{end, captured};
+      mark_head_.store(mark_head + 1, std::memory_order_release);
+    }
+    head_.store(end, std::memory_order_release);
+
+    ::starboard::ScopedLock lock(wait_mutex_);
+    data_ready_.Signal();
+  }
+
+  // Producer. Everything written so far, and the latency marks of it, is
+  // dropped by the next Read().
+  void DiscardWritten() {
+    discard_to_.store(head_.load(std::memory_order_relaxed),
+                      std::memory_order_release);
+  }
+
+  // Consumer. Waits up to |timeout| for data, returns the bytes copied.
+  int Read(uint8_t *out, int size, SbTime timeout) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    const uint64_t discard_to = discard_to_.load(std::memory_order_acquire);
+    if (discard_to > tail) {
+      tail = discard_to;
+      tail_.store(tail, std::memory_order_release);
+      DropMarks(tail);
+    }
+
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (head == tail && timeout > 0) {
+      ::starboard::ScopedLock lock(wait_mutex_);
+      head = head_.load(std::memory_order_acquire);
+      if (head == tail)
+        data_ready_.WaitTimed(timeout);
+      head = head_.load(std::memory_order_acquire);
+    }
+
+    size_t count = std::min(static_cast<size_t>(head - tail),
+                            static_cast<size_t>(std::max(size, 0)));
+    if (!count)
+      return 0;
+    size_t offset = tail & (kCapacity - 1);
+    size_t first = std::min(count, kCapacity - offset);
+    memcpy(out, &buffer_[offset], first);
+    if (count > first)
+      memcpy(out + first, &buffer_[0], count - first);
+    tail += count;
+    tail_.store(tail, std::memory_order_release);
+    RecordLatency(tail);
+    return static_cast<int>(count);
+  }
+
+  // Consumer.
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           std::max(tail_.load(std::memory_order_relaxed),
+                    discard_to_.load(std::memory_order_acquire));
+  }
+
+  void LogStats() {
+    uint64_t reads = latency_count_.load();
+    SB_LOG(INFO) << "Voice input: " << head_.load() << " bytes captured, "
+                 << overrun_chunks_.load() << " overruns ("
+                 << overrun_bytes_.load() << " bytes dropped), capture to read "
+                 << (reads ? latency_total_.load() / static_cast<SbTime>(reads)
+                           : 0)
+                 << " us avg, " << latency_max_.load() << " us max over "
+                 << reads << " chunks";
+  }
+
+private:
+  static const size_t kMaxMarks = 256;
+
+  struct Mark {
+    uint64_t end;
+    SbTimeMonotonic captured;
+  };
+
+  static int DecodeBase64Char(char c) {
+    if (c >= 'A' && c <= 'Z')
+      return c - 'A';
+    if (c >= 'a' && c <= 'z')
+      return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+      return c - '0' + 52;
+    if (c == '+' || c == '-')
+      return 62;
+    if (c == '/' || c == '_')
+      return 63;
+    return -1;
+  }
+
+  // Consumer, the marks are only ever released on this side. Chunks that
+  // were discarded were never read and don't count.
+  void DropMarks(uint64_t tail) {
+    size_t mark_tail = mark_tail_.load(std::memory_order_relaxed);
+    const size_t mark_head = mark_head_.load(std::memory_order_acquire);
+    while (mark_tail != mark_head && marks_[mark_tail % kMaxMarks].end <= tail)
+      ++mark_tail;
+    mark_tail_.store(mark_tail, std::memory_order_release);
+  }
+
+  // A chunk counts as read once its last byte is.
+  void RecordLatency(uint64_t tail) {
+    SbTimeMonotonic now = SbTimeGetMonotonicNow();
+    size_t mark_tail = mark_tail_.load(std::memory_order_relaxed);
+    const size_t mark_head = mark_head_.load(std::memory_order_acquire);
+    while (mark_tail != mark_head && marks_[mark_tail % kMaxMarks].end <= tail) {
+      SbTime latency = now - marks_[mark_tail % kMaxMarks].captured;
+      latency_total_.fetch_add(latency);
+      latency_count_.fetch_add(1);
+      if (latency > latency_max_.load())
+        latency_max_.store(latency);
+      ++mark_tail;
+    }
+    mark_tail_.store(mark_tail, std::memory_order_release);
+  }
+
+  std::unique_ptr<uint8_t[]> buffer_;
+  std::atomic<uint64_t> head_{0};
+  std::atomic<uint64_t> tail_{0};
+  std::atomic<uint64_t> discard_to_{0};
+
+  Mark marks_[kMaxMarks];
+  std::atomic<size_t> mark_head_{0};
+  std::atomic<size_t> mark_tail_{0};
+
+  std::atomic<uint64_t> overrun_chunks_{0};
+  std::atomic<uint64_t> overrun_bytes_{0};
+  std::atomic<SbTime> latency_total_{0};
+  std::atomic<SbTime> latency_max_{0};
+  std::atomic<uint64_t> latency_count_{0};
+
+  ::starboard::Mutex wait_mutex_;
+  ::starboard::ConditionVariable data_ready_{wait_mutex_};
+};
+
+// Longest a microphone read waits for the next chunk.
+const SbTime kVoiceReadTimeout = 10 * kSbTimeMillisecond;
+
+}  // namespace
+
 struct VoiceInput::VoiceInputImpl {
 private:
   ServiceLink voiceinput_link_{kVoiceInputCallsign};
-  ::starboard::Mutex m_mutex;
   enum State { state_stop, state_start, state_data_buffering };
-  State m_step{state_stop}; // 0: stop,  1: start,  2: data
-  bool m_micFlag{true};     // 0: ble, 1, mic
-  size_t m_writePos{0};
-  size_t m_readPos{0};
-  uint8_t *m_audioBuf{nullptr};
-  size_t m_audioBufLen{100 * 1024};
-  size_t m_totalReadLen{0};
-  size_t m_totalWriteLen{0};
-  bool m_blStop{false};
-
-  void resetParameters() {
-    m_step = state_stop;
-    m_totalReadLen = 0;
-    m_totalWriteLen = 0;
-    m_writePos = 0;
-    m_readPos = 0;
-    m_micFlag = true;
-    m_blStop = false;
-  }
+  std::atomic<int> m_step{state_stop};
+  std::atomic<bool> m_micFlag{true};  // false: ble, true: mic
+  std::atomic<bool> m_blStop{false};
+  std::unique_ptr<VoiceRing> ring_;
 
   void StatusUpdated(const JsonObject &data) {
     if (0 == data.Get("source").Value().compare("mic")) {
@@ -882,83 +1494,45 @@ private:
       m_micFlag = false;
     }
 
-    if (0 == data.Get("action").Value().compare("start")) {
+    const std::string action = data.Get("action").Value();
+    if (0 == action.compare("start")) {
       /* for ble, stop event send when release RC button.
       cobalt may not read all data when get stop event here.
-      add m_blstop to reset parameters after stop event and
-       remaining buffer is 0.
-      add if(!m_micFlag && m_blStop) here to avoid cobalt stop reading
-       while data buffering still have data.
+      add m_blstop to drop the leftovers once the next capture starts.
       */
       if (m_step == state_stop && m_blStop) {
-        bool micFlag = m_micFlag;
-        resetParameters();
-        m_micFlag = micFlag;
+        ring_->DiscardWritten();
+        m_blStop = false;
       }
       m_step = state_start;
 
       if (!m_micFlag) {
         Application::Get()->SendMicTriggerEvent();
       }
-    } else if (0 == data.Get("action").Value().compare("stop")) {
-      if (m_micFlag)
-        resetParameters();
-      else {
+    } else if (0 == action.compare("stop")) {
+      if (m_micFlag) {
+        ring_->DiscardWritten();
+        m_blStop = false;
+      } else {
         m_blStop = true;
-        m_step = state_stop;
       }
-
-    } else if (0 == data.Get("action").Value().compare("data")) {
+      m_step = state_stop;
+      ring_->LogStats();
+    } else if (0 == action.compare("data")) {
       if (m_step == state_start) {
         m_step = state_data_buffering;
       }
     }
 
-    SB_LOG(WARNING) << "cobalt: status update: mic flag" << m_micFlag
-                  << " step:" << m_step<< " data size : " << data.Get("data").Value().size();
-
-    if (m_step == state_data_buffering) {
-      string micData = data.Get("data").Value();
-
-      if (micData.size() == 0)
-        return;
-
-      size_t dataSize = micData.size();
-      uint8_t *realData = new uint8_t[dataSize];
-      if (realData == nullptr) {
-        SB_LOG(ERROR) << "mic process:  malloc mem failed.";
-        return;
-      }
-
-      uint16_t convertSize;
-      size_t writePos = m_writePos;
-      convertSize = dataSize;
-      Core::FromString(micData, realData, convertSize, nullptr);
-      dataSize = convertSize;
-      int remaining = m_audioBufLen - writePos;
-      if (remaining > dataSize) {
-        memcpy(&m_audioBuf[writePos], realData, dataSize);
-        writePos += dataSize;
-      } else {
-        memcpy(&m_audioBuf[writePos], realData, remaining);
-        writePos = dataSize - remaining;
-        if (writePos)
-          memcpy(&m_audioBuf[0], realData + remaining, writePos);
-      }
-      {
-        ::starboard::ScopedLock lock(m_mutex);
-        m_totalWriteLen += dataSize;
-        m_writePos = writePos;
-      }
-      delete[] realData;
-    }
+    if (m_step == state_data_buffering)
+      ring_->WriteBase64(data.Get("data").Value(), SbTimeGetMonotonicNow());
   }
 
 public:
   VoiceInputImpl() {
     if (!getMicroPhoneEnable())
       return;
-    m_audioBuf = new uint8_t[m_audioBufLen];
+    ring_.reset(new VoiceRing);
     uint32_t rc = voiceinput_link_.Subscribe<JsonObject>(
         kDefaultTimeoutMs, "onVoiceInputStatusChanged",
         &VoiceInputImpl::StatusUpdated, this);
@@ -970,62 +1544,30 @@ public:
   }
 
   ~VoiceInputImpl() {
-    if (!getMicroPhoneEnable())
+    if (!ring_)
       return;
 
     voiceinput_link_.Unsubscribe(kDefaultTimeoutMs,
                                  "onVoiceInputStatusChanged");
-    delete m_audioBuf;
   }
 
+  // Blocks up to kVoiceReadTimeout when nothing has been captured yet.
   int getData(void *data, int size) {
-    int totalWriteLen;
-    int writePos;
-    bool blStop = false;
-    {
-      ::starboard::ScopedLock lock(m_mutex);
-      totalWriteLen = m_totalWriteLen;
-      writePos = m_writePos;
-      if (!m_micFlag && m_blStop)
-        blStop = true;
-    }
-    SB_LOG(WARNING) << "write len: " << totalWriteLen
-                  << " read len: " << m_totalReadLen << " data size: " << size;
-    if (totalWriteLen <= m_totalReadLen) {
-      if (blStop) {
-        resetParameters();
-      }
+    if (!ring_)
       return 0;
+    int read = ring_->Read(static_cast<uint8_t *>(data), size,
+                           m_step == state_stop ? 0 : kVoiceReadTimeout);
+    if (!read && m_blStop && !m_micFlag && ring_->Empty()) {
+      // ble capture ended and everything was read.
+      m_blStop = false;
+      m_micFlag = true;
     }
+    return read;
+  }
 
-    int copyLen;
-    int posDiff;
-
-    copyLen = totalWriteLen - m_totalReadLen;
-    copyLen = copyLen > size ? size : copyLen;
-    posDiff = writePos > m_readPos ? (writePos - m_readPos)
-                                   : (writePos + m_audioBufLen - m_readPos);
-
-    if (copyLen > posDiff) {
-      SB_LOG(ERROR) << kVoiceInputCallsign
-                    << "Not enough buffer size for voice input data";
-    }
-
-    if (m_readPos + copyLen < m_audioBufLen) {
-      memcpy(data, &m_audioBuf[m_readPos], copyLen);
-      m_readPos += copyLen;
-    } else {
-      int remaining = m_audioBufLen - m_readPos;
-      memcpy(data, &m_audioBuf[m_readPos], remaining);
-      m_readPos = copyLen - remaining;
-      if (m_readPos) {
-        memcpy((uint8_t *)data + remaining, &m_audioBuf[0], m_readPos);
-      }
-    }
-    m_totalReadLen += copyLen;
-    SB_LOG(WARNING) << "get data:" << copyLen << " read pos:" << m_readPos
-                  << "total len:" << m_totalReadLen;
-    return copyLen;
+  void logStats() {
+    if (ring_)
+      ring_->LogStats();
   }
 
   static bool getMicroPhoneEnable() {
@@ -1033,8 +1575,7 @@ public:
     int value_length = 32;
     bool defaultEnable = true;  // default as enable if no setting in device properties
 
-    if (AmlDeviceGetProperty("COBALT_MICROPHONE",
-          out_value, value_length) != AMLDEVICE_SUCCESS) {
+    if (!GetDeviceProperty("COBALT_MICROPHONE", out_value, value_length)) {
       return defaultEnable;
     }
 
@@ -1064,7 +1605,7 @@ int VoiceInput::GetData(void *data, int size) {
 
 bool VoiceInput::StartRecord() {
   JsonObject data;
-  uint32_t rc = ServiceLink(kVoiceInputCallsign)
+  uint32_t rc = ServiceLink::Shared(kVoiceInputCallsign)
                     .Get(kDefaultTimeoutMs, "startCapture", data);
   if (Core::ERROR_NONE != rc) {
     SB_LOG(ERROR) << "Failed to startCapture for callsign : '"
@@ -1077,7 +1618,7 @@ bool VoiceInput::StartRecord() {
 
 bool VoiceInput::StopRecord() {
   JsonObject data;
-  uint32_t rc = ServiceLink(kVoiceInputCallsign)
+  uint32_t rc = ServiceLink::Shared(kVoiceInputCallsign)
                     .Get(kDefaultTimeoutMs, "stopCapture", data);
   if (Core::ERROR_NONE != rc) {
     SB_LOG(ERROR) << "Failed to stopCapture for callsign : '"
@@ -1095,18 +1636,8 @@ bool VoiceInput::isSampleRateSupport(int sample_rate) {
   bool support = false;
 
   params.Set("samplerate", sample_rate);
-  std::shared_ptr<
-      WPEFramework::JSONRPC::LinkType<WPEFramework::Core::JSON::IElement>>
-      samplerateSupport;
-  samplerateSupport = std::make_shared<
-      WPEFramework::JSONRPC::LinkType<WPEFramework::Core::JSON::IElement>>(
-      "org.rdk.VoiceInput.1", "", false, "");
-  if (samplerateSupport == nullptr)  {
-    SB_LOG(ERROR) << "voiceinput: get plugin info failed";
-    return false;
-  }
-
-  rc = samplerateSupport->Invoke(2000, "isSamplerateSupport", params, result);
+  rc = ServiceLink::Shared(kVoiceInputCallsign)
+           .Invoke(2000, "isSamplerateSupport", params, result);
 
   if (rc != Core::ERROR_NONE) {
     SB_LOG(ERROR) << "isSampleRateSupport failed" << rc << " ( "
@@ -1124,7 +1655,7 @@ bool VoiceInput::isMuted() {
   JsonObject data;
   uint32_t rc;
 
-  rc = ServiceLink(kVoiceInputCallsign).Get(kDefaultTimeoutMs, "getMute", data);
+  rc = ServiceLink::Shared(kVoiceInputCallsign).Get(kDefaultTimeoutMs, "getMute", data);
 
   if (Core::ERROR_NONE == rc) {
     SB_LOG(WARNING) << "check micro phone is muted:  "
@@ -1145,7 +1676,7 @@ bool VoiceInput::isMuted() {
 int VoiceInput::GetSampleRate() {
   uint32_t rc;
   JsonObject data;
-  rc = ServiceLink(kVoiceInputCallsign)
+  rc = ServiceLink::Shared(kVoiceInputCallsign)
            .Get(kDefaultTimeoutMs, "getSampleRate", data);
   if (Core::ERROR_NONE == rc) {
     int sampleRate = 16000;
@@ -1167,6 +1698,142 @@ int VoiceInput::GetMicroPhoneEnable() {
   return VoiceInputImpl::getMicroPhoneEnable();
 }
 
+namespace {
+
+const uint32_t kBenchmarkLatencyStepsMs[] = {0, 10, 25, 50, 75, 100, 150, 250};
+
+struct BenchmarkCase {
+  const char *name;
+  void (*run)();
+};
+
+// Starboard calls read the service state mirror, so the requests that keep
+// it up to date are issued directly and the answers are dropped. Nothing
+// here may publish into the mirror the application is reading.
+const BenchmarkCase kBenchmarkCases[] = {
+    // What NetworkInfo asks for behind SbSystemGetConnectionType().
+    {"Network.getDefaultInterface",
+     []() {
+       JsonObject response;
+       ServiceLink::Shared(kNetworkCallsign)
+           .Invoke(kDefaultTimeoutMs, "getDefaultInterface", JsonObject(),
+                   response);
+     }},
+    {"VoiceInput::isMuted", []() { VoiceInput::isMuted(); }},
+    {"VoiceInput::GetSampleRate", []() { VoiceInput::GetSampleRate(); }},
+    // Same requests DisplayInfo issues after an 'updated' event.
+    {"DisplayInfo::Refresh",
+     []() {
+       ServiceLink display_info = ServiceLink::Shared(kDisplayInfoCallsign);
+       QueryDisplayState(display_info);
+     }},
+    // Served from the mirror and the support cache, these should not move
+    // with the service latency.
+    {"Application::GetDisplayResolution",
+     []() { Application::Get()->GetDisplayResolution(); }},
+    {"SbMediaIsVideoSupported",
+     []() {
+       SbMediaIsVideoSupported(
+           kSbMediaVideoCodecVp9, "video/webm; codecs=\"vp9\"", -1, -1, 8,
+           kSbMediaPrimaryIdBt709, kSbMediaTransferIdBt709,
+           kSbMediaMatrixIdBt709, 1920, 1080, 20000000, 30, false);
+     }},
+};
+
+bool SetMockLatency(ServiceLink &control, uint32_t latency_ms) {
+  JsonObject params;
+  params.Set(_T("latency"), latency_ms);
+  Core::JSON::DecUInt32 result;
+  // The stand-in answers control requests without the injected delay.
+  uint32_t rc = control.Invoke(2000, "setlatency", params, result);
+  if (Core::ERROR_NONE != rc) {
+    SB_LOG(ERROR) << "Failed to reach '" << kThunderMockCallsign
+                  << "', rc=" << rc << " ( " << Core::ErrorToString(rc)
+                  << " ). Is tools/thunder_mock.py running?";
+    return false;
+  }
+  return true;
+}
+
+SbTime Percentile(const std::vector<SbTime> &sorted, int percent) {
+  if (sorted.empty())
+    return 0;
+  size_t index = (sorted.size() - 1) * percent / 100;
+  return sorted[index];
+}
+
+}  // namespace
+
+std::string ServiceLatencyBenchmark::Run(int iterations) {
+  if (iterations <= 0)
+    iterations = 20;
+
+  ServiceLink control(kThunderMockCallsign);
+  if (!SetMockLatency(control, 0))
+    return std::string();
+
+  std::stringstream report;
+  report << "{\"timeout_ms\":" << kDefaultTimeoutMs
+         << ",\"iterations\":" << iterations << ",\"steps\":[";
+
+  bool first_step = true;
+  for (uint32_t latency_ms : kBenchmarkLatencyStepsMs) {
+    if (!SetMockLatency(control, latency_ms))
+      break;
+    GetServiceCallStats()->Reset();
+
+    report << (first_step ? "" : ",") << "{\"service_latency_ms\":"
+           << latency_ms << ",\"calls\":{";
+    first_step = false;
+
+    bool first_case = true;
+    for (const BenchmarkCase &benchmark_case : kBenchmarkCases) {
+      std::vector<SbTime> samples;
+      samples.reserve(iterations);
+      for (int i = 0; i < iterations; ++i) {
+        SbTimeMonotonic start = SbTimeGetMonotonicNow();
+        benchmark_case.run();
+        samples.push_back(SbTimeGetMonotonicNow() - start);
+      }
+      std::sort(samples.begin(), samples.end());
+      report << (first_case ? "" : ",") << "\"" << benchmark_case.name
+             << "\":{\"p50_us\":" << Percentile(samples, 50)
+             << ",\"p95_us\":" << Percentile(samples, 95)
+             << ",\"max_us\":" << samples.back() << "}";
+      first_case = false;
+    }
+
+    report << "},\"requests\":{";
+    bool first_request = true;
+    for (const auto &it : GetServiceCallStats()->Snapshot()) {
+      const ServiceCallStats::Entry &entry = it.second;
+      report << (first_request ? "" : ",") << "\"" << it.first
+             << "\":{\"count\":" << entry.count
+             << ",\"avg_us\":" << entry.total / entry.count
+             << ",\"max_us\":" << entry.max
+             << ",\"timeouts\":" << entry.timeouts
+             << ",\"failures\":" << entry.failures << ",\"histogram\":[";
+      entry.histogram.PrintCounts(report);
+      report << "]}";
+      first_request = false;
+    }
+    report << "}}";
+
+    SB_LOG(INFO) << "Service latency " << latency_ms << "ms step done";
+  }
+  report << "]";
+
+  // DisplayInfo::Refresh and the voice input cases read device properties,
+  // the store reads should stay flat however many iterations ran.
+  DevicePropertyStats properties = GetDevicePropertyStats();
+  report << ",\"device_properties\":{\"lookups\":" << properties.lookups
+         << ",\"store_reads\":" << properties.store_reads
+         << ",\"invalidations\":" << properties.invalidations << "}}";
+
+  SetMockLatency(control, 0);
+  return report.str();
+}
+
 } // namespace shared
 } // namespace rdk
 } // namespace starboard
@@ -112,6 +112,8 @@ public:
   VoiceInput();
   ~VoiceInput();
 
+  // Copies up to |size| captured bytes, waiting up to 10 ms for the next
+  // chunk while a capture is running. Returns 0 when there is nothing yet.
   static int GetData(void *data, int size);
   static bool StartRecord();
   static bool StopRecord();
@@ -126,6 +128,17 @@ private:
   static VoiceInput *_instance;
 };
 
+class ServiceLatencyBenchmark {
+public:
+  // Steps the reply latency of tools/thunder_mock.py and times the Thunder
+  // requests behind Starboard calls at each step. Returns a JSON
+  // report, or an empty string if the stand-in can't be reached. Requests
+  // carry a round trip histogram (<1, <5, <20, <100, >=100 ms), and
+  // "callsign.<link>" entries count the pooled link setups.
+  // "device_properties" has the GetDevicePropertyStats() counters.
+  static std::string Run(int iterations);
+};
+
 }  // namespace shared
 }  // namespace rdk
 }  // namespace starboard
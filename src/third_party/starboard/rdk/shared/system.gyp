@@ -45,6 +45,8 @@
       'WPEFrameworkDefinitions',
       'WPEFrameworkPlugins',
     ],
+    # Replace libocdm with the in-process ClearKey stand-in (drm/ocdm_mock.cc).
+    'use_mock_ocdm%': 0,
     'has_securityagent%' : '<!(pkg-config securityagent && echo 1 || echo 0)',
     'has_cryptography%'  : '<!(make -C <(DEPTH)/third_party/starboard/rdk/shared/config.tests/cryptography >/dev/null 2>&1 && echo 1 || echo 0)'
   },
@@ -55,6 +57,7 @@
       'link_settings': {
         'libraries': [
           '-lessos',
+          '-lwayland-client',
         ],
       },
     }, # essos
@@ -110,7 +113,7 @@
     }, # rfcapi
   ],
   'conditions': [
-    ['<(has_ocdm)==1', {
+    ['<(has_ocdm)==1 and <(use_mock_ocdm)==0', {
      'targets': [
         {
           'target_name': 'ocdm',
@@ -132,6 +135,37 @@
         }, # ocdm
       ],
     }],
+    ['<(has_ocdm)==1 and <(use_mock_ocdm)==1', {
+     'targets': [
+        {
+          'target_name': 'ocdm_mock',
+          'type': 'static_library',
+          'sources': [
+            'drm/ocdm_mock.cc',
+          ],
+          'cflags': [
+            '<!@(<(pkg-config) --cflags ocdm)',
+          ],
+          'dependencies': [
+            'gstreamer',
+            '<(DEPTH)/third_party/boringssl/boringssl.gyp:crypto',
+          ],
+        }, # ocdm_mock
+        {
+          'target_name': 'ocdm',
+          'type': 'none',
+          'direct_dependent_settings': {
+            'cflags': [
+              '<!@(<(pkg-config) --cflags ocdm)',
+              '-DDRM_PATH_STATS=1',
+            ],
+          },
+          'dependencies': [
+            'ocdm_mock',
+          ],
+        }, # ocdm
+      ],
+    }],
     ['<(has_securityagent)==1', {
      'targets': [
         {
@@ -29,6 +29,8 @@ float CobaltGetMaximumFrameIntervalInMilliseconds() {
   return -1.0f;
 }
 
+// Read once when the renderer pipeline is created. FramePacer paces the
+// swaps instead, so it isn't applied twice.
 float CobaltGetMinimumFrameIntervalInMilliseconds() {
   return -1.0f;
 }
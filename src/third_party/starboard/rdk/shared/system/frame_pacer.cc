@@ -0,0 +1,193 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/system/frame_pacer.h"
+
+#include <algorithm>
+
+#include "starboard/common/log.h"
+#include "starboard/once.h"
+#include "starboard/thread.h"
+
+#include "third_party/starboard/rdk/shared/tunables.h"
+
+#include "third_party/starboard/rdk/shared/log_override.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace system {
+namespace {
+
+// Videos faster than this gain nothing from pacing on a 60 Hz output.
+const SbTime kMinPacedFrameDuration = 20 * kSbTimeMillisecond;
+const SbTime kReportInterval = 30 * kSbTimeSecond;
+
+SB_ONCE_INITIALIZE_FUNCTION(FramePacer, GetFramePacer);
+
+}  // namespace
+
+// static
+FramePacer* FramePacer::Get() {
+  return GetFramePacer();
+}
+
+void FramePacer::SetVideoFrameDuration(const void* player, SbTime duration) {
+  ::starboard::ScopedLock lock(mutex_);
+  Video& video = videos_[player];
+  if (video.frame_duration == duration)
+    return;
+  AccountLocked(video, SbTimeGetMonotonicNow());
+  SB_LOG(INFO) << "Video " << player << " frame duration " << duration << " us";
+  video.frame_duration = duration;
+  UpdateIntervalLocked();
+}
+
+void FramePacer::SetVideoPlaying(const void* player, bool playing) {
+  ::starboard::ScopedLock lock(mutex_);
+  Video& video = videos_[player];
+  if (video.playing == playing)
+    return;
+  SbTimeMonotonic now = SbTimeGetMonotonicNow();
+  AccountLocked(video, now);
+  video.playing = playing;
+  video.accounted_at = now;
+  UpdateIntervalLocked();
+}
+
+void FramePacer::Remove(const void* player) {
+  ::starboard::ScopedLock lock(mutex_);
+  auto it = videos_.find(player);
+  if (it == videos_.end())
+    return;
+  AccountLocked(it->second, SbTimeGetMonotonicNow());
+  videos_.erase(it);
+  UpdateIntervalLocked();
+}
+
+void FramePacer::SetUiAnimating(bool animating) {
+  int64_t previous = animating_.exchange(animating ? 1 : 0);
+  if (previous == -1)
+    SB_LOG(INFO) << "UI animation state reported, UI frames may be paced";
+}
+
+void FramePacer::OnCompositorFrame() {
+  WaitForFrameInterval();
+  compositor_frames_.increment();
+  int64_t next_report = next_report_.load();
+  if (next_report == 0)
+    return;
+  SbTimeMonotonic now = SbTimeGetMonotonicNow();
+  if (now < next_report ||
+      !next_report_.compare_exchange_strong(&next_report, now + kReportInterval))
+    return;
+  ::starboard::ScopedLock lock(mutex_);
+  for (auto& entry : videos_)
+    AccountLocked(entry.second, now);
+  LogStatsLocked();
+}
+
+SbTime FramePacer::GetFrameInterval() {
+  int64_t interval = interval_.load();
+  if (interval == 0 || animating_.load() != 0)
+    return 0;
+  if (!GetTunable(Tunable::kUiFramePacing))
+    return 0;
+  return interval;
+}
+
+// Swaps are spaced from the start of one to the start of the next, the
+// time the swap itself blocks on vsync counts towards the interval.
+void FramePacer::WaitForFrameInterval() {
+  SbTime interval = GetFrameInterval();
+  if (interval != swap_interval_) {
+    if (interval)
+      SB_LOG(INFO) << "Pacing UI swaps " << interval << " us apart";
+    else
+      SB_LOG(INFO) << "UI swaps unpaced";
+    swap_interval_ = interval;
+  }
+  SbTimeMonotonic now = SbTimeGetMonotonicNow();
+  if (interval && last_swap_) {
+    SbTime wait = last_swap_ + interval - now;
+    if (wait > 0) {
+      SbThreadSleep(wait);
+      now = SbTimeGetMonotonicNow();
+    }
+  }
+  last_swap_ = now;
+}
+
+void FramePacer::AccountLocked(Video& video, SbTimeMonotonic now) {
+  if (video.playing && video.frame_duration > 0)
+    video_frames_ +=
+        static_cast<double>(now - video.accounted_at) / video.frame_duration;
+  video.accounted_at = now;
+}
+
+// The fastest playing video sets the pace. Trick play and paused players
+// leave it unpaced, so seeking previews stay smooth. UI frames only count
+// while something plays.
+void FramePacer::UpdateIntervalLocked() {
+  SbTime interval = kSbTimeMax;
+  bool any_playing = false;
+  for (const auto& entry : videos_) {
+    const Video& video = entry.second;
+    if (!video.playing)
+      continue;
+    any_playing = true;
+    // Unknown frame durations are 0, which also leaves the UI unpaced.
+    interval = std::min(interval, video.frame_duration);
+  }
+  if (!any_playing || interval < kMinPacedFrameDuration)
+    interval = 0;
+
+  if (any_playing != any_playing_) {
+    if (any_playing) {
+      reported_compositor_frames_ = compositor_frames_.load();
+      video_frames_ = 0;
+    } else {
+      LogStatsLocked();
+    }
+    any_playing_ = any_playing;
+  }
+  if (interval != interval_.load())
+    SB_LOG(INFO) << "UI frame interval " << (interval ? interval : -1) << " us";
+  interval_.store(interval);
+  next_report_.store(any_playing ? SbTimeGetMonotonicNow() + kReportInterval
+                                 : 0);
+}
+
+void FramePacer::LogStatsLocked() {
+  uint64_t frames = compositor_frames_.load();
+  uint64_t played = frames - reported_compositor_frames_;
+  if (video_frames_ < 1.0)
+    return;
+  SB_LOG(INFO) << "UI frames per video frame "
+               << static_cast<double>(played) / video_frames_ << " ("
+               << played << " UI frames over " << static_cast<uint64_t>(video_frames_)
+               << " video frames)";
+  reported_compositor_frames_ = frames;
+  video_frames_ = 0;
+}
+
+}  // namespace system
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
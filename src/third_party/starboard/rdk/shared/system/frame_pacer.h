@@ -0,0 +1,102 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_SYSTEM_FRAME_PACER_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_SYSTEM_FRAME_PACER_H_
+
+#include <map>
+
+#include "starboard/atomic.h"
+#include "starboard/common/mutex.h"
+#include "starboard/time.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace system {
+
+// Decides how often the UI needs to be composited. While a video plays at
+// normal rate and the UI has no animations pending, the UI only has to keep
+// up with the video, so buffer swaps are held one video frame apart.
+// Pending animations, trick play or no video lift the limit again.
+// Compositor frames are counted against the video frames that played, the
+// ratio is logged and is the number to watch.
+//
+// Off unless the ui_frame_pacing tunable is set, and even then only once
+// the renderer reports through SbRdkSetUiAnimating() whether its frames
+// have animations pending. Without that nothing tells a spinner or a fade
+// apart from a static UI, and those must not be held to the video rate.
+//
+// Pacing happens in the eglSwapBuffers() wrapper rather than through the
+// Graphics extension's minimum frame interval, which the renderer only
+// reads when its pipeline is created.
+class FramePacer {
+ public:
+  static FramePacer* Get();
+
+  // Players report their frame duration once it is known and whether they
+  // play at normal rate; Remove() when they go away.
+  void SetVideoFrameDuration(const void* player, SbTime duration);
+  void SetVideoPlaying(const void* player, bool playing);
+  void Remove(const void* player);
+
+  // Whether the frame the rasterizer is about to draw has animations
+  // pending, reported by the renderer for every submission.
+  void SetUiAnimating(bool animating);
+  // Called by the rasterizer right before every swap, returns once the
+  // swap may go ahead.
+  void OnCompositorFrame();
+
+ private:
+  struct Video {
+    SbTime frame_duration { 0 };
+    bool playing { false };
+    SbTimeMonotonic accounted_at { 0 };
+  };
+
+  // 0 when the UI may need every refresh.
+  SbTime GetFrameInterval();
+  void WaitForFrameInterval();
+  void AccountLocked(Video& video, SbTimeMonotonic now);
+  void UpdateIntervalLocked();
+  void LogStatsLocked();
+
+  ::starboard::Mutex mutex_;
+  std::map<const void*, Video> videos_;
+  bool any_playing_ { false };
+  double video_frames_ { 0 };
+  uint64_t reported_compositor_frames_ { 0 };
+
+  // Read on every frame without the lock.
+  ::starboard::atomic_int64_t interval_ { 0 };
+  // -1 until the renderer first reports, then 0 or 1.
+  ::starboard::atomic_int64_t animating_ { -1 };
+  ::starboard::atomic_int64_t compositor_frames_ { 0 };
+  ::starboard::atomic_int64_t next_report_ { 0 };
+
+  // Rasterizer thread only.
+  SbTimeMonotonic last_swap_ { 0 };
+  SbTime swap_interval_ { 0 };
+};
+
+}  // namespace system
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_SYSTEM_FRAME_PACER_H_
@@ -15,15 +15,16 @@
 #include "starboard/string.h"
 #include "starboard/common/string.h"
 #include "starboard/system.h"
-#include "aml_device_property.h"
+#include "third_party/starboard/rdk/shared/device_properties.h"
+
+using third_party::starboard::rdk::shared::GetDeviceProperty;
 
 
 SbSystemDeviceType SbSystemGetDeviceType() {
   SbSystemDeviceType ret = kSbSystemDeviceTypeUnknown;
   char out_value[20];
   int value_length = 20;
-  if (AmlDeviceGetProperty("YOUTUBE_DEVICE_TYPE",
-        out_value, value_length) != AMLDEVICE_SUCCESS) {
+  if (!GetDeviceProperty("YOUTUBE_DEVICE_TYPE", out_value, value_length)) {
     return ret;
   }
 
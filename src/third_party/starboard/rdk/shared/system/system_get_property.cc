@@ -41,11 +41,10 @@
 #include "starboard/character.h"
 #include "starboard/file.h"
 
+#include "third_party/starboard/rdk/shared/device_properties.h"
 #include "third_party/starboard/rdk/shared/rdkservices.h"
 #include "third_party/starboard/rdk/shared/log_override.h"
 
-#include "aml_device_property.h"
-
 #if SB_API_VERSION >= 11
 const char kCertificationScope[] = "amlogic-2021-amlogictvref"; // Please fill in the certification scope you get from google team
 const char kBase64EncodedCertificationSecret[] = "Fake Secret"; // If you want to test with SW device authentication, please fill in the device secret key you get from google team
@@ -53,6 +52,8 @@ const char kBase64EncodedCertificationSecret[] = "Fake Secret"; // If you want t
 
 namespace {
 
+using third_party::starboard::rdk::shared::GetDeviceProperty;
+
 bool CopyStringAndTestIfSuccess(char* out_value,
                                 int value_length,
                                 const char* from_value) {
@@ -63,72 +64,63 @@ bool CopyStringAndTestIfSuccess(char* out_value,
 }
 
 bool GetBrankName(char* out_value, int value_length) {
-  if (AmlDeviceGetProperty("BRAND_NAME",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("BRAND_NAME", out_value, value_length)) {
     return true;
   }
   return CopyStringAndTestIfSuccess(out_value, value_length, SB_PLATFORM_BRAND_NAME);
 }
 
 bool GetModelName(char* out_value, int value_length) {
-  if (AmlDeviceGetProperty("MODEL_NAME",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("MODEL_NAME", out_value, value_length)) {
     return true;
   }
   return CopyStringAndTestIfSuccess(out_value, value_length, SB_PLATFORM_MODEL_NAME);
 }
 
 bool GetOperatorName(char* out_value, int value_length) {
-  if (AmlDeviceGetProperty("OPERATOR_NAME",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("OPERATOR_NAME", out_value, value_length)) {
     return true;
   }
   return CopyStringAndTestIfSuccess(out_value, value_length, SB_PLATFORM_OPERATOR_NAME);
 }
 
 bool GetChipsetModelNumber(char* out_value, int value_length) {
-  if (AmlDeviceGetProperty("CHIPSET_MODEL_NUM",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("CHIPSET_MODEL_NUM", out_value, value_length)) {
     return true;
   }
   return CopyStringAndTestIfSuccess(out_value, value_length, SB_PLATFORM_CHIPSET_MODEL_NUMBER_STRING);
 }
 
 bool GetFirmwareVersion(char* out_value, int value_length) {
-  if (AmlDeviceGetProperty("FIRMWARE_VERSION",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("FIRMWARE_VERSION", out_value, value_length)) {
     return true;
   }
   return CopyStringAndTestIfSuccess(out_value, value_length, SB_PLATFORM_FIRMWARE_VERSION_STRING);
 }
 
 bool GetSysIntegrateName(char* out_value, int value_length) {
-  if (AmlDeviceGetProperty("SYSINTEGRATE_NAME",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("SYSINTEGRATE_NAME", out_value, value_length)) {
     return true;
   }
   return CopyStringAndTestIfSuccess(out_value, value_length, SB_PLATFORM_SYSINTEGRATE_NAME);
 }
 
 bool GetModelYear(char* out_value, int value_length) {
-  if (AmlDeviceGetProperty("MODEL_YEAR",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("MODEL_YEAR", out_value, value_length)) {
     return true;
   }
   return CopyStringAndTestIfSuccess(out_value, value_length, SB_PLATFORM_MODEL_YEAR_STRING);
 }
 
 bool GetFriendlyName(char* out_value, int value_length) {
-  if (AmlDeviceGetProperty("FRIENDLY_NAME",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("FRIENDLY_NAME", out_value, value_length)) {
     return true;
   }
   return CopyStringAndTestIfSuccess(out_value, value_length, SB_PLATFORM_FRIENDLY_NAME);
 }
 
 bool GetPlatformName(char* out_value, int value_length) {
-  if (AmlDeviceGetProperty("PLATFORM_NAME",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("PLATFORM_NAME", out_value, value_length)) {
     return true;
   }
   return CopyStringAndTestIfSuccess(out_value, value_length, SB_PLATFORM_NAME);
@@ -136,16 +128,14 @@ bool GetPlatformName(char* out_value, int value_length) {
 
 #if SB_API_VERSION >= 11
 bool GetCertificationScope(char* out_value, int value_length) {
-  if (AmlDeviceGetProperty("CERT_SCOPE",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("CERT_SCOPE", out_value, value_length)) {
     return true;
   }
   return CopyStringAndTestIfSuccess(out_value, value_length, kCertificationScope);
 }
 
 bool GetCertificationSecret(char* out_value, int value_length) {
-  if (AmlDeviceGetProperty("CERT_SECRET",
-        out_value, value_length) == AMLDEVICE_SUCCESS) {
+  if (GetDeviceProperty("CERT_SECRET", out_value, value_length)) {
     return true;
   }
   if (kBase64EncodedCertificationSecret[0] == '\0')
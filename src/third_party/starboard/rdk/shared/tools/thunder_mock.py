@@ -0,0 +1,535 @@
+#!/usr/bin/env python3
+# Copyright 2020 Comcast Cable Communications Management, LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# SPDX-License-Identifier: Apache-2.0
+"""Local stand-in for the Thunder JSON-RPC WebSocket endpoint.
+
+Emulates the callsigns used by rdkservices.cc so the Starboard side can be
+exercised on a desk without a full RDK image:
+
+  ./thunder_mock.py --port 55555 --latency-ms 20
+  THUNDER_ACCESS=127.0.0.1:55555 THUNDER_SECURITY_OFF=1 ./cobalt
+
+Reply latency can be set globally or per callsign, and a callsign can be
+made to drop requests so the client hits its timeout. Events are injected
+either from stdin:
+
+  event org.rdk.Network.1 onConnectionStatusChanged {"interface":"WIFI","status":"DISCONNECTED"}
+  latency 50
+  latency org.rdk.Network.1 150
+  drop DisplayInfo.1 on
+  stats
+
+or over JSON-RPC through the ThunderMock.1 callsign (setlatency, setdrop,
+event, stats, reset), which is what SbRdkRunServiceLatencyBenchmark uses to
+sweep latencies from inside the process.
+"""
+
+import argparse
+import base64
+import copy
+import hashlib
+import json
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+_WS_GUID = '258EAFA5-E914-47DA-95CA-C5AB0DC85B11'
+_CONTROL_CALLSIGN = 'ThunderMock.1'
+
+_OP_CONTINUATION = 0x0
+_OP_TEXT = 0x1
+_OP_BINARY = 0x2
+_OP_CLOSE = 0x8
+_OP_PING = 0x9
+_OP_PONG = 0xA
+
+_ERROR_UNKNOWN_METHOD = -32601
+_ERROR_UNAVAILABLE = 2
+
+# Canned replies, keyed by callsign and then method. Values are returned as
+# the JSON-RPC "result" member.
+_DEFAULT_RESPONSES = {
+    'DisplayInfo.1': {
+        'widthincentimeters': 121,
+        'heightincentimeters': 68,
+        'tvcapabilities': ['HdrOff', 'Hdr10'],
+        'stbcapabilities': ['HdrOff', 'Hdr10'],
+    },
+    'PlayerInfo.1': {
+        'resolution': 'Resolution1080P',
+    },
+    'DeviceIdentification.1': {
+        'deviceidentification': {
+            'firmwareversion': 'mock-1.0',
+            'chipset': 'MOCK',
+            'identifier': 'WPEMOCK0001',
+        },
+    },
+    'org.rdk.Network.1': {
+        'getDefaultInterface': {'interface': 'ETHERNET', 'success': True},
+    },
+    'org.rdk.TextToSpeech.1': {
+        'isttsenabled': {'isenabled': False, 'success': True},
+        'speak': {'speechid': 1, 'TTS_Status': 0, 'success': True},
+        'cancel': {'success': True},
+    },
+    'org.rdk.HdcpProfile.1': {
+        'getHDCPStatus': {
+            'HDCPStatus': {
+                'isConnected': True,
+                'isHDCPCompliant': True,
+                'isHDCPEnabled': True,
+                'hdcpReason': 2,
+                'supportedHDCPVersion': '2.2',
+                'receiverHDCPVersion': '2.2',
+                'currentHDCPVersion': '2.2',
+            },
+            'success': True,
+        },
+    },
+    'org.rdk.RDKShell.1': {
+        'getFocused': {'client': 'cobalt', 'success': True},
+    },
+    'org.rdk.VoiceInput.1': {
+        'getMute': {'mute': False, 'success': True},
+        'getSampleRate': {'samplerate': 16000, 'success': True},
+        'isSamplerateSupport': {'support': True, 'success': True},
+        'startCapture': {'success': True},
+        'stopCapture': {'success': True},
+    },
+}
+
+
+def _log(msg):
+  sys.stderr.write('[thunder_mock] %s\n' % msg)
+  sys.stderr.flush()
+
+
+class _Histogram(object):
+  """Power of two bucketed latency histogram, in microseconds."""
+
+  def __init__(self):
+    self.buckets = {}
+    self.count = 0
+    self.total_us = 0
+    self.max_us = 0
+
+  def add(self, us):
+    bucket = 1
+    while bucket < us:
+      bucket <<= 1
+    self.buckets[bucket] = self.buckets.get(bucket, 0) + 1
+    self.count += 1
+    self.total_us += us
+    self.max_us = max(self.max_us, us)
+
+  def to_json(self):
+    return {
+        'count': self.count,
+        'avg_us': self.total_us // self.count if self.count else 0,
+        'max_us': self.max_us,
+        'buckets_us': {str(k): v for k, v in sorted(self.buckets.items())},
+    }
+
+
+class MockState(object):
+  """Configuration and bookkeeping shared between all connections."""
+
+  def __init__(self, args):
+    self.lock = threading.Lock()
+    self.responses = copy.deepcopy(_DEFAULT_RESPONSES)
+    self.latency_ms = args.latency_ms
+    self.jitter_ms = args.jitter_ms
+    self.callsign_latency_ms = {}
+    self.dropped = set()
+    self.connections = set()
+    # (connection, callsign, event) -> client supplied notification id.
+    self.subscriptions = {}
+    self.requests = {}
+    for entry in args.callsign_latency or []:
+      callsign, _, value = entry.rpartition('=')
+      self.callsign_latency_ms[callsign] = float(value)
+    for callsign in args.drop or []:
+      self.dropped.add(callsign)
+    if args.responses:
+      with open(args.responses) as f:
+        for callsign, methods in json.load(f).items():
+          self.responses.setdefault(callsign, {}).update(methods)
+
+  def delay_for(self, callsign):
+    with self.lock:
+      base = self.callsign_latency_ms.get(callsign, self.latency_ms)
+      jitter = self.jitter_ms
+    if jitter > 0:
+      base += random.uniform(-jitter, jitter)
+    return max(0.0, base) / 1000.0
+
+  def set_latency(self, latency_ms, callsign=None):
+    with self.lock:
+      if callsign:
+        self.callsign_latency_ms[callsign] = float(latency_ms)
+      else:
+        self.latency_ms = float(latency_ms)
+        self.callsign_latency_ms.clear()
+
+  def set_drop(self, callsign, enabled):
+    with self.lock:
+      if enabled:
+        self.dropped.add(callsign)
+      else:
+        self.dropped.discard(callsign)
+
+  def is_dropped(self, callsign):
+    with self.lock:
+      return callsign in self.dropped
+
+  def record(self, callsign, method, us):
+    key = '%s.%s' % (callsign, method)
+    with self.lock:
+      self.requests.setdefault(key, _Histogram()).add(us)
+
+  def stats(self):
+    with self.lock:
+      return {
+          'latency_ms': self.latency_ms,
+          'callsign_latency_ms': dict(self.callsign_latency_ms),
+          'dropped': sorted(self.dropped),
+          'connections': len(self.connections),
+          'subscriptions': len(self.subscriptions),
+          'requests': {k: v.to_json() for k, v in self.requests.items()},
+      }
+
+  def reset_stats(self):
+    with self.lock:
+      self.requests.clear()
+
+  def subscribe(self, conn, callsign, event, notify_id):
+    with self.lock:
+      self.subscriptions[(conn, callsign, event)] = notify_id
+
+  def unsubscribe(self, conn, callsign, event):
+    with self.lock:
+      self.subscriptions.pop((conn, callsign, event), None)
+
+  def drop_connection(self, conn):
+    with self.lock:
+      self.connections.discard(conn)
+      for key in [k for k in self.subscriptions if k[0] is conn]:
+        del self.subscriptions[key]
+
+  def inject_event(self, callsign, event, params):
+    with self.lock:
+      targets = [(k[0], v) for k, v in self.subscriptions.items()
+                 if k[1] == callsign and k[2] == event]
+    for conn, notify_id in targets:
+      conn.send_json({
+          'jsonrpc': '2.0',
+          'method': '%s.%s' % (notify_id, event),
+          'params': params,
+      })
+    _log('event %s.%s -> %d subscriber(s)' % (callsign, event, len(targets)))
+    return len(targets)
+
+
+def _split_designator(designator, responses):
+  """Splits 'org.rdk.Network.1.getDefaultInterface' into its parts."""
+  callsign, _, method = designator.rpartition('.')
+  if callsign in responses or callsign == _CONTROL_CALLSIGN:
+    return callsign, method
+  # Unversioned designators ("DisplayInfo.width") map to version 1.
+  versioned = callsign + '.1'
+  if versioned in responses:
+    return versioned, method
+  return callsign, method
+
+
+class Connection(object):
+  """One WebSocket client, speaking Thunder flavoured JSON-RPC 2.0."""
+
+  def __init__(self, sock, address, state):
+    self.sock = sock
+    self.address = address
+    self.state = state
+    self.send_lock = threading.Lock()
+    self.closed = False
+
+  def serve(self):
+    try:
+      if not self._handshake():
+        return
+      with self.state.lock:
+        self.state.connections.add(self)
+      _log('client %s:%d connected' % self.address)
+      while not self.closed:
+        message = self._read_message()
+        if message is None:
+          break
+        self._on_message(message)
+    except (OSError, ValueError) as e:
+      _log('client %s:%d error: %s' % (self.address + (e,)))
+    finally:
+      self.closed = True
+      self.state.drop_connection(self)
+      try:
+        self.sock.close()
+      except OSError:
+        pass
+      _log('client %s:%d disconnected' % self.address)
+
+  def _recv_exact(self, size):
+    data = b''
+    while len(data) < size:
+      chunk = self.sock.recv(size - len(data))
+      if not chunk:
+        return None
+      data += chunk
+    return data
+
+  def _handshake(self):
+    request = b''
+    while b'\r\n\r\n' not in request:
+      chunk = self.sock.recv(4096)
+      if not chunk:
+        return False
+      request += chunk
+      if len(request) > 16384:
+        return False
+    lines = request.split(b'\r\n\r\n', 1)[0].decode('latin-1').split('\r\n')
+    headers = {}
+    for line in lines[1:]:
+      name, _, value = line.partition(':')
+      headers[name.strip().lower()] = value.strip()
+    key = headers.get('sec-websocket-key')
+    if not key:
+      self.sock.sendall(b'HTTP/1.1 400 Bad Request\r\n\r\n')
+      return False
+    accept = base64.b64encode(
+        hashlib.sha1((key + _WS_GUID).encode('ascii')).digest()).decode()
+    response = [
+        'HTTP/1.1 101 Switching Protocols',
+        'Upgrade: websocket',
+        'Connection: Upgrade',
+        'Sec-WebSocket-Accept: ' + accept,
+    ]
+    protocol = headers.get('sec-websocket-protocol')
+    if protocol:
+      response.append('Sec-WebSocket-Protocol: ' +
+                      protocol.split(',')[0].strip())
+    self.sock.sendall(('\r\n'.join(response) + '\r\n\r\n').encode('latin-1'))
+    return True
+
+  def _read_frame(self):
+    header = self._recv_exact(2)
+    if header is None:
+      return None, None, None
+    fin = bool(header[0] & 0x80)
+    opcode = header[0] & 0x0F
+    masked = bool(header[1] & 0x80)
+    length = header[1] & 0x7F
+    if length == 126:
+      length = struct.unpack('!H', self._recv_exact(2))[0]
+    elif length == 127:
+      length = struct.unpack('!Q', self._recv_exact(8))[0]
+    mask = self._recv_exact(4) if masked else None
+    payload = self._recv_exact(length) if length else b''
+    if payload is None:
+      return None, None, None
+    if mask:
+      payload = bytes(b ^ mask[i & 3] for i, b in enumerate(payload))
+    return fin, opcode, payload
+
+  def _read_message(self):
+    fragments = []
+    while True:
+      fin, opcode, payload = self._read_frame()
+      if opcode is None:
+        return None
+      if opcode == _OP_CLOSE:
+        self._send_frame(_OP_CLOSE, payload[:2])
+        return None
+      if opcode == _OP_PING:
+        self._send_frame(_OP_PONG, payload)
+        continue
+      if opcode == _OP_PONG:
+        continue
+      if opcode in (_OP_TEXT, _OP_BINARY, _OP_CONTINUATION):
+        fragments.append(payload)
+        if fin:
+          return b''.join(fragments).decode('utf-8')
+
+  def _send_frame(self, opcode, payload):
+    header = bytearray([0x80 | opcode])
+    if len(payload) < 126:
+      header.append(len(payload))
+    elif len(payload) < 65536:
+      header.append(126)
+      header += struct.pack('!H', len(payload))
+    else:
+      header.append(127)
+      header += struct.pack('!Q', len(payload))
+    with self.send_lock:
+      if self.closed:
+        return
+      try:
+        self.sock.sendall(bytes(header) + payload)
+      except OSError:
+        self.closed = True
+
+  def send_json(self, message):
+    self._send_frame(_OP_TEXT, json.dumps(message).encode('utf-8'))
+
+  def _on_message(self, text):
+    try:
+      request = json.loads(text)
+    except ValueError:
+      _log('dropping malformed message: %r' % text[:200])
+      return
+    if 'method' not in request or 'id' not in request:
+      return
+    # Thunder serves requests from a worker pool, so a slow reply must not
+    # hold back the ones behind it.
+    threading.Thread(target=self._handle, args=(request,),
+                     daemon=True).start()
+
+  def _handle(self, request):
+    start = time.monotonic()
+    callsign, method = _split_designator(request['method'],
+                                         self.state.responses)
+    params = request.get('params')
+    if callsign == _CONTROL_CALLSIGN:
+      result, error = self._handle_control(method, params or {})
+    else:
+      if self.state.is_dropped(callsign):
+        return
+      time.sleep(self.state.delay_for(callsign))
+      result, error = self._handle_service(callsign, method, params)
+      self.state.record(callsign, method,
+                        int((time.monotonic() - start) * 1e6))
+    reply = {'jsonrpc': '2.0', 'id': request['id']}
+    if error is not None:
+      reply['error'] = error
+    else:
+      reply['result'] = result
+    self.send_json(reply)
+
+  def _handle_service(self, callsign, method, params):
+    if method == 'register':
+      self.state.subscribe(self, callsign, params.get('event'),
+                           params.get('id'))
+      return 0, None
+    if method == 'unregister':
+      self.state.unsubscribe(self, callsign, params.get('event'))
+      return 0, None
+    methods = self.state.responses.get(callsign)
+    if methods is None:
+      return None, {'code': _ERROR_UNAVAILABLE,
+                    'message': 'Service is not active'}
+    if method not in methods:
+      return None, {'code': _ERROR_UNKNOWN_METHOD,
+                    'message': 'Unknown method.'}
+    return methods[method], None
+
+  def _handle_control(self, method, params):
+    if method == 'setlatency':
+      self.state.set_latency(params.get('latency', 0), params.get('callsign'))
+      return 0, None
+    if method == 'setdrop':
+      self.state.set_drop(params.get('callsign'), params.get('enabled', True))
+      return 0, None
+    if method == 'event':
+      count = self.state.inject_event(params.get('callsign'),
+                                      params.get('event'),
+                                      params.get('params', {}))
+      return {'subscribers': count}, None
+    if method == 'stats':
+      return self.state.stats(), None
+    if method == 'reset':
+      self.state.reset_stats()
+      return 0, None
+    return None, {'code': _ERROR_UNKNOWN_METHOD, 'message': 'Unknown method.'}
+
+
+def _console(state):
+  """Reads injection commands from stdin until EOF."""
+  for line in sys.stdin:
+    words = line.strip().split(None, 3)
+    if not words:
+      continue
+    try:
+      if words[0] == 'event' and len(words) >= 3:
+        params = json.loads(words[3]) if len(words) > 3 else {}
+        state.inject_event(words[1], words[2], params)
+      elif words[0] == 'latency' and len(words) == 2:
+        state.set_latency(float(words[1]))
+      elif words[0] == 'latency' and len(words) == 3:
+        state.set_latency(float(words[2]), words[1])
+      elif words[0] == 'drop' and len(words) == 3:
+        state.set_drop(words[1], words[2] in ('on', '1', 'true'))
+      elif words[0] == 'stats':
+        print(json.dumps(state.stats(), indent=2, sort_keys=True))
+      elif words[0] == 'reset':
+        state.reset_stats()
+      else:
+        _log('unknown command: %s' % line.strip())
+    except ValueError as e:
+      _log('bad command "%s": %s' % (line.strip(), e))
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__,
+                                   formatter_class=argparse.RawTextHelpFormatter)
+  parser.add_argument('--host', default='127.0.0.1')
+  parser.add_argument('--port', type=int, default=55555)
+  parser.add_argument('--latency-ms', type=float, default=0.0,
+                      help='reply latency applied to every callsign')
+  parser.add_argument('--jitter-ms', type=float, default=0.0,
+                      help='uniform +/- jitter added to each reply')
+  parser.add_argument('--callsign-latency', action='append',
+                      metavar='CALLSIGN=MS',
+                      help='per callsign latency override, repeatable')
+  parser.add_argument('--drop', action='append', metavar='CALLSIGN',
+                      help='never answer requests for CALLSIGN, repeatable')
+  parser.add_argument('--responses', metavar='FILE',
+                      help='JSON file merged over the canned replies, '
+                           '{"callsign": {"method": result}}')
+  args = parser.parse_args()
+
+  state = MockState(args)
+  server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+  server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+  server.bind((args.host, args.port))
+  server.listen(16)
+  _log('listening on %s:%d, latency %.1f ms' %
+       (args.host, args.port, args.latency_ms))
+
+  threading.Thread(target=_console, args=(state,), daemon=True).start()
+  try:
+    while True:
+      sock, address = server.accept()
+      sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+      threading.Thread(target=Connection(sock, address, state).serve,
+                       daemon=True).start()
+  except KeyboardInterrupt:
+    pass
+  finally:
+    server.close()
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,354 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+
+#include "third_party/starboard/rdk/shared/tunables.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "starboard/atomic.h"
+#include "starboard/common/log.h"
+#include "starboard/common/mutex.h"
+#include "starboard/configuration_constants.h"
+#include "starboard/once.h"
+#include "starboard/system.h"
+
+#include "third_party/starboard/rdk/shared/log_override.h"
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+namespace {
+
+const char kTunablesFileName[] = "tunables";
+const int kTunablesFormat = 1;
+const int kCount = static_cast<int>(Tunable::kCount);
+
+// kEnum values are indexes into |choices|, the names are what the
+// environment and JSON use.
+enum class Type { kBool, kInt, kEnum };
+
+struct TunableInfo {
+  const char* name;
+  Type type;
+  int64_t default_value;
+  int64_t min_value;
+  int64_t max_value;
+  // Where the value came from before there were tunables.
+  const char* env;
+  const char* const* choices = nullptr;
+};
+
+const int64_t kMegabyte = 1024 * 1024;
+
+const char* const kAudioLatencyProfiles[] = {"low", "balanced", "power",
+                                             nullptr};
+
+const TunableInfo kTunables[kCount] = {
+    {"support_lowmem", Type::kBool, 0, 0, 1, "COBALT_SUPPORT_LOWMEM"},
+    {"support_av1", Type::kBool, 1, 0, 1, "COBALT_SUPPORT_AV1"},
+    {"hang_detector_interval_s", Type::kInt, 30, 0, 3600,
+     "COBALT_HANG_DETECTOR_INTERVAL_IN_SECONDS"},
+    {"video_appsrc_max_bytes", Type::kInt, 32 * kMegabyte, kMegabyte,
+     256 * kMegabyte, nullptr},
+    {"audio_appsrc_max_bytes", Type::kInt, 8 * kMegabyte, 256 * 1024,
+     64 * kMegabyte, nullptr},
+    {"secmem_min_free_bytes", Type::kInt, 4 * kMegabyte, 0, 64 * kMegabyte,
+     nullptr},
+    {"secmem_min_free_buffers", Type::kInt, 5, 0, 64, nullptr},
+    {"min_video_buffer_ms", Type::kInt, 250, 0, 10000, nullptr},
+    {"min_audio_buffer_ms", Type::kInt, 250, 0, 10000, nullptr},
+    {"ess_run_loop_period_us", Type::kInt, 16666, 1000, 100000, nullptr},
+    {"media_budget_dynamic", Type::kBool, 0, 0, 1, nullptr},
+    {"audio_latency_profile", Type::kEnum, 1, 0, 2,
+     "COBALT_AUDIO_LATENCY_PROFILE", kAudioLatencyProfiles},
+    {"ui_frame_pacing", Type::kBool, 0, 0, 1, nullptr},
+};
+
+// "y", "true", "1" and their opposites, as the old variables were set.
+bool ParseBool(const char* text, int64_t* out_value) {
+  switch (text[0]) {
+    case 'y': case 'Y': case 't': case 'T': case '1':
+      *out_value = 1;
+      return true;
+    case 'n': case 'N': case 'f': case 'F': case '0':
+      *out_value = 0;
+      return true;
+  }
+  return false;
+}
+
+// Decimal only, so a zero padded value like "030" isn't read as octal.
+bool ParseInt(const char* text, int64_t* out_value) {
+  char* end = nullptr;
+  long long value = strtoll(text, &end, 10);
+  if (end == text)
+    return false;
+  while (*end == ' ' || *end == '\t' || *end == '\n' || *end == '\r')
+    ++end;
+  if (*end)
+    return false;
+  *out_value = value;
+  return true;
+}
+
+// |length| characters of |text|, which needn't be terminated.
+bool ParseChoice(const TunableInfo& info,
+                 const char* text,
+                 size_t length,
+                 int64_t* out_value) {
+  for (int i = 0; info.choices[i]; ++i) {
+    if (strlen(info.choices[i]) == length &&
+        strncmp(info.choices[i], text, length) == 0) {
+      *out_value = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParseEnv(const TunableInfo& info, const char* text, int64_t* out_value) {
+  switch (info.type) {
+    case Type::kBool:
+      return ParseBool(text, out_value);
+    case Type::kInt:
+      return ParseInt(text, out_value);
+    case Type::kEnum:
+      return ParseChoice(info, text, strlen(text), out_value);
+  }
+  return false;
+}
+
+class TunableStore {
+ public:
+  TunableStore() {
+    for (int i = 0; i < kCount; ++i) {
+      const TunableInfo& info = kTunables[i];
+      base_[i] = info.default_value;
+      const char* env = info.env ? getenv(info.env) : nullptr;
+      int64_t value = 0;
+      if (env && *env) {
+        if (ParseEnv(info, env, &value))
+          base_[i] = Clamp(i, value);
+        else
+          SB_LOG(WARNING) << "Bad value for " << info.env << ": " << env;
+      }
+      values_[i].store(base_[i]);
+    }
+    ::starboard::ScopedLock lock(mutex_);
+    LoadLocked();
+  }
+
+  int64_t Get(Tunable tunable) const {
+    return values_[static_cast<int>(tunable)].load();
+  }
+
+  bool Set(const char* name, const char* json) {
+    int index = Find(name);
+    if (index < 0 || !json) {
+      SB_LOG(WARNING) << "Unknown tunable " << (name ? name : "(null)");
+      return false;
+    }
+    while (*json == ' ' || *json == '\t')
+      ++json;
+
+    ::starboard::ScopedLock lock(mutex_);
+    const TunableInfo& info = kTunables[index];
+    if (strncmp(json, "null", 4) == 0) {
+      stored_[index] = false;
+      values_[index].store(base_[index]);
+      SB_LOG(INFO) << "Tunable " << info.name << " back to "
+                   << base_[index];
+      StoreLocked();
+      return true;
+    }
+
+    int64_t value = 0;
+    bool parsed = false;
+    if (info.type == Type::kBool && strncmp(json, "true", 4) == 0) {
+      value = 1;
+      parsed = true;
+    } else if (info.type == Type::kBool && strncmp(json, "false", 5) == 0) {
+      parsed = true;
+    } else if (info.type == Type::kEnum && *json == '"') {
+      const char* end = strchr(json + 1, '"');
+      parsed = end && ParseChoice(info, json + 1, end - json - 1, &value);
+    } else {
+      parsed = ParseInt(json, &value) &&
+               (info.type != Type::kBool || value == 0 || value == 1);
+    }
+    if (!parsed) {
+      SB_LOG(WARNING) << "Bad value for tunable " << info.name << ": " << json;
+      return false;
+    }
+    value = Clamp(index, value);
+    stored_[index] = true;
+    values_[index].store(value);
+    SB_LOG(INFO) << "Tunable " << info.name << " set to " << value;
+    StoreLocked();
+    return true;
+  }
+
+  bool GetJson(const char* name, std::string* out_json) const {
+    if (name && *name) {
+      int index = Find(name);
+      if (index < 0)
+        return false;
+      *out_json = ToJson(index);
+      return true;
+    }
+    std::string json = "{";
+    for (int i = 0; i < kCount; ++i) {
+      json += (i ? ",\"" : "\"");
+      json += kTunables[i].name;
+      json += "\":";
+      json += ToJson(i);
+    }
+    json += "}";
+    *out_json = json;
+    return true;
+  }
+
+ private:
+  static int Find(const char* name) {
+    if (!name)
+      return -1;
+    for (int i = 0; i < kCount; ++i) {
+      if (strcmp(kTunables[i].name, name) == 0)
+        return i;
+    }
+    return -1;
+  }
+
+  static int64_t Clamp(int index, int64_t value) {
+    const TunableInfo& info = kTunables[index];
+    int64_t clamped =
+        std::max(info.min_value, std::min(info.max_value, value));
+    if (clamped != value) {
+      SB_LOG(WARNING) << "Tunable " << info.name << " " << value
+                      << " out of range, using " << clamped;
+    }
+    return clamped;
+  }
+
+  std::string ToJson(int index) const {
+    int64_t value = values_[index].load();
+    if (kTunables[index].type == Type::kBool)
+      return value ? "true" : "false";
+    if (kTunables[index].type == Type::kEnum)
+      return std::string("\"") + kTunables[index].choices[value] + "\"";
+    return std::to_string(static_cast<long long>(value));
+  }
+
+  static bool GetStorePath(std::string* path) {
+    std::vector<char> dir(kSbFileMaxPath);
+    if (!SbSystemGetPath(kSbSystemPathCacheDirectory, dir.data(),
+                         static_cast<int>(dir.size())))
+      return false;
+    *path = std::string(dir.data()) + "/" + kTunablesFileName;
+    return true;
+  }
+
+  void LoadLocked() {
+    if (!GetStorePath(&path_)) {
+      SB_LOG(WARNING) << "No cache directory, tunables are not persisted";
+      return;
+    }
+    FILE* file = fopen(path_.c_str(), "r");
+    if (!file)
+      return;
+    int format = 0;
+    if (fscanf(file, "%d", &format) != 1 || format != kTunablesFormat) {
+      SB_LOG(WARNING) << "Ignoring " << path_ << ", unknown format";
+      fclose(file);
+      return;
+    }
+    char name[64];
+    long long value;
+    while (fscanf(file, " %63s %lld", name, &value) == 2) {
+      int index = Find(name);
+      if (index < 0) {
+        SB_LOG(WARNING) << "Ignoring stored tunable " << name;
+        continue;
+      }
+      stored_[index] = true;
+      values_[index].store(Clamp(index, value));
+      SB_LOG(INFO) << "Tunable " << name << " = " << values_[index].load()
+                   << " (stored)";
+    }
+    fclose(file);
+  }
+
+  void StoreLocked() {
+    if (path_.empty())
+      return;
+    // Write aside and rename, a crash must not leave a truncated file.
+    std::string temp_path = path_ + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "w");
+    if (!file) {
+      SB_LOG(WARNING) << "Failed to write " << temp_path;
+      return;
+    }
+    fprintf(file, "%d\n", kTunablesFormat);
+    for (int i = 0; i < kCount; ++i) {
+      if (stored_[i]) {
+        fprintf(file, "%s %lld\n", kTunables[i].name,
+                static_cast<long long>(values_[i].load()));
+      }
+    }
+    bool ok = fclose(file) == 0;
+    if (!ok || rename(temp_path.c_str(), path_.c_str()) != 0) {
+      SB_LOG(WARNING) << "Failed to update " << path_;
+      remove(temp_path.c_str());
+    }
+  }
+
+  // Read without the lock, written under it.
+  ::starboard::atomic_int64_t values_[kCount];
+
+  ::starboard::Mutex mutex_;
+  // Environment or default, what null goes back to.
+  int64_t base_[kCount];
+  bool stored_[kCount] = {};
+  std::string path_;
+};
+
+SB_ONCE_INITIALIZE_FUNCTION(TunableStore, GetTunableStore);
+
+}  // namespace
+
+int64_t GetTunable(Tunable tunable) {
+  return GetTunableStore()->Get(tunable);
+}
+
+bool SetTunable(const char* name, const char* json) {
+  return GetTunableStore()->Set(name, json);
+}
+
+bool GetTunableJson(const char* name, std::string* out_json) {
+  return GetTunableStore()->GetJson(name, out_json);
+}
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
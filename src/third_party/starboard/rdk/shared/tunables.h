@@ -0,0 +1,69 @@
+//
+// Copyright 2020 Comcast Cable Communications Management, LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// SPDX-License-Identifier: Apache-2.0
+#ifndef THIRD_PARTY_STARBOARD_RDK_SHARED_TUNABLES_H_
+#define THIRD_PARTY_STARBOARD_RDK_SHARED_TUNABLES_H_
+
+#include <stdint.h>
+
+#include <string>
+
+namespace third_party {
+namespace starboard {
+namespace rdk {
+namespace shared {
+
+// Knobs that used to be environment variables or constants, so deployed
+// devices can be tuned without a rebuild. A value comes from, in order of
+// precedence, SbRdkSetSetting() (kept in the cache directory across runs),
+// the environment variable the knob used to be read from, and the built-in
+// default. Reads are a relaxed atomic load and can sit on hot paths; where
+// a value is only read at startup the comment says so.
+enum class Tunable {
+  kSupportLowMem,          // "support_lowmem", COBALT_SUPPORT_LOWMEM, startup.
+  kSupportAv1,             // "support_av1", COBALT_SUPPORT_AV1.
+  kHangDetectorInterval,   // "hang_detector_interval_s", 0 disables, startup.
+  kVideoAppSrcMaxBytes,    // "video_appsrc_max_bytes", new players.
+  kAudioAppSrcMaxBytes,    // "audio_appsrc_max_bytes", new players.
+  kSecMemMinFreeBytes,     // "secmem_min_free_bytes", below it no more data.
+  kSecMemMinFreeBuffers,   // "secmem_min_free_buffers", same.
+  kMinVideoBufferTime,     // "min_video_buffer_ms", buffer health check.
+  kMinAudioBufferTime,     // "min_audio_buffer_ms", buffer health check.
+  kEssRunLoopPeriod,       // "ess_run_loop_period_us", Essos direct mode.
+  kDynamicMediaBudget,     // "media_budget_dynamic", media/buffer_budget.h.
+  kAudioLatencyProfile,    // "audio_latency_profile", "low", "balanced" or
+                           // "power", COBALT_AUDIO_LATENCY_PROFILE, new sinks.
+  kUiFramePacing,          // "ui_frame_pacing", system/frame_pacer.h.
+  kCount
+};
+
+int64_t GetTunable(Tunable tunable);
+
+// The SbRdkSetSetting() side. |json| is a JSON number or boolean, or for
+// knobs with named choices one of the names as a string. null drops the
+// stored value. Out of range numbers are clamped. Returns false for unknown
+// names and values that don't parse.
+bool SetTunable(const char* name, const char* json);
+
+// One value as JSON, or all of them as an object when |name| is empty.
+bool GetTunableJson(const char* name, std::string* out_json);
+
+}  // namespace shared
+}  // namespace rdk
+}  // namespace starboard
+}  // namespace third_party
+
+#endif  // THIRD_PARTY_STARBOARD_RDK_SHARED_TUNABLES_H_